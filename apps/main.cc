@@ -58,8 +58,12 @@ void run_graph500sssp(int SCALE, int edgefactor)
 
 	if(mpi.isMaster()) print_with_prefix("Graph generation");
 	double generation_time = MPI_Wtime();
-	generate_graph_spec2010(&edge_list, SCALE, edgefactor);
+	{
+		memory::TagScope tag_scope(memory::TAG_EDGE_LIST);
+		generate_graph_spec2010(&edge_list, SCALE, edgefactor);
+	}
 	generation_time = MPI_Wtime() - generation_time;
+	memory::print_usage_table("generation");
 
 	//edge_list.writeGraphToFile(("first_list" + std::to_string(mpi.rank) + ".txt").c_str());
 
@@ -73,8 +77,12 @@ void run_graph500sssp(int SCALE, int edgefactor)
 
 	if(mpi.isMaster()) print_with_prefix("Redistributing edge list...");
 	double redistribution_time = MPI_Wtime();
-	redistribute_edge_2d(&edge_list);
+	{
+		memory::TagScope tag_scope(memory::TAG_EDGE_LIST);
+		redistribute_edge_2d(&edge_list);
+	}
 	redistribution_time = MPI_Wtime() - redistribution_time;
+	memory::print_usage_table("construction");
 
 	int64_t sssp_roots[NUM_SSSP_ROOTS];
 	int num_sssp_roots = NUM_SSSP_ROOTS;
@@ -94,10 +102,14 @@ void run_graph500sssp(int SCALE, int edgefactor)
 	free(sssp_instance.graph_.has_edge_bitmap_); sssp_instance.graph_.has_edge_bitmap_= nullptr;
 
 	int64_t *pred = static_cast<int64_t*>(
-		cache_aligned_xmalloc(nlocalverts*sizeof(pred[0])));
+		huge_aligned_xmalloc(nlocalverts*sizeof(pred[0]), memory::TAG_VERTEX));
 
    float *dist = static_cast<float*>(
-      cache_aligned_xmalloc(nlocalverts*sizeof(dist[0])));
+      huge_aligned_xmalloc(nlocalverts*sizeof(dist[0]), memory::TAG_VERTEX));
+#if NUMA_PLACEMENT
+	numa::make_static_placement<int64_t>(nlocalverts).first_touch(pred);
+	numa::make_static_placement<float>(nlocalverts).first_touch(dist);
+#endif
 
 #if INIT_PRED_ONCE	// Only Spec2010 needs this initialization
 #pragma omp parallel for
@@ -113,6 +125,7 @@ void run_graph500sssp(int SCALE, int edgefactor)
 		init_log(SCALE, edgefactor, generation_time, construction_time, redistribution_time, &log);
 
 	sssp_instance.prepare_sssp();
+	sssp_instance.print_numa_locality(pred, dist);
 
 		double time_left = PRE_EXEC_TIME;
         for(int c = root_start; time_left > 0.0; ++c) {
@@ -134,6 +147,7 @@ void run_graph500sssp(int SCALE, int edgefactor)
 
       MPI_Barrier(mpi.comm_2d);
       if(mpi.isMaster()) print_with_prefix("Preproc is finished \n");
+      memory::print_usage_table("presolve");
       num_sssp_roots = NUM_SSSP_ROOTS;
       find_roots_presolved(sssp_instance.graph_, sssp_roots, num_sssp_roots);
     //MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
@@ -175,6 +189,7 @@ void run_graph500sssp(int SCALE, int edgefactor)
 
 		validate_times[i] = MPI_Wtime();
 		int64_t edge_visit_count = 0;
+		memory::TagScope tag_scope(memory::TAG_VALIDATION);
 #if VALIDATION_LEVEL >= 2
 		result_ok = validate_sssp_result(&edge_list, dist, max_used_vertex + 1, nlocalverts, sssp_roots[i], pred, &edge_visit_count);
 #elif VALIDATION_LEVEL == 1
@@ -204,6 +219,7 @@ void run_graph500sssp(int SCALE, int edgefactor)
 
 		update_log_file(&log, sssp_times[i], validate_times[i], edge_visit_count);
 	}
+	memory::print_usage_table("SSSP runs");
 	sssp_instance.end_sssp();
 
 	if(mpi.isMaster()) {
@@ -64,7 +64,7 @@ public:
 		}
 #endif
 		edge_memory_ = static_cast<EdgeType*>
-			(cache_aligned_xmalloc(edge_memory_size_*sizeof(EdgeType)));
+			(cache_aligned_xmalloc(edge_memory_size_*sizeof(EdgeType), memory::TAG_EDGE_LIST));
 
 		if(filepath == NULL) {
 			data_in_file_ = false;
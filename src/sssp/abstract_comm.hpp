@@ -18,6 +18,10 @@
 #include "sssp_state.hpp"
 #include "omp.h"
 
+#if VERBOSE_MODE
+#include "profiling.hpp"
+#endif
+
 #define debug(...) debug_print(ABSCO, __VA_ARGS__)
 class AlltoallBufferHandler {
 public:
@@ -38,6 +42,7 @@ class AsyncAlltoallManager {
 	struct Buffer {
 		void* ptr;
 		int length;
+		int next; // next slot of the same target, -1 if last
 	};
 
 	struct PointerData {
@@ -47,37 +52,58 @@ class AsyncAlltoallManager {
 		int length;
 	};
 
+	enum {
+		PTR_BLOCK_LENGTH = 64, // pointer descriptors per block
+		PTR_SLAB_BLOCKS = 64, // blocks per allocated slab
+		MAX_PTR_SLABS = 1 << 14,
+		RECV_CHUNKS_PER_THREAD = 4, // received data is processed in about this many chunks per thread
+		RECV_CHUNK_MIN_LENGTH = 2048, // in words
+		PROGRESS_RECV_RING_LENGTH = 1024, // received chunks in flight per thread
+		PROGRESS_SPINS_BEFORE_YIELD = 1024,
+	};
+
+	// stream of one target, for the progress thread
+	struct ProgressSend {
+		int target;
+		int offset;
+		int length;
+	};
+
+	// part of the data received from one rank; starts with a packet header or a pointer row
+	struct RecvChunk {
+		int offset;
+		int length;
+		int from;
+		bool is_ptr;
+	};
+
+	// fixed-capacity block of pointer descriptors; only written by the thread that owns it
+	struct PointerBlock {
+		PointerBlock* next;
+		int length;
+		PointerData data[PTR_BLOCK_LENGTH];
+	};
+
 	struct CommTarget {
 		CommTarget()
 			: reserved_size_(0)
-			, filled_size_(0) {
+			, filled_size_(0)
+			, buf_head(-1)
+			, buf_tail(-1)
+			, ptr_head(NULL) {
 			cur_buf.ptr = NULL;
 			cur_buf.length = 0;
-#ifdef USE_PTR_LOCKS_OMP
-			omp_init_lock(&send_mutex);
-#else
-         pthread_mutex_init(&send_mutex, NULL);
-#endif
-		}
-		~CommTarget() {
-#ifdef USE_PTR_LOCKS_OMP
-		   omp_destroy_lock(&send_mutex);
-#else
-		   pthread_mutex_destroy(&send_mutex);
-#endif
+			cur_buf.next = -1;
 		}
 
-#ifdef USE_PTR_LOCKS_OMP
-		omp_lock_t send_mutex;
-#else
-		pthread_mutex_t send_mutex;
-#endif
-		// monitor : send_mutex
 		volatile int reserved_size_;
 		volatile int filled_size_;
 		Buffer cur_buf;
-		std::vector<Buffer> send_data;
-		std::vector<PointerData> send_ptr;
+		// flushed buffers (slots of buffer_slots_); only modified by the thread that swaps cur_buf
+		int buf_head;
+		int buf_tail;
+		// pointer descriptor blocks of all threads, pushed lock-free
+		PointerBlock* volatile ptr_head;
 	};
 public:
 	AsyncAlltoallManager(MPI_Comm comm_, AlltoallBufferHandler* buffer_provider_)
@@ -91,19 +117,88 @@ public:
 		d_ = new DynamicDataSet();
 		pthread_mutex_init(&d_->thread_sync_, NULL);
 		buffer_size_ = buffer_provider_->buffer_length();
+
+		max_buffer_slots_ = 0;
+		buffer_slots_ = NULL;
+		buffer_slots_used_ = 0;
+
+		max_threads_ = omp_get_max_threads();
+		ptr_blocks_stride_ = std::max<int>(CACHE_LINE/sizeof(PointerBlock*), comm_size_);
+		thread_ptr_blocks_ = (PointerBlock**)cache_aligned_xmalloc(max_threads_ * ptr_blocks_stride_ * sizeof(PointerBlock*));
+		for( int i = 0; i < max_threads_ * ptr_blocks_stride_; ++i )
+			thread_ptr_blocks_[i] = NULL;
+
+		ptr_slabs_ = (PointerBlock**)cache_aligned_xmalloc(MAX_PTR_SLABS * sizeof(PointerBlock*));
+		for( int i = 0; i < MAX_PTR_SLABS; ++i )
+			ptr_slabs_[i] = NULL;
+		ptr_blocks_used_ = 0;
+
+		// preallocate one block per thread and target, more slabs are only added for hub-heavy phases
+		const int n_init_slabs = std::min<int>(MAX_PTR_SLABS, (max_threads_ * comm_size_ + PTR_SLAB_BLOCKS - 1) / PTR_SLAB_BLOCKS);
+		for( int i = 0; i < n_init_slabs; ++i )
+			ptr_slabs_[i] = (PointerBlock*)cache_aligned_xmalloc(PTR_SLAB_BLOCKS * sizeof(PointerBlock));
+
+		// FOLD_NODE_AWARE=1 selects the two-level exchange over node proxies, FOLD_RMA=1 one-sided
+		// MPI-3 puts instead of the alltoallv, FOLD_PROGRESS_THREAD=1 point-to-point messages driven by
+		// a communication thread; all ranks need to agree. Not used without remote targets.
+		const char* fold_na_char = getenv("FOLD_NODE_AWARE");
+		const char* fold_rma_char = getenv("FOLD_RMA");
+		const char* fold_progress_char = getenv("FOLD_PROGRESS_THREAD");
+		int use_exchange[3] = {
+			(fold_na_char != NULL && atoi(fold_na_char) != 0 && comm_size_ > 1),
+			(fold_rma_char != NULL && atoi(fold_rma_char) != 0 && comm_size_ > 1),
+			(fold_progress_char != NULL && atoi(fold_progress_char) != 0 && comm_size_ > 1 &&
+					mpi.thread_level >= MPI_THREAD_SERIALIZED) };
+		if( fold_progress_char != NULL && atoi(fold_progress_char) != 0 && mpi.thread_level < MPI_THREAD_SERIALIZED )
+			if(mpi.isMaster()) print_with_prefix("FOLD_PROGRESS_THREAD needs MPI_THREAD_SERIALIZED, using the alltoallv");
+		MPI_Allreduce(MPI_IN_PLACE, use_exchange, 3, MPI_INT, MPI_LAND, comm_);
+		exchange_type_ = EXCHANGE_ALLTOALLV;
+		if( use_exchange[0] && scatter_.setup_node_aware() )
+			exchange_type_ = EXCHANGE_NODE_AWARE;
+		else if( use_exchange[1] )
+			exchange_type_ = EXCHANGE_RMA;
+		else if( use_exchange[2] )
+			start_progress_thread();
 	}
 	virtual ~AsyncAlltoallManager() {
+		if( exchange_type_ == EXCHANGE_PROGRESS_THREAD )
+			stop_progress_thread();
 		delete [] node_; node_ = NULL;
+		for( int i = 0; i < MAX_PTR_SLABS; ++i )
+			free(ptr_slabs_[i]);
+		free(ptr_slabs_); ptr_slabs_ = NULL;
+		free(thread_ptr_blocks_); thread_ptr_blocks_ = NULL;
+		free(buffer_slots_); buffer_slots_ = NULL;
 	}
 
 	void prepare() {
 		CTRACER(prepare);
 		debug("prepare idx=%d", sub_comm);
+		// every flushed buffer comes from the provider's pool, so this many slots always suffice
+		const int n_slots = buffer_provider_->max_size() / (buffer_size_ * buffer_provider_->element_size()) + comm_size_;
+		if( n_slots > max_buffer_slots_ ) {
+			assert(buffer_slots_used_ == 0);
+			free(buffer_slots_);
+			buffer_slots_ = (Buffer*)cache_aligned_xmalloc(n_slots * sizeof(Buffer));
+			max_buffer_slots_ = n_slots;
+		}
 		for(int i = 0; i < comm_size_; ++i) {
 			node_[i].reserved_size_ = node_[i].filled_size_ = buffer_size_;
 		}
 	}
 
+	// Creates the windows of the RMA exchange on both pool buffers of the provider. Collective;
+	// call after the pool is allocated and release_buffers() before it is freed.
+	void register_buffers() {
+		if( exchange_type_ != EXCHANGE_RMA ) return;
+		scatter_.register_rma_window(buffer_provider_->clear_buffers(), buffer_provider_->max_size());
+		scatter_.register_rma_window(buffer_provider_->second_buffer(), buffer_provider_->max_size());
+	}
+	void release_buffers() {
+		if( exchange_type_ != EXCHANGE_RMA ) return;
+		scatter_.free_rma_windows();
+	}
+
 	/**
 	 * Asynchronous send.
 	 * When the communicator receive data, it will call fold_received(FoldCommBuffer*) function.
@@ -146,23 +241,131 @@ public:
 // #endif
 	}
 
+	/**
+	 * Lock-free pointer send: each thread stages the descriptors in its own block per target,
+	 * only a new block is published with a compare-and-swap.
+	 * Must not be called concurrently with run_*().
+	 */
 	void put_ptr(int64_t ptr, int length, int64_t header, float dist, int target) {
+		const int tid = omp_get_thread_num();
+		assert(tid < max_threads_);
+		PointerBlock** const thread_blocks = thread_ptr_blocks_ + tid * ptr_blocks_stride_;
+		PointerBlock* block = thread_blocks[target];
+
+		if( block == NULL || block->length == PTR_BLOCK_LENGTH ) { // low probability
+			block = get_ptr_block();
+			push_ptr_block(node_[target], block);
+			thread_blocks[target] = block;
+		}
+
+		PointerData& data = block->data[block->length++];
+		data.ptr = ptr;
+		data.header = header;
+		data.dist = dist;
+		data.length = length;
+	}
+
+	// Visits all pending pointer descriptors of given target (to be called outside of parallel sends).
+	template <typename F>
+	void visit_ptrs(int target, F& f) const {
+		for( const PointerBlock* block = node_[target].ptr_head; block != NULL; block = block->next )
+			for( int b = 0; b < block->length; ++b )
+				f(block->data[b].ptr, block->data[b].length, block->data[b].header, block->data[b].dist);
+	}
+
+	// Visits all pending buffers of given target (to be called outside of parallel sends).
+	template <typename F>
+	void visit_buffers(int target, F& f) {
 		CommTarget& node = node_[target];
-		PointerData data = { ptr, header, dist, length };
+		flush(node);
+		for( int s = node.buf_head; s >= 0; s = buffer_slots_[s].next )
+			f(buffer_slots_[s].ptr, buffer_slots_[s].length);
+	}
 
-#ifdef USE_PTR_LOCKS_OMP
-		omp_set_lock(&node.send_mutex);
-      node.send_ptr.push_back(data);
-      omp_unset_lock(&node.send_mutex);
-#else
-		pthread_mutex_lock(&node.send_mutex);
-		node.send_ptr.push_back(data);
-		pthread_mutex_unlock(&node.send_mutex);
-#endif
+	// Drops all pending data and recycles the pointer blocks and buffer slots.
+	void clear_pending() {
+		for( int i = 0; i < comm_size_; ++i ) {
+			flush(node_[i]);
+			clear_buffers(i);
+			clear_ptrs(i);
+		}
+		reset_ptr_blocks();
+		reset_buffer_slots();
 	}
 
 private:
 
+	PointerBlock* get_ptr_block() {
+		const int idx = __sync_fetch_and_add(&ptr_blocks_used_, 1);
+		const int slab = idx / PTR_SLAB_BLOCKS;
+		if( slab >= MAX_PTR_SLABS ) {
+			fprintf(IMD_OUT, "too many pointer blocks: %d\n", idx);
+			MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+		}
+		PointerBlock* volatile* const slabs = ptr_slabs_;
+		PointerBlock* slab_blocks = slabs[slab];
+		if( slab_blocks == NULL ) { // only happens while the pool grows
+			PointerBlock* const new_blocks = (PointerBlock*)cache_aligned_xmalloc(PTR_SLAB_BLOCKS * sizeof(PointerBlock));
+			if( !__sync_bool_compare_and_swap(&ptr_slabs_[slab], (PointerBlock*)NULL, new_blocks) )
+				free(new_blocks);
+			slab_blocks = slabs[slab];
+		}
+		PointerBlock* const block = slab_blocks + (idx % PTR_SLAB_BLOCKS);
+		block->next = NULL;
+		block->length = 0;
+		return block;
+	}
+
+	static
+	void push_ptr_block(CommTarget& node, PointerBlock* block) {
+		PointerBlock* head;
+		do {
+			head = node.ptr_head;
+			block->next = head;
+		} while( !__sync_bool_compare_and_swap(&node.ptr_head, head, block) );
+	}
+
+	void clear_ptrs(int target) {
+		node_[target].ptr_head = NULL;
+		for( int t = 0; t < max_threads_; ++t )
+			thread_ptr_blocks_[t * ptr_blocks_stride_ + target] = NULL;
+	}
+
+	void clear_buffers(int target) {
+		node_[target].buf_head = node_[target].buf_tail = -1;
+	}
+
+	// NOTE: all targets need to be cleared before
+	void reset_ptr_blocks() {
+#ifndef NDEBUG
+		for( int i = 0; i < comm_size_; ++i )
+			assert(node_[i].ptr_head == NULL);
+#endif
+		ptr_blocks_used_ = 0;
+	}
+
+	// NOTE: all targets need to be cleared before
+	void reset_buffer_slots() {
+#ifndef NDEBUG
+		for( int i = 0; i < comm_size_; ++i )
+			assert(node_[i].buf_head == -1);
+#endif
+		buffer_slots_used_ = 0;
+	}
+
+	// distances of the target if it is on the same node and not presolving, otherwise NULL
+	static
+	const float* target_node_dist(const SsspState& sssp_state, int target) {
+		if( sssp_state.node_dists_ == NULL || sssp_state.is_presolving_mode_ )
+			return NULL;
+		return sssp_state.node_dists_[target];
+	}
+
+	static
+	bool has_ptrs(const CommTarget& node) {
+		return (node.ptr_head != NULL);
+	}
+
 	// Returns sentinel value
 	static inline
 	uint32_t get_sentinel() {
@@ -272,14 +475,12 @@ private:
    }
 
    // Returns (overestimate of) send length for given node.
-   static
-   int get_node_send_length_buffer(const CommTarget& node, const SsspState& sssp_state, const Graph2DCSR& graph)
+   int get_node_send_length_buffer(const CommTarget& node, const SsspState& sssp_state, const Graph2DCSR& graph) const
    {
-      const int n_buffers = (int)node.send_data.size();
       int node_send_length = 0;
 
-      for( int b = 0; b < n_buffers; ++b )
-         node_send_length += node.send_data[b].length;
+      for( int s = node.buf_head; s >= 0; s = buffer_slots_[s].next )
+         node_send_length += buffer_slots_[s].length;
 
       return node_send_length;
    }
@@ -288,10 +489,9 @@ private:
    static
    int get_node_send_length_ptr(const CommTarget& node, const SsspState& sssp_state, const Graph2DCSR& graph)
    {
-      const int n_ptrs = (int)node.send_ptr.size();
       int node_send_length = 0;
 
-      if( 0 == n_ptrs )
+      if( !has_ptrs(node) )
          return node_send_length;
 
       const BitmapType* const vertices_is_settled = sssp_state.vertices_is_settled_;
@@ -307,8 +507,9 @@ private:
       const float bucket_upper = sssp_state.bucket_upper;
 #endif
 
-      for( int b = 0; b < n_ptrs; ++b ) {
-        const PointerData& buffer = node.send_ptr[b];
+      for( const PointerBlock* block = node.ptr_head; block != NULL; block = block->next )
+      for( int b = 0; b < block->length; ++b ) {
+        const PointerData& buffer = block->data[b];
         const int buffer_length = buffer.length;
         assert(buffer_length >= 0);
         if( buffer_length == 0 )
@@ -374,13 +575,12 @@ private:
     // Copies the vertices to send to given compute to to array stream. Marks duplicates by setting sentinel value.
     static inline
     int collect_targets_ptr(const CommTarget& node, const SsspState& sssp_state, const Graph2DCSR& graph,
-          uint32_t* restrict stream, int32_t* restrict vertices_pos)
+          const float* restrict target_dist, uint32_t* restrict stream, int32_t* restrict vertices_pos)
     {
        const BitmapType* const vertices_is_settled = sssp_state.vertices_is_settled_;
        const int64_t* const restrict edge_array = graph.edge_array_;
        const float* const restrict edge_weight_array = graph.edge_weight_array_;
        const LocalVertex lmask = (LocalVertex(1) << graph.local_bits_) - 1;
-       const int n_ptrs = (int)node.send_ptr.size();
        const int r_bits = graph.r_bits_;
        const int lgl = graph.local_bits_;
        const int64_t L = graph.num_local_verts_;
@@ -390,9 +590,11 @@ private:
        const bool is_light_phase = sssp_state.is_light_phase_;
        const float bucket_upper = sssp_state.bucket_upper;
        const uint32_t sentinel = get_sentinel();
+       VERBOSE(int64_t n_filtered = 0);
 
-       for( int b = 0; b < n_ptrs; ++b ) {
-          const PointerData& buffer = node.send_ptr[b];
+       for( const PointerBlock* block = node.ptr_head; block != NULL; block = block->next )
+       for( int b = 0; b < block->length; ++b ) {
+          const PointerData& buffer = block->data[b];
           const int buffer_length = buffer.length;
           if( buffer_length == 0 )
              continue;
@@ -416,6 +618,10 @@ private:
                 const float dist_new = buffer_dist + edge_weight_array[pos];
                 // todo use MACRO inline does not work
                 const LocalVertex tgt_local = (edge_array[pos] & lmask);
+                if( target_dist && !(dist_new < target_dist[tgt_local]) ) {
+                   VERBOSE(n_filtered++);
+                   continue;
+                }
                 if( vertices_pos[tgt_local] < 0 ) {
                    vertices_pos[tgt_local] = node_send_pos;
                    stream[node_send_pos++] = tgt_local;
@@ -445,6 +651,10 @@ private:
                       continue;
                    // todo use MACRO inline does not work
                    const LocalVertex tgt_local = (edge_array[pos] & lmask);
+                   if( target_dist && !(dist_new < target_dist[tgt_local]) ) {
+                      VERBOSE(n_filtered++);
+                      continue;
+                   }
                    if( vertices_pos[tgt_local] < 0 ) {
                       vertices_pos[tgt_local] = node_send_pos;
                       stream[node_send_pos++] = tgt_local;
@@ -477,6 +687,10 @@ private:
                    }
                    // todo use MACRO inline does not work
                    const LocalVertex tgt_local = (edge_array[pos] & lmask);
+                   if( target_dist && !(dist_new < target_dist[tgt_local]) ) {
+                      VERBOSE(n_filtered++);
+                      continue;
+                   }
                    if( vertices_pos[tgt_local] < 0 ) {
                       vertices_pos[tgt_local] = node_send_pos;
                       stream[node_send_pos++] = tgt_local;
@@ -499,17 +713,18 @@ private:
           assert(buffer_length_filtered % 2 == 0);
           stream[node_send_pos_org - 1] = buffer_length_filtered;
        }
+       VERBOSE(if( n_filtered > 0 ) __sync_fetch_and_add(&profiling::node_shared_filtered, n_filtered));
 
        return node_send_pos;
     }
 
     // remove duplicates that are to be sent. Returns new length
-    static inline
+    inline
     int collect_targets_buffer(const CommTarget& node, const Graph2DCSR& graph, const SsspState& sssp_state, int stream_offset, uint32_t* restrict stream,
  #if USE_PROPER_HASHMAP
-        std::unordered_map<LocalVertex, int>& tgt_map )
+        std::unordered_map<LocalVertex, int>& tgt_map ) const
  #else
-        int32_t* restrict vertices_pos)
+        int32_t* restrict vertices_pos) const
  #endif
     {
        const LocalVertex lmask = (LocalVertex(1) << graph.local_bits_) - 1;
@@ -517,9 +732,8 @@ private:
        const bool is_presolving = sssp_state.is_presolving_mode_;
 
        int offset = stream_offset;
-       const int n_buffers = (int)node.send_data.size();
-       for( int b = 0; b < n_buffers; ++b ) {
-          Buffer buffer = node.send_data[b];
+       for( int s = node.buf_head; s >= 0; s = buffer_slots_[s].next ) {
+          const Buffer& buffer = buffer_slots_[s];
           const int buffer_length = buffer.length;
           if( buffer_length == 0 )
              continue;
@@ -605,20 +819,26 @@ public:
        MPI_Comm_rank(comm_, &comm_rank);
        assert(0 <= comm_rank && comm_rank < comm_size_);
 
- #pragma omp parallel for schedule(static)
-       for(int i = 0; i < comm_size_; ++i) {
-          CommTarget& node = node_[i];
-          flush(node);
-
-          node_send_lengths_buffer[i] = get_node_send_length_buffer(node, sssp_state, graph);
-          node_send_lengths_ptr[i] = get_node_send_length_ptr(node, sssp_state, graph);
-       }
+       int* const send_lengths = scatter_.get_send_lengths();
+       const bool with_progress_thread = (exchange_type_ == EXCHANGE_PROGRESS_THREAD);
 
        for( int loop = 0; true; ++loop ) {
           USER_START(a2a_merge);
+          bool has_data = true;
+
+          // flush, count and merge in one parallel region, MPI is only called by the master thread
+          memory::g_team.parallel([&]() {
+             if( loop == 0 ) {
+#pragma omp for schedule(static)
+                for(int i = 0; i < comm_size_; ++i) {
+                   CommTarget& node = node_[i];
+                   flush(node);
+
+                   node_send_lengths_buffer[i] = get_node_send_length_buffer(node, sssp_state, graph);
+                   node_send_lengths_ptr[i] = get_node_send_length_ptr(node, sssp_state, graph);
+                } // implicit barrier
+             }
 
- #pragma omp parallel
-          {
              int* counts = scatter_.get_counts();
              bool thread_has_ptr = false;
  #pragma omp for schedule(static)
@@ -656,41 +876,43 @@ public:
                 thread_has_ptr = true;
                 counts[i] += node_send_lengths_ptr[i];
              } // #pragma omp for schedule(static)
-          } // #pragma omp parallel
 
-          scatter_.sum();
-
-          // todo maybe catch this somehow and rerun upper loop?
-          if( scatter_.get_send_count() > (buffer_provider_->max_size() / es) ) {
-             std::cerr << "memory issue for node send: " << scatter_.get_send_count() << " > " << (buffer_provider_->max_size() / es) << "\n";
-             std::cout << "memory issue for node send: " << scatter_.get_send_count() << " > " << (buffer_provider_->max_size() / es) << "\n";
-             MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
-          }
-
-          if( loop > 0 ) {
-             int has_data = (scatter_.get_send_count() > 0);
-             MPI_Allreduce(MPI_IN_PLACE, &has_data, 1, MPI_INT, MPI_LOR, comm_);
+             scatter_.sum_in_team();
+#pragma omp master
+             {
+                // todo maybe catch this somehow and rerun upper loop?
+                if( scatter_.get_send_count() > (buffer_provider_->max_size() / es) ) {
+                   std::cerr << "memory issue for node send: " << scatter_.get_send_count() << " > " << (buffer_provider_->max_size() / es) << "\n";
+                   std::cout << "memory issue for node send: " << scatter_.get_send_count() << " > " << (buffer_provider_->max_size() / es) << "\n";
+                   MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
 
-             if( mpi.isMaster() && has_data )
-                std::cout << "re-running allgather, count: " << loop << '\n';
+                if( loop > 0 ) {
+                   int has_data_int = (scatter_.get_send_count() > 0);
+                   MPI_Allreduce(MPI_IN_PLACE, &has_data_int, 1, MPI_INT, MPI_LOR, comm_);
 
-             if(has_data == 0) break;
-          }
+                   if( mpi.isMaster() && has_data_int )
+                      std::cout << "re-running allgather, count: " << loop << '\n';
 
-          int* const send_lengths = scatter_.get_send_lengths();
+                   has_data = (has_data_int != 0);
+                }
+                if( with_progress_thread && has_data )
+                   progress_start((const uint32_t*)buffer_provider_->second_buffer());
+             }
+#pragma omp barrier
 
-#pragma omp parallel
-          {
              int* offsets = scatter_.get_offsets();
-             int* counts = scatter_.get_counts_org();
              uint32_t* stream = (uint32_t*)buffer_provider_->second_buffer();
 
-             const int64_t pos_offset = omp_get_thread_num() * graph.num_local_verts_;
-#pragma omp for schedule(static)
+             const int tid = omp_get_thread_num();
+             const int64_t pos_offset = tid * graph.num_local_verts_;
+#pragma omp for schedule(static) nowait
              for( int c = 0; c < comm_size_; ++c ) {
                 const int i = (c + comm_rank) % comm_size_;
                 if( counts[i] == 0 ) {
                    assert(send_lengths[i] == 0);
+                   if( with_progress_thread && has_data )
+                      progress_send(tid, i, offsets[i], 0);
                    continue;
                 }
 
@@ -708,7 +930,7 @@ public:
                 const int offset_targets = offset;
 
                 if( use_ptr ) {
-                   length_ptr = collect_targets_ptr(node, sssp_state, graph, stream + offset_targets, vertices_pos + pos_offset);
+                   length_ptr = collect_targets_ptr(node, sssp_state, graph, target_node_dist(sssp_state, i), stream + offset_targets, vertices_pos + pos_offset);
                    assert(length_ptr <= counts[i]);
                    assert(i + 1 == comm_size_ || offset + length_ptr <= offsets[i + 1]);
                    offset += length_ptr;
@@ -728,7 +950,7 @@ public:
                    stream[offset_org] = length_ptr_reduced; // here we store the ptr length
                    send_lengths[i] += length_ptr_reduced;
                    offset += length_ptr_reduced;
-                   node.send_ptr.clear();
+                   clear_ptrs(i);
                    node_send_lengths_ptr[i] = 0;
                 }
                 if( use_buffer ) {
@@ -738,7 +960,7 @@ public:
                    assert(length_buffer_reduced <= length_buffer);
 
                    send_lengths[i] += length_buffer_reduced;
-                   node.send_data.clear();
+                   clear_buffers(i);
                    node_send_lengths_buffer[i] = 0;
                 }
                 assert(1 <= send_lengths[i] && send_lengths[i] <= counts[i]);
@@ -747,10 +969,28 @@ public:
                 if( send_lengths[i] == 1 )
                    send_lengths[i] = 0;
 
-             } // #pragma omp for schedule(static)
-          } // #pragma omp parallel
+                if( with_progress_thread )
+                   progress_send(tid, i, offset_org, send_lengths[i]);
+             } // #pragma omp for schedule(static) nowait
+
+             // process the received data as it arrives, while other threads may still merge
+             if( with_progress_thread && has_data )
+                progress_receive(tid);
+          }); // #pragma omp parallel
           USER_END(a2a_merge);
 
+          if( !has_data ) break;
+
+          if( with_progress_thread ) {
+             PROF(merge_time_ += tk_all);
+             buffer_provider_->clear_buffers();
+             VERBOSE(last_send_size_ += scatter_.get_send_count() * es);
+             VERBOSE(last_recv_size_ += progress_recv_size_ * es);
+             buffer_provider_->finish();
+             PROF(recv_proc_large_time_ += tk_all);
+             continue;
+          }
+
           void* sendbuf = buffer_provider_->second_buffer();
           void* recvbuf = buffer_provider_->clear_buffers();
           MPI_Datatype type = buffer_provider_->data_type();
@@ -759,7 +999,7 @@ public:
           PROF(merge_time_ += tk_all);
           USER_START(a2a_comm);
           VERBOSE(if(loop > 0 && mpi.isMaster()) print_with_prefix("Alltoall with pointer (Again)"));
-          scatter_.alltoallv(sendbuf, recvbuf, type, recvbufsize);
+          exchange(sendbuf, recvbuf, type, recvbufsize);
           PROF(comm_time_ += tk_all);
           USER_END(a2a_comm);
 
@@ -767,8 +1007,9 @@ public:
           VERBOSE(last_recv_size_ += scatter_.get_recv_count() * es);
 
           int* recv_offsets = scatter_.get_recv_offsets();
+          const int chunk_length = get_recv_chunk_length(recv_offsets[comm_size_]);
 
- #pragma omp parallel for
+          recv_chunks_.clear();
           for(int i = 0; i < comm_size_; ++i) {
              int offset = recv_offsets[i];
              if( recv_offsets[i + 1] == recv_offsets[i] )
@@ -776,16 +1017,16 @@ public:
 
              const int length_ptr = ((uint32_t*)recvbuf)[offset];
              offset++;
-
-             // store the received distances (method lives in sssp.hpp)
-             buffer_provider_->received(recvbuf, offset, length_ptr, i, true);
+             add_recv_chunks((uint32_t*)recvbuf, offset, length_ptr, i, true, chunk_length);
              offset += length_ptr;
              assert(offset <= recv_offsets[i+1] );
 
              const int length_buf = recv_offsets[i + 1] - offset;
              assert(loop == 0 || length_buf == 0);
-             buffer_provider_->received(recvbuf, offset, length_buf, i, false);
+             add_recv_chunks((uint32_t*)recvbuf, offset, length_buf, i, false, chunk_length);
           }
+          // store the received distances (method lives in sssp.hpp)
+          process_recv_chunks(recvbuf);
           PROF(recv_proc_time_ += tk_all);
 
           buffer_provider_->finish();
@@ -794,8 +1035,10 @@ public:
 
  #ifndef NDEBUG
        for(int i = 0; i < comm_size_; ++i)
-          assert(node_[i].send_ptr.size() == 0);
+          assert(!has_ptrs(node_[i]));
  #endif
+       reset_ptr_blocks();
+       reset_buffer_slots();
     }
 
 	void run_ptr(const Graph2DCSR& graph, const SsspState& sssp_state, int32_t* restrict vertices_pos) {
@@ -813,22 +1056,23 @@ public:
 		MPI_Comm_rank(comm_, &comm_rank);
 		assert(0 <= comm_rank && comm_rank < comm_size_);
 
-#pragma omp parallel for schedule(static)
+      memory::g_team.parallel([&]() {
+#pragma omp for schedule(static) nowait
       for(int i = 0; i < comm_size_; ++i) {
          CommTarget& node = node_[i];
          //flush(node); // todo: problem?
          node_send_lengths[i] = 0;
 
-         if( 0 == node.send_ptr.size() )
+         if( !has_ptrs(node) )
             continue;
          node_send_lengths[i] = get_node_send_length_buffer(node, sssp_state, graph);
       }
+      });
 
 		for(int loop = 0; ; ++loop) {
 			USER_START(a2a_merge);
 
-#pragma omp parallel
-			{
+			memory::g_team.parallel([&]() {
 				int* counts = scatter_.get_counts();
 				int size_thread = 0;
 #pragma omp for schedule(static)
@@ -837,7 +1081,7 @@ public:
 					CommTarget& node = node_[i];
                assert(0 == counts[i]);
 
-               if( 0 == node.send_ptr.size() )
+               if( !has_ptrs(node) )
                   continue;
 
                const int spare_size = max_size_per_thread - size_thread;
@@ -869,7 +1113,7 @@ public:
                }
                size_thread += node_send_length;
 				} // #pragma omp for schedule(static)
-			} // #pragma omp parallel
+			}); // #pragma omp parallel
 
 			scatter_.sum();
 
@@ -885,8 +1129,7 @@ public:
 
 			int* const send_lengths = scatter_.get_send_lengths();
 
-#pragma omp parallel
-			{
+			memory::g_team.parallel([&]() {
 				int* offsets = scatter_.get_offsets();
 				int* counts = scatter_.get_counts_org();
 	         uint32_t* stream = (uint32_t*)buffer_provider_->second_buffer();
@@ -901,21 +1144,21 @@ public:
 				   }
 
 					CommTarget& node = node_[i];
-					if( 0 == node.send_ptr.size() ) {
+					if( !has_ptrs(node) ) {
 					   assert(send_lengths[i] == 0);
 					   continue;
 					}
 
-					const int length_ptr = collect_targets_ptr(node, sssp_state, graph, stream + offsets[i], vertices_pos + pos_offset);
+					const int length_ptr = collect_targets_ptr(node, sssp_state, graph, target_node_dist(sssp_state, i), stream + offsets[i], vertices_pos + pos_offset);
                const int length_reduced = remove_sentinels_ptr(graph, length_ptr, stream + offsets[i], vertices_pos + pos_offset);
 
 					assert(length_reduced <= length_ptr && length_ptr <= counts[i]);
 					assert(i + 1 == comm_size_ || offsets[i] + length_ptr <= offsets[i + 1]);
 					send_lengths[i] = length_reduced;
 
-					node.send_ptr.clear();
+					clear_ptrs(i);
 				} // #pragma omp for schedule(static)
-			} // #pragma omp parallel
+			}); // #pragma omp parallel
 			USER_END(a2a_merge);
 
 			void* sendbuf = buffer_provider_->second_buffer();
@@ -926,7 +1169,7 @@ public:
 			PROF(merge_time_ += tk_all);
 			USER_START(a2a_comm);
 			VERBOSE(if(loop > 0 && mpi.isMaster()) print_with_prefix("Alltoall with pointer (Again)"));
-			scatter_.alltoallv(sendbuf, recvbuf, type, recvbufsize);
+			exchange(sendbuf, recvbuf, type, recvbufsize);
 			PROF(comm_time_ += tk_all);
 			USER_END(a2a_comm);
 
@@ -934,15 +1177,14 @@ public:
 			VERBOSE(last_recv_size_ += scatter_.get_recv_count() * es);
 
 			int* recv_offsets = scatter_.get_recv_offsets();
+			const int chunk_length = get_recv_chunk_length(recv_offsets[comm_size_]);
 
-#pragma omp parallel for
+			recv_chunks_.clear();
 			for(int i = 0; i < comm_size_; ++i) {
-				const int offset = recv_offsets[i];
-				const int length = recv_offsets[i+1] - offset;
-
-				// store the received distances (method lives in sssp.hpp)
-				buffer_provider_->received(recvbuf, offset, length, i, true);
+				add_recv_chunks((uint32_t*)recvbuf, recv_offsets[i], recv_offsets[i+1] - recv_offsets[i], i, true, chunk_length);
 			}
+			// store the received distances (method lives in sssp.hpp)
+			process_recv_chunks(recvbuf);
 			PROF(recv_proc_time_ += tk_all);
 
 			buffer_provider_->finish();
@@ -951,8 +1193,9 @@ public:
 
 #ifndef NDEBUG
 		for(int i = 0; i < comm_size_; ++i)
-		   assert(node_[i].send_ptr.size() == 0);
+		   assert(!has_ptrs(node_[i]));
 #endif
+		reset_ptr_blocks();
 	}
 
 	void run() {
@@ -978,25 +1221,23 @@ public:
 #endif
 #endif
 
-#pragma omp parallel
-		{
+		memory::g_team.parallel([&]() {
 			int* counts = scatter_.get_counts();
 #pragma omp for schedule(static)
 			for(int i = 0; i < comm_size_; ++i) {
 				CommTarget& node = node_[i];
 				flush(node);
-				for(int b = 0; b < (int)node.send_data.size(); ++b) {
-					counts[i] += node.send_data[b].length;
+				for(int s = node.buf_head; s >= 0; s = buffer_slots_[s].next) {
+					counts[i] += buffer_slots_[s].length;
 				}
 			} // #pragma omp for schedule(static)
-		}
+		});
 
 		scatter_.sum();
 
 		int* const send_lengths = scatter_.get_send_lengths();
 
-#pragma omp parallel
-		{
+		memory::g_team.parallel([&]() {
 			int* offsets = scatter_.get_offsets();
 			uint8_t* dst = (uint8_t*)buffer_provider_->second_buffer();
 
@@ -1019,10 +1260,11 @@ public:
 		      assert(send_lengths[i] >= length_reduced);
 		      send_lengths[i] = length_reduced;
 
-				node.send_data.clear();
+				clear_buffers(i);
 			} // #pragma omp for schedule(static)
-		} // #pragma omp parallel
+		}); // #pragma omp parallel
 		USER_END(a2a_merge);
+		reset_buffer_slots();
 
 		void* sendbuf = buffer_provider_->second_buffer();
 		void* recvbuf = buffer_provider_->clear_buffers();
@@ -1031,7 +1273,7 @@ public:
 		const int recvbufsize = buffer_provider_->max_size() / sizeof(uint32_t);
 		PROF(merge_time_ += tk_all);
 		USER_START(a2a_comm);
-		scatter_.alltoallv(sendbuf, recvbuf, type, recvbufsize);
+		exchange(sendbuf, recvbuf, type, recvbufsize);
 		PROF(comm_time_ += tk_all);
 		USER_END(a2a_comm);
 
@@ -1039,14 +1281,13 @@ public:
 		VERBOSE(last_recv_size_ = scatter_.get_recv_count() * es);
 
 		int* recv_offsets = scatter_.get_recv_offsets();
+		const int chunk_length = get_recv_chunk_length(recv_offsets[comm_size_]);
 
-#pragma omp parallel for schedule(dynamic,1)
+		recv_chunks_.clear();
 		for(int i = 0; i < comm_size_; ++i) {
-			const int offset = recv_offsets[i];
-			const int length = recv_offsets[i+1] - offset;
-
-			buffer_provider_->received(recvbuf, offset, length, i, false);
+			add_recv_chunks((uint32_t*)recvbuf, recv_offsets[i], recv_offsets[i+1] - recv_offsets[i], i, false, chunk_length);
 		}
+		process_recv_chunks(recvbuf);
 
 		PROF(recv_proc_time_ += tk_all);
 	}
@@ -1065,7 +1306,26 @@ public:
 #if VERBOSE_MODE
 	int get_last_send_size() { return last_send_size_; }
 #endif
+	const char* exchange_name() const {
+		switch( exchange_type_ ) {
+		case EXCHANGE_NODE_AWARE: return "node-aware alltoallv";
+		case EXCHANGE_RMA: return "MPI-3 RMA";
+		case EXCHANGE_PROGRESS_THREAD: return "progress thread";
+		default: return "alltoallv";
+		}
+	}
+	// see ScatterContext::get_node_aware_stats(), NULL if the node-aware exchange is not used
+	const int64_t* node_aware_stats() const {
+		return (exchange_type_ == EXCHANGE_NODE_AWARE) ? scatter_.get_node_aware_stats() : NULL;
+	}
+	void reset_node_aware_stats() { scatter_.reset_node_aware_stats(); }
 private:
+	enum ExchangeType {
+		EXCHANGE_ALLTOALLV,
+		EXCHANGE_RMA,
+		EXCHANGE_NODE_AWARE,
+		EXCHANGE_PROGRESS_THREAD,
+	};
 
 	struct DynamicDataSet {
 		// lock topology
@@ -1080,8 +1340,33 @@ private:
 
 	int node_list_length_;
 	CommTarget* node_;
+
+	ExchangeType exchange_type_;
+	int max_threads_;
+	int max_buffer_slots_;
+	volatile int buffer_slots_used_;
+	Buffer* buffer_slots_;
+	int ptr_blocks_stride_;
+	PointerBlock** thread_ptr_blocks_; // current block of each thread and target
+	PointerBlock** ptr_slabs_;
+	volatile int ptr_blocks_used_;
 	AlltoallBufferHandler* buffer_provider_;
 	ScatterContext scatter_;
+	std::vector<RecvChunk> recv_chunks_;
+
+	// fold progress thread
+	pthread_t progress_thread_;
+	pthread_mutex_t progress_sync_;
+	pthread_cond_t progress_cond_;
+	bool progress_active_;
+	bool progress_terminated_;
+	int64_t progress_exchanges_;
+	const uint32_t* progress_send_buf_;
+	uint32_t* progress_recv_buf_;
+	int progress_recv_length_; // in words
+	int progress_recv_size_; // in words, of the last exchange
+	std::vector<memory::SpscRing<ProgressSend>*> progress_send_rings_;
+	std::vector<memory::SpscRing<RecvChunk>*> progress_recv_rings_;
 
 	PROF(profiling::TimeSpan merge_time_);
 	PROF(profiling::TimeSpan comm_time_);
@@ -1090,10 +1375,275 @@ private:
 	VERBOSE(int last_send_size_);
 	VERBOSE(int last_recv_size_);
 
+	// sends the merged data, the counts need to be set in scatter_
+	void exchange(void* sendbuf, void* recvbuf, MPI_Datatype type, int recvbufsize) {
+		switch( exchange_type_ ) {
+		case EXCHANGE_NODE_AWARE:
+			scatter_.alltoallv_node_aware(sendbuf, recvbuf, type, recvbufsize);
+			break;
+		case EXCHANGE_RMA:
+			scatter_.alltoallv_rma(sendbuf, recvbuf, type, recvbufsize);
+			break;
+		default:
+			scatter_.alltoallv(sendbuf, recvbuf, type, recvbufsize);
+			break;
+		}
+	}
+
+	int get_recv_chunk_length(int total_length) const {
+		return std::max<int>(RECV_CHUNK_MIN_LENGTH, total_length / (max_threads_ * RECV_CHUNKS_PER_THREAD));
+	}
+
+	void add_recv_chunks(const uint32_t* stream, int offset, int length, int from, bool is_ptr, int chunk_length) {
+		split_recv_chunks(stream, offset, length, from, is_ptr, chunk_length, recv_chunks_);
+	}
+
+	// splits the data received from rank 'from' into chunks of about chunk_length words,
+	// a buffer chunk starts at a packet header, a pointer chunk at a row
+	static void split_recv_chunks(const uint32_t* stream, int offset, int length, int from, bool is_ptr, int chunk_length,
+			std::vector<RecvChunk>& chunks) {
+		const int end = offset + length;
+		while( offset < end ) {
+			int split = end;
+			if( end - offset > chunk_length ) {
+				if( is_ptr ) {
+					// rows: source (2 words), length, targets
+					split = offset;
+					while( split < end && split - offset < chunk_length )
+						split += 3 + stream[split + 2];
+				}
+				else {
+					// (target, distance) pairs, a new source is marked in the first word;
+					// a stream without sources (see PRED_RECONSTRUCTION) can be split at every pair
+					split = offset + (chunk_length & ~1);
+					if( stream[offset] & 0x80000000u ) {
+						while( split < end && !(stream[split] & 0x80000000u) )
+							split += 2;
+					}
+				}
+				assert(split <= end);
+			}
+			RecvChunk chunk = { offset, split - offset, from, is_ptr };
+			chunks.push_back(chunk);
+			offset = split;
+		}
+	}
+
+	void process_recv_chunks(void* recvbuf) {
+		const int num_chunks = recv_chunks_.size();
+		memory::g_team.parallel([&]() {
+#pragma omp for schedule(dynamic,1) nowait
+		for(int c = 0; c < num_chunks; ++c) {
+			const RecvChunk& chunk = recv_chunks_[c];
+			buffer_provider_->received(recvbuf, chunk.offset, chunk.length, chunk.from, chunk.is_ptr);
+		}
+		});
+	}
+
+	//-------------------------------------------------------------//
+	// fold exchange by a progress thread (FOLD_PROGRESS_THREAD=1):
+	// the merging threads hand the stream of each finished target over a ring to the progress thread,
+	// which sends it right away, receives the streams of all ranks into its own buffer and hands the
+	// received chunks back over one ring per thread. Only the progress thread calls MPI in the meantime.
+	//-------------------------------------------------------------//
+
+	void start_progress_thread() {
+		exchange_type_ = EXCHANGE_PROGRESS_THREAD;
+		progress_recv_length_ = 0; // allocated with the first exchange, the pool may not exist yet
+		progress_recv_buf_ = NULL;
+		for( int t = 0; t < max_threads_; ++t ) {
+			progress_send_rings_.push_back(new memory::SpscRing<ProgressSend>(comm_size_));
+			progress_recv_rings_.push_back(new memory::SpscRing<RecvChunk>(PROGRESS_RECV_RING_LENGTH));
+		}
+		progress_exchanges_ = 0;
+		progress_active_ = false;
+		progress_terminated_ = false;
+		pthread_mutex_init(&progress_sync_, NULL);
+		pthread_cond_init(&progress_cond_, NULL);
+		if( pthread_create(&progress_thread_, NULL, progress_thread_main, this) != 0 )
+			throw_exception("failed to create the fold progress thread");
+	}
+
+	void stop_progress_thread() {
+		pthread_mutex_lock(&progress_sync_);
+		progress_terminated_ = true;
+		pthread_cond_broadcast(&progress_cond_);
+		pthread_mutex_unlock(&progress_sync_);
+		pthread_join(progress_thread_, NULL);
+		pthread_mutex_destroy(&progress_sync_);
+		pthread_cond_destroy(&progress_cond_);
+		for( int t = 0; t < max_threads_; ++t ) {
+			delete progress_send_rings_[t];
+			delete progress_recv_rings_[t];
+		}
+		progress_send_rings_.clear();
+		progress_recv_rings_.clear();
+		free(progress_recv_buf_); progress_recv_buf_ = NULL;
+	}
+
+	static void* progress_thread_main(void* arg) {
+		AsyncAlltoallManager* this_ = static_cast<AsyncAlltoallManager*>(arg);
+		while( true ) {
+			pthread_mutex_lock(&this_->progress_sync_);
+			while( !this_->progress_active_ && !this_->progress_terminated_ )
+				pthread_cond_wait(&this_->progress_cond_, &this_->progress_sync_);
+			const bool terminated = !this_->progress_active_;
+			pthread_mutex_unlock(&this_->progress_sync_);
+			if( terminated )
+				break;
+
+			this_->progress_exchange();
+
+			pthread_mutex_lock(&this_->progress_sync_);
+			this_->progress_active_ = false;
+			pthread_cond_broadcast(&this_->progress_cond_);
+			pthread_mutex_unlock(&this_->progress_sync_);
+		}
+		return NULL;
+	}
+
+	// wakes up the progress thread for the next exchange of sendbuf; no other thread may call MPI until it is complete
+	void progress_start(const uint32_t* sendbuf) {
+		pthread_mutex_lock(&progress_sync_);
+		// the thread may not have gone back to sleep after the previous exchange
+		while( progress_active_ )
+			pthread_cond_wait(&progress_cond_, &progress_sync_);
+		progress_send_buf_ = sendbuf;
+		progress_recv_size_ = 0;
+		if( progress_recv_length_ < buffer_provider_->max_size() / buffer_provider_->element_size() ) {
+			free(progress_recv_buf_);
+			progress_recv_length_ = buffer_provider_->max_size() / buffer_provider_->element_size();
+			progress_recv_buf_ = (uint32_t*)cache_aligned_xmalloc(progress_recv_length_ * sizeof(uint32_t));
+		}
+		progress_active_ = true;
+		pthread_cond_broadcast(&progress_cond_);
+		pthread_mutex_unlock(&progress_sync_);
+	}
+
+	// called by the merging thread tid once for every target, also without data
+	void progress_send(int tid, int target, int offset, int length) {
+		const ProgressSend send = { target, offset, length };
+		// the ring holds a message for every target
+		const bool pushed = progress_send_rings_[tid]->push(send);
+		assert(pushed);
+		(void) pushed;
+	}
+
+	// processes the received chunks given to thread tid until the exchange is complete
+	void progress_receive(int tid) {
+		memory::SpscRing<RecvChunk>* const ring = progress_recv_rings_[tid];
+		int spins = 0;
+		while( true ) {
+			RecvChunk chunk;
+			if( ring->pop(&chunk) ) {
+				if( chunk.length < 0 )
+					break;
+				buffer_provider_->received(progress_recv_buf_, chunk.offset, chunk.length, chunk.from, chunk.is_ptr);
+				spins = 0;
+			}
+			else if( ++spins > PROGRESS_SPINS_BEFORE_YIELD ) {
+				sched_yield();
+			}
+		}
+	}
+
+	// progress thread: sends the streams of all targets and receives one from every rank, in any order
+	void progress_exchange() {
+		const int tag = PRM::FOLD_PROGRESS_TAG + (progress_exchanges_++ & 1);
+		std::vector<MPI_Request> send_reqs;
+		std::vector<RecvChunk> chunks;
+		send_reqs.reserve(comm_size_);
+		size_t next_chunk = 0;
+		int next_thread = 0;
+		int num_sent = 0;
+		int num_received = 0;
+		int recv_offset = 0;
+
+		while( num_sent < comm_size_ || num_received < comm_size_ || send_reqs.size() > 0 || next_chunk < chunks.size() ) {
+			bool has_progress = false;
+
+			for( int t = 0; t < max_threads_; ++t ) {
+				ProgressSend send;
+				while( progress_send_rings_[t]->pop(&send) ) {
+					MPI_Request req;
+					MPI_Isend(const_cast<uint32_t*>(progress_send_buf_) + send.offset, send.length, MPI_UINT32_T,
+							send.target, tag, comm_, &req);
+					send_reqs.push_back(req);
+					++num_sent;
+					has_progress = true;
+				}
+			}
+
+			if( num_received < comm_size_ ) {
+				int flag;
+				MPI_Message message;
+				MPI_Status status;
+				MPI_Improbe(MPI_ANY_SOURCE, tag, comm_, &flag, &message, &status);
+				if( flag ) {
+					int length;
+					MPI_Get_count(&status, MPI_UINT32_T, &length);
+					if( recv_offset + length > progress_recv_length_ ) {
+						fprintf(IMD_OUT, "fold progress thread: receive buffer too small (%d > %d)\n", recv_offset + length, progress_recv_length_);
+						MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+					}
+					MPI_Mrecv(progress_recv_buf_ + recv_offset, length, MPI_UINT32_T, &message, MPI_STATUS_IGNORE);
+					if( length > 0 ) {
+						// same layout as in run_with_both: number of pointer words, pointer rows, buffer packets
+						const int from = status.MPI_SOURCE;
+						const int chunk_length = get_recv_chunk_length(length * comm_size_);
+						const int length_ptr = progress_recv_buf_[recv_offset];
+						split_recv_chunks(progress_recv_buf_, recv_offset + 1, length_ptr, from, true, chunk_length, chunks);
+						split_recv_chunks(progress_recv_buf_, recv_offset + 1 + length_ptr, length - 1 - length_ptr, from, false, chunk_length, chunks);
+					}
+					recv_offset += length;
+					++num_received;
+					has_progress = true;
+				}
+			}
+
+			if( send_reqs.size() > 0 ) {
+				int flag;
+				MPI_Testall(send_reqs.size(), send_reqs.data(), &flag, MPI_STATUSES_IGNORE);
+				if( flag )
+					send_reqs.clear();
+			}
+
+			// hand the chunks out round robin, skipping threads that are still busy
+			for( int tries = 0; next_chunk < chunks.size() && tries < max_threads_; ) {
+				if( progress_recv_rings_[next_thread]->push(chunks[next_chunk]) ) {
+					++next_chunk;
+					has_progress = true;
+				}
+				else {
+					++tries;
+				}
+				next_thread = (next_thread + 1) % max_threads_;
+			}
+
+			if( !has_progress )
+				sched_yield();
+		}
+		progress_recv_size_ = recv_offset;
+
+		const RecvChunk end_marker = { 0, -1, -1, false };
+		for( int t = 0; t < max_threads_; ++t ) {
+			while( !progress_recv_rings_[t]->push(end_marker) )
+				sched_yield();
+		}
+	}
+
 	void flush(CommTarget& node) {
 		if(node.cur_buf.ptr != NULL) {
-			node.cur_buf.length = node.filled_size_;
-			node.send_data.push_back(node.cur_buf);
+			const int slot = __sync_fetch_and_add(&buffer_slots_used_, 1);
+			assert(slot < max_buffer_slots_);
+			buffer_slots_[slot].ptr = node.cur_buf.ptr;
+			buffer_slots_[slot].length = node.filled_size_;
+			buffer_slots_[slot].next = -1;
+			if( node.buf_tail >= 0 )
+				buffer_slots_[node.buf_tail].next = slot;
+			else
+				node.buf_head = slot;
+			node.buf_tail = slot;
 			node.cur_buf.ptr = NULL;
 		}
 	}
@@ -475,9 +475,13 @@ template <typename GraphType>
 void find_roots(GraphType& g, int64_t* bfs_roots, int& num_bfs_roots)
 {
 	using namespace PRM;
+	enum { ROOT_CHECK_BATCH = 64 };
 	/* Find roots and max used vertex */
 	int64_t counter = 0;
 	const int64_t nglobalverts = int64_t(1) << g.log_orig_global_verts_;
+	/* the candidates are checked in batches, so that one reduction serves many of them */
+	int batch_ok[ROOT_CHECK_BATCH];
+	int64_t batch_counter = -1;
 	int bfs_root_idx;
 	for (bfs_root_idx = 0; bfs_root_idx < num_bfs_roots; ++bfs_root_idx) {
 		int64_t root;
@@ -485,6 +489,7 @@ void find_roots(GraphType& g, int64_t* bfs_roots, int& num_bfs_roots)
 			double d[2];
 			make_random_numbers(2, USERSEED1, USERSEED2, counter, d);
 			root = (int64_t)((d[0] + d[1]) * nglobalverts) % nglobalverts;
+			const int64_t root_counter = counter;
 			counter += 2;
 			if (counter > 2 * nglobalverts) break;
 			int is_duplicate = 0;
@@ -496,10 +501,20 @@ void find_roots(GraphType& g, int64_t* bfs_roots, int& num_bfs_roots)
 				}
 			}
 			if (is_duplicate) continue; /* Everyone takes the same path here */
-			int root_ok = (int)g.has_edge(root);
-			int send_root_ok = root_ok;
-			MPI_Allreduce(&send_root_ok, &root_ok, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
-			if (root_ok) break;
+			if (batch_counter < 0 || root_counter >= batch_counter + 2 * ROOT_CHECK_BATCH) {
+				batch_counter = root_counter;
+				for (i = 0; i < ROOT_CHECK_BATCH; ++i) {
+					make_random_numbers(2, USERSEED1, USERSEED2, batch_counter + 2 * i, d);
+					const int64_t candidate = (int64_t)((d[0] + d[1]) * nglobalverts) % nglobalverts;
+#if COMPONENT_PREPASS && ROOTS_IN_GIANT_COMPONENT
+					batch_ok[i] = (int)(g.has_edge(candidate) && g.in_giant_component(candidate));
+#else
+					batch_ok[i] = (int)g.has_edge(candidate);
+#endif
+				}
+				MPI_Allreduce(MPI_IN_PLACE, batch_ok, ROOT_CHECK_BATCH, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+			}
+			if (batch_ok[(root_counter - batch_counter) / 2]) break;
 		}
 		bfs_roots[bfs_root_idx] = root;
 	}
@@ -513,7 +528,10 @@ void find_roots_presolved(GraphType& g, int64_t* bfs_roots, int& num_bfs_roots)
    const int64_t local_bitmap_width = g.num_local_verts_ / PRM::NBPE;
    assert(!g.has_edge_bitmap_);
    g.has_edge_bitmap_ = (BitmapType*)cache_aligned_xmalloc(local_bitmap_width*sizeof(BitmapType));
-   MPI_Reduce_scatter_block(g.row_bitmap_, g.has_edge_bitmap_, local_bitmap_width, MpiTypeOf<BitmapType>::type, MPI_BOR, mpi.comm_2dr);
+   BitmapType* row_bitmap = (BitmapType*)cache_aligned_xmalloc(g.row_bitmap_length()*sizeof(BitmapType));
+   g.get_row_bitmap(row_bitmap);
+   MPI_Reduce_scatter_block(row_bitmap, g.has_edge_bitmap_, local_bitmap_width, MpiTypeOf<BitmapType>::type, MPI_BOR, mpi.comm_2dr);
+   free(row_bitmap);
    find_roots(g, bfs_roots, num_bfs_roots);
 
    free(g.has_edge_bitmap_); g.has_edge_bitmap_= nullptr;
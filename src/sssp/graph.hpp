@@ -8,6 +8,8 @@
 #ifndef SRC_SSSP_GRAPH_HPP_
 #define SRC_SSSP_GRAPH_HPP_
 
+#include <fstream>
+#include <algorithm>
 #include "parameters.h"
 
 
@@ -50,6 +52,8 @@ public:
    {
       free(row_bitmap_); row_bitmap_ = nullptr;
       free(row_sums_); row_sums_ = nullptr;
+      free(row_block_starts_); row_block_starts_ = nullptr;
+      free(row_block_offs_); row_block_offs_ = nullptr;
       free(reorder_map_); reorder_map_ = nullptr;
       free(invert_map_); invert_map_ = nullptr;
       MPI_Free_mem(orig_vertexes_); orig_vertexes_ = nullptr;
@@ -65,6 +69,12 @@ public:
       free(row_starts_); row_starts_ = nullptr;
       free(row_starts_heavy_); row_starts_heavy_ = nullptr;
       free(vertices_minweight_); vertices_minweight_= nullptr;
+      free(vertices_maxweight_); vertices_maxweight_= nullptr;
+      free(is_giant_bitmap_); is_giant_bitmap_ = nullptr;
+      free(giant_vertices_); giant_vertices_ = nullptr;
+      num_giant_vertices_ = 0;
+      free(giant_column_words_); giant_column_words_ = nullptr;
+      num_giant_column_words_ = 0;
    }
 
    int pred_size() const { return num_orig_local_verts_; }
@@ -116,6 +126,17 @@ public:
       return false;
    }
 
+   // is (global) vertex v owned by this process and part of the giant component?
+   bool in_giant_component(int64_t v) const {
+      if(vertex_owner(v) == mpi.rank_2d) {
+         assert(is_giant_bitmap_);
+         int64_t v_local = reorder_map_[v / mpi.size_2d];
+         if(v_local >= num_local_verts_) return false;
+         return is_giant_bitmap_[v_local >> LOG_NBPE] & (BitmapType(1) << (v_local & NBPE_MASK));
+      }
+      return false;
+   }
+
    bool local_vertex_isDeg1(uint64_t v) const {
       const uint64_t base = v >> LOG_NBPE;
       const uint64_t shift = v & NBPE_MASK;
@@ -124,6 +145,136 @@ public:
       return (is_grad1_bitmap_[base] & uint64_t(1) << shift);
    }
 
+   int64_t row_bitmap_length() const { return (num_local_verts_ / PRM::NBPE) * mpi.size_2dc; }
+
+   // are the rows indexed by row_block_starts_ and row_block_offs_ instead of row_bitmap_ and row_sums_?
+   bool has_hypersparse_rows() const { return row_block_starts_ != nullptr; }
+
+   // number of non-empty rows
+   int64_t num_rows() const {
+      if( has_hypersparse_rows() )
+         return row_block_starts_[num_row_blocks_];
+      return row_sums_[row_bitmap_length()];
+   }
+
+   // bytes of the row index (without row_starts_ and orig_vertexes_)
+   int64_t row_index_bytes() const {
+      if( has_hypersparse_rows() )
+         return (num_row_blocks_ + 1) * sizeof(*row_block_starts_) + num_rows() * sizeof(*row_block_offs_);
+      return row_bitmap_length() * sizeof(*row_bitmap_) + (row_bitmap_length() + 1) * sizeof(*row_sums_);
+   }
+
+   // row (CSI) of the compact source, -1 if the source has no edges here
+   int64_t row_of(TwodVertex compact) const {
+      if( !has_hypersparse_rows() ) {
+         const BitmapType row_bitmap_i = row_bitmap_[compact >> LOG_NBPE];
+         const BitmapType bit = BitmapType(1) << (compact & NBPE_MASK);
+         if( !(row_bitmap_i & bit) )
+            return -1;
+         return row_sums_[compact >> LOG_NBPE] + __builtin_popcountl(row_bitmap_i & (bit - 1));
+      }
+      // a block holds about one row, so the search is amortized O(1)
+      const uint32_t offset = uint32_t(compact & ((TwodVertex(1) << log_row_block_) - 1));
+      const uint32_t* const first = row_block_offs_ + row_block_starts_[compact >> log_row_block_];
+      const uint32_t* const last = row_block_offs_ + row_block_starts_[(compact >> log_row_block_) + 1];
+      const uint32_t* const pos = std::lower_bound(first, last, offset);
+      return (pos != last && *pos == offset) ? (pos - row_block_offs_) : -1;
+   }
+
+   // bitmap of the non-empty rows among the compact sources of word word_idx (Index: SBI),
+   // first_row is set to the row (CSI) of the first of them
+   BitmapType row_word(int64_t word_idx, TwodVertex& first_row) const {
+      if( !has_hypersparse_rows() ) {
+         first_row = row_sums_[word_idx];
+         return row_bitmap_[word_idx];
+      }
+      const int64_t block = word_idx >> (log_row_block_ - LOG_NBPE);
+      const uint32_t word_offset = uint32_t((word_idx << LOG_NBPE) & ((int64_t(1) << log_row_block_) - 1));
+      const uint32_t* const last = row_block_offs_ + row_block_starts_[block + 1];
+      const uint32_t* const first = row_block_offs_ + row_block_starts_[block];
+      const uint32_t* pos = std::lower_bound(first, last, word_offset);
+      BitmapType bitmap = 0;
+      first_row = pos - row_block_offs_;
+      for( ; pos != last && *pos < word_offset + PRM::NBPE; ++pos )
+         bitmap |= BitmapType(1) << (*pos - word_offset);
+      return bitmap;
+   }
+
+   // replaces row_bitmap_ and row_sums_ by the sorted offsets of the non-empty rows in blocks of compact sources
+   // (doubly compressed), if fewer than 1/NBPE of the rows are non-empty or if forced; returns whether it did
+   bool compress_rows(bool force) {
+      const int64_t bitmap_length = row_bitmap_length();
+      const int64_t num_sources = bitmap_length * PRM::NBPE;
+      const int64_t rows = num_rows();
+      if( has_hypersparse_rows() || rows >= int64_t(UINT32_MAX) )
+         return false;
+      if( !force && rows * PRM::NBPE >= num_sources )
+         return false;
+
+      // about one non-empty row per block
+      int log_block = LOG_NBPE;
+      while( log_block < 32 && (int64_t(1) << (log_block + 1)) * std::max<int64_t>(rows, 1) <= num_sources )
+         log_block++;
+      const int log_words_per_block = log_block - LOG_NBPE;
+      const int64_t num_blocks = (bitmap_length + (int64_t(1) << log_words_per_block) - 1) >> log_words_per_block;
+
+      uint32_t* const block_starts = (uint32_t*)cache_aligned_xmalloc((num_blocks + 1) * sizeof(*block_starts));
+      uint32_t* const block_offs = (uint32_t*)cache_aligned_xmalloc(std::max<int64_t>(rows, 1) * sizeof(*block_offs));
+#pragma omp parallel for schedule(static)
+      for( int64_t b = 0; b < num_blocks; ++b ) {
+         const int64_t w_begin = b << log_words_per_block;
+         const int64_t w_end = std::min<int64_t>(bitmap_length, (b + 1) << log_words_per_block);
+         block_starts[b] = uint32_t(row_sums_[w_begin]);
+         for( int64_t w = w_begin; w < w_end; ++w ) {
+            BitmapType row_bitmap_i = row_bitmap_[w];
+            TwodVertex row = row_sums_[w];
+            while( row_bitmap_i != 0 ) {
+               block_offs[row++] = uint32_t(((w - w_begin) << LOG_NBPE) + __builtin_ctzl(row_bitmap_i));
+               row_bitmap_i &= row_bitmap_i - 1;
+            }
+         }
+      }
+      block_starts[num_blocks] = uint32_t(rows);
+
+      free(row_bitmap_); row_bitmap_ = nullptr;
+      free(row_sums_); row_sums_ = nullptr;
+      row_block_starts_ = block_starts;
+      row_block_offs_ = block_offs;
+      log_row_block_ = log_block;
+      num_row_blocks_ = num_blocks;
+      return true;
+   }
+
+   // restores row_bitmap_ and row_sums_ from the hypersparse rows (the presolving deletes rows in place)
+   void expand_rows() {
+      if( !has_hypersparse_rows() )
+         return;
+      const int64_t bitmap_length = row_bitmap_length();
+      BitmapType* const row_bitmap = (BitmapType*)cache_aligned_xmalloc(bitmap_length * sizeof(*row_bitmap));
+      TwodVertex* const row_sums = (TwodVertex*)cache_aligned_xmalloc((bitmap_length + 1) * sizeof(*row_sums));
+#pragma omp parallel for schedule(static)
+      for( int64_t w = 0; w < bitmap_length; ++w )
+         row_bitmap[w] = row_word(w, row_sums[w]);
+      row_sums[bitmap_length] = num_rows();
+
+      free(row_block_starts_); row_block_starts_ = nullptr;
+      free(row_block_offs_); row_block_offs_ = nullptr;
+      row_bitmap_ = row_bitmap;
+      row_sums_ = row_sums;
+      log_row_block_ = 0;
+      num_row_blocks_ = 0;
+   }
+
+   // writes the bitmap of the non-empty rows (length row_bitmap_length()) into row_bitmap
+   void get_row_bitmap(BitmapType* row_bitmap) const {
+      const int64_t bitmap_length = row_bitmap_length();
+#pragma omp parallel for schedule(static)
+      for( int64_t w = 0; w < bitmap_length; ++w ) {
+         TwodVertex first_row;
+         row_bitmap[w] = row_word(w, first_row);
+      }
+   }
+
    // separates heavy edges from light ones
    void separateHeavyEdges(float delta_step) {
       const int64_t num_local_verts = num_local_verts_;
@@ -221,12 +372,13 @@ public:
       for( int64_t i = 0; i < num_global_verts; i++ )
       {
          const uint64_t pos = i / 64;
-         const BitmapType row_bitmap_i = row_bitmap_[pos];
+         TwodVertex first_row;
+         const BitmapType row_bitmap_i = row_word(pos, first_row);
          const uint64_t rest = i % 64;
 
          if( row_bitmap_i & (BitmapType(1) << rest) )
          {
-            const int start = row_sums_[pos] + __builtin_popcountl(row_bitmap_i & ((BitmapType(1) << rest) - 1));
+            const int start = first_row + __builtin_popcountl(row_bitmap_i & ((BitmapType(1) << rest) - 1));
 
             outfile << "vertex=" << i;
             outfile << " degree=" << row_starts_[start + 1] - row_starts_[start]  << '\n';
@@ -251,12 +403,23 @@ public:
 
    BitmapType* row_bitmap_ = nullptr; // Index: SBI
    TwodVertex* row_sums_ = nullptr; // Index: SBI
+   // hypersparse rows (replace row_bitmap_ and row_sums_, see compress_rows)
+   uint32_t* row_block_starts_ = nullptr; // first row of each block of 2^log_row_block_ compact sources, Index: block
+   uint32_t* row_block_offs_ = nullptr; // compact source relative to its block, Index: CSI
+   int log_row_block_ = 0;
+   int64_t num_row_blocks_ = 0;
    BitmapType* has_edge_bitmap_ = nullptr; // for every local vertices, Index: SBI
    BitmapType* is_grad1_bitmap_ = nullptr; // for every local vertices, Index: SBI
    LocalVertex* reorder_map_ = nullptr; // Index: Pred
    LocalVertex* invert_map_ = nullptr; // Index: Reordered Pred
    LocalVertex* orig_vertexes_ = nullptr; // Index: CSI
    float* vertices_minweight_ = nullptr; // minimum incident edge weight
+   float* vertices_maxweight_ = nullptr; // maximum incident edge weight
+   BitmapType* is_giant_bitmap_ = nullptr; // local vertices in the (largest) connected component of the prepass, Index: SBI
+   LocalVertex* giant_vertices_ = nullptr; // sorted local vertices in the largest connected component
+   int64_t num_giant_vertices_ = 0; // length of giant_vertices_
+   int64_t* giant_column_words_ = nullptr; // words of the column bitmaps that hold vertices of the giant component
+   int64_t num_giant_column_words_ = 0; // length of giant_column_words_
 
    int64_t* edge_array_ = nullptr;
    float* edge_weight_array_ = nullptr;
@@ -19,6 +19,7 @@
 
 #include "parameters.h"
 #include "limits.h"
+#include <limits>
 #include "graph.hpp"
 
 namespace detail {
@@ -70,6 +71,12 @@ struct DegreeCalculation {
 	enum {
 		LOG_BLOCK_SIZE = LOG_EDGE_PART_SIZE - 5,
 		BLOCK_SIZE = 1 << LOG_BLOCK_SIZE,
+#if VERTEX_REORDERING >= 3
+		// the locality orderings also need the neighbor of each edge
+		EDGE_WORDS = 2,
+#else
+		EDGE_WORDS = 1,
+#endif
 	};
 
 	int org_local_bits_;
@@ -87,6 +94,10 @@ struct DegreeCalculation {
 	int64_t* row_length_;
 	int64_t* row_offset_;
 	std::vector<DWideRowEdge>* dwide_row_data_;
+#if VERTEX_REORDERING >= 3
+	// neighbor of each edge of dwide_row_data_: ~local id if it is owned by this rank, global id otherwise
+	std::vector<int64_t>* dwide_row_nbrs_;
+#endif
 	LocalVertex* vertexes_; // passed to ConstructionData
 
 	DegreeCalculation(int orig_local_bits, int log_local_verts_unit) {
@@ -98,12 +109,18 @@ struct DegreeCalculation {
 			throw "Error";
 		}
 		dwide_row_data_ = new std::vector<DWideRowEdge>[num_rows_]();
+#if VERTEX_REORDERING >= 3
+		dwide_row_nbrs_ = new std::vector<int64_t>[num_rows_]();
+#endif
 		row_length_ = static_cast<int64_t*>(cache_aligned_xcalloc(num_rows_*sizeof(int64_t)));
 		row_offset_ = static_cast<int64_t*>(cache_aligned_xcalloc(num_rows_*sizeof(int64_t)));
 	}
 
 	~DegreeCalculation() {
 		if(dwide_row_data_ != NULL) { delete [] dwide_row_data_; dwide_row_data_ = NULL; }
+#if VERTEX_REORDERING >= 3
+		if(dwide_row_nbrs_ != NULL) { delete [] dwide_row_nbrs_; dwide_row_nbrs_ = NULL; }
+#endif
 		if(wide_row_length_ != NULL) { free(wide_row_length_); wide_row_length_ = NULL; }
 		if(row_bitmap_ != NULL) { free(row_bitmap_); row_bitmap_ = NULL; }
 		if(row_sums_ != NULL) { free(row_sums_); row_sums_ = NULL; }
@@ -125,13 +142,13 @@ struct DegreeCalculation {
 		return max_local_verts_ / NBPE;
 	}
 
-	// edges: high: v1's c, low: v0's vertex_local
+	// edges: high: v1's c, low: v0's vertex_local; followed by the key of v1 if EDGE_WORDS == 2
 	void add(int64_t* edges, int64_t num_edges) {
 
 		// count edges
 #pragma omp parallel for
 		for(int64_t i = 0; i < num_edges; ++i) {
-			SeparatedId id(edges[i]);
+			SeparatedId id(edges[i*EDGE_WORDS]);
 			TwodVertex local = id.low(org_local_bits_);
 			int row = local >> LOG_BLOCK_SIZE;
 
@@ -141,12 +158,15 @@ struct DegreeCalculation {
 		// resize data store
 		for(int i = 0; i < num_rows_; ++i) {
 			dwide_row_data_[i].resize(row_length_[i], DWideRowEdge(0,0));
+#if VERTEX_REORDERING >= 3
+			dwide_row_nbrs_[i].resize(row_length_[i]);
+#endif
 		}
 
 		// store data
 #pragma omp parallel for
 		for(int64_t i = 0; i < num_edges; ++i) {
-			SeparatedId id(edges[i]);
+			SeparatedId id(edges[i*EDGE_WORDS]);
 			int c = id.high(org_local_bits_);
 			TwodVertex local = id.low(org_local_bits_);
 			int row = local >> LOG_BLOCK_SIZE;
@@ -154,6 +174,9 @@ struct DegreeCalculation {
 
 			int64_t offset = __sync_fetch_and_add(&row_offset_[row], 1);
 			dwide_row_data_[row][offset] = DWideRowEdge(src_vertex, c);
+#if VERTEX_REORDERING >= 3
+			dwide_row_nbrs_[row][offset] = edges[i*EDGE_WORDS + 1];
+#endif
 		}
 	}
 
@@ -200,6 +223,8 @@ private:
 		sort2(degree, vertexes_, num_verts, std::greater<int64_t>());
 #elif VERTEX_REORDERING == 1
 		sort2(degree, vertexes_, num_verts, ZeroOrElseComparator<int64_t>());
+#elif VERTEX_REORDERING >= 3
+		sort_by_locality(degree, num_verts);
 #endif
 
 		max_local_verts_ = 0;
@@ -244,6 +269,182 @@ private:
 		return reorde_map;
 	}
 
+#if VERTEX_REORDERING >= 3
+	// graph of the local vertices and their neighbors in CSR form: nodes [0, num_verts) are the local
+	// vertices, the nodes above are the neighbors owned by other ranks, which connect the local
+	// vertices that share them; local neighbors are plain edges
+	void calc_neighbor_graph(int64_t num_verts, std::vector<int64_t>& offsets, std::vector<int64_t>& adjacency) {
+		std::vector<int64_t> remote_ids;
+		for(int r = 0; r < num_rows_; ++r) {
+			const std::vector<int64_t>& row_nbrs = dwide_row_nbrs_[r];
+			for(size_t i = 0; i < row_nbrs.size(); ++i)
+				if(row_nbrs[i] >= 0) remote_ids.push_back(row_nbrs[i]);
+		}
+		std::sort(remote_ids.begin(), remote_ids.end());
+		remote_ids.erase(std::unique(remote_ids.begin(), remote_ids.end()), remote_ids.end());
+		const int64_t num_nodes = num_verts + remote_ids.size();
+
+		// replace the neighbor keys by node indices
+#pragma omp parallel for schedule(dynamic)
+		for(int r = 0; r < num_rows_; ++r) {
+			std::vector<int64_t>& row_nbrs = dwide_row_nbrs_[r];
+			for(size_t i = 0; i < row_nbrs.size(); ++i) {
+				const int64_t key = row_nbrs[i];
+				row_nbrs[i] = (key < 0) ? ~key : num_verts +
+						(std::lower_bound(remote_ids.begin(), remote_ids.end(), key) - remote_ids.begin());
+			}
+		}
+		std::vector<int64_t>().swap(remote_ids);
+
+		// the reverse of a local edge arrives as its own half-edge, the reverse of a remote one is added here
+		offsets.assign(num_nodes + 1, 0);
+		for(int r = 0; r < num_rows_; ++r) {
+			const std::vector<DWideRowEdge>& row_data = dwide_row_data_[r];
+			const std::vector<int64_t>& row_nbrs = dwide_row_nbrs_[r];
+			for(size_t i = 0; i < row_nbrs.size(); ++i) {
+				offsets[r * BLOCK_SIZE + row_data[i].src_vertex + 1]++;
+				if(row_nbrs[i] >= num_verts) offsets[row_nbrs[i] + 1]++;
+			}
+		}
+		for(int64_t u = 0; u < num_nodes; ++u)
+			offsets[u+1] += offsets[u];
+		adjacency.resize(offsets[num_nodes]);
+		std::vector<int64_t> fill(offsets.begin(), offsets.end() - 1);
+		for(int r = 0; r < num_rows_; ++r) {
+			const std::vector<DWideRowEdge>& row_data = dwide_row_data_[r];
+			const std::vector<int64_t>& row_nbrs = dwide_row_nbrs_[r];
+			for(size_t i = 0; i < row_nbrs.size(); ++i) {
+				const int64_t v = r * BLOCK_SIZE + row_data[i].src_vertex;
+				adjacency[fill[v]++] = row_nbrs[i];
+				if(row_nbrs[i] >= num_verts) adjacency[fill[row_nbrs[i]]++] = v;
+			}
+		}
+		delete [] dwide_row_nbrs_; dwide_row_nbrs_ = NULL;
+	}
+
+	// orders vertexes_ such that neighboring vertices (and vertices with common neighbors) get close
+	// local ids; the vertices with the highest degree (hubs) stay first, isolated vertices last
+	void sort_by_locality(int64_t* degree, int64_t num_verts) {
+		std::vector<int64_t> offsets;
+		std::vector<int64_t> adjacency;
+		calc_neighbor_graph(num_verts, offsets, adjacency);
+		const int64_t num_nodes = offsets.size() - 1;
+
+		// hubs
+		const int64_t num_hubs = std::min<int64_t>(HUB_DELEGATION_VERTICES, num_verts);
+		std::vector<LocalVertex> order(vertexes_, vertexes_ + num_verts);
+		std::partial_sort(order.begin(), order.begin() + num_hubs, order.end(), [degree](LocalVertex a, LocalVertex b) {
+			return (degree[a] != degree[b]) ? (degree[a] > degree[b]) : (a < b);
+		});
+		std::vector<uint8_t> placed(num_nodes, 0);
+		for(int64_t i = 0; i < num_hubs; ++i)
+			placed[order[i]] = 1;
+		int64_t num_placed = num_hubs;
+
+#if VERTEX_REORDERING == 3
+		// Cuthill-McKee: breadth-first from a vertex of minimum degree, the unvisited neighbors of each
+		// node are queued by ascending degree; hubs are not expanded, since they would pull in everything
+		std::vector<LocalVertex> starts;
+		for(int64_t v = 0; v < num_verts; ++v)
+			if(!placed[v] && degree[v] != 0) starts.push_back(v);
+		std::sort(starts.begin(), starts.end(), [degree](LocalVertex a, LocalVertex b) {
+			return (degree[a] != degree[b]) ? (degree[a] < degree[b]) : (a < b);
+		});
+		const int64_t rcm_start = num_placed;
+		std::vector<int64_t> queue;
+		for(size_t s = 0; s < starts.size(); ++s) {
+			if(placed[starts[s]]) continue;
+			queue.clear();
+			queue.push_back(starts[s]);
+			placed[starts[s]] = 1;
+			for(size_t q = 0; q < queue.size(); ++q) {
+				const int64_t u = queue[q];
+				if(u < num_verts) order[num_placed++] = u;
+				const size_t level_start = queue.size();
+				for(int64_t k = offsets[u]; k < offsets[u+1]; ++k) {
+					const int64_t w = adjacency[k];
+					if(!placed[w]) {
+						placed[w] = 1;
+						queue.push_back(w);
+					}
+				}
+				std::sort(queue.begin() + level_start, queue.end(), [&offsets](int64_t a, int64_t b) {
+					const int64_t da = offsets[a+1] - offsets[a], db = offsets[b+1] - offsets[b];
+					return (da != db) ? (da < db) : (a < b);
+				});
+			}
+		}
+		std::reverse(order.begin() + rcm_start, order.begin() + num_placed);
+#else
+		// label propagation: every node starts with its own label and takes the most frequent label
+		// of its neighbors; remote and local nodes are updated alternately, because the graph is
+		// almost bipartite between them and synchronous updates would oscillate
+		std::vector<int64_t> label(num_nodes);
+		for(int64_t u = 0; u < num_nodes; ++u)
+			label[u] = u;
+		std::vector<int64_t> next_label(num_verts);
+		// hubs keep their own label and do not vote
+		auto most_frequent_label = [&](int64_t u, std::vector<int64_t>& labels) {
+			labels.assign(1, label[u]);
+			for(int64_t k = offsets[u]; k < offsets[u+1]; ++k)
+				if(adjacency[k] >= num_verts || !placed[adjacency[k]])
+					labels.push_back(label[adjacency[k]]);
+			std::sort(labels.begin(), labels.end());
+			int64_t best = label[u], best_count = 0;
+			for(size_t i = 0; i < labels.size(); ) {
+				size_t j = i;
+				while(j < labels.size() && labels[j] == labels[i]) ++j;
+				if(int64_t(j - i) > best_count) {
+					best_count = j - i;
+					best = labels[i];
+				}
+				i = j;
+			}
+			return best;
+		};
+		enum { LABEL_PROPAGATION_ROUNDS = 3 };
+		for(int round = 0; round < LABEL_PROPAGATION_ROUNDS; ++round) {
+#pragma omp parallel
+			{
+				std::vector<int64_t> labels;
+				// remote nodes only have local neighbors, so they can be updated in place
+#pragma omp for schedule(dynamic, 1024)
+				for(int64_t u = num_verts; u < num_nodes; ++u)
+					label[u] = most_frequent_label(u, labels);
+#pragma omp for schedule(dynamic, 1024)
+				for(int64_t v = 0; v < num_verts; ++v)
+					next_label[v] = placed[v] ? label[v] : most_frequent_label(v, labels);
+#pragma omp for
+				for(int64_t v = 0; v < num_verts; ++v)
+					label[v] = next_label[v];
+			}
+		}
+		const int64_t lp_start = num_placed;
+		for(int64_t v = 0; v < num_verts; ++v)
+			if(!placed[v] && degree[v] != 0) {
+				placed[v] = 1;
+				order[num_placed++] = v;
+			}
+		std::sort(order.begin() + lp_start, order.begin() + num_placed, [degree, &label](LocalVertex a, LocalVertex b) {
+			if(label[a] != label[b]) return label[a] < label[b];
+			return (degree[a] != degree[b]) ? (degree[a] > degree[b]) : (a < b);
+		});
+#endif
+		// isolated vertices
+		for(int64_t v = 0; v < num_verts; ++v)
+			if(!placed[v])
+				order[num_placed++] = v;
+		assert(num_placed == num_verts);
+
+		std::vector<int64_t> degree_orig(degree, degree + num_verts);
+#pragma omp parallel for
+		for(int64_t i = 0; i < num_verts; ++i) {
+			vertexes_[i] = order[i];
+			degree[i] = degree_orig[order[i]];
+		}
+	}
+#endif
+
 	// builds (future) graph data, such as row_sums and row_bitmap
 	void make_construct_data(LocalVertex* reorder_map) {
 		int64_t src_bitmap_size = local_bitmap_size() * mpi.size_2dc;
@@ -466,6 +667,9 @@ public:
 
 		computeNumVertices(g);
 		scatterAndScanMinWeights(edge_list, g);
+#if COMPONENT_PREPASS
+		computeComponents(g);
+#endif
 
 		if(mpi.isMaster()) print_with_prefix("Graph construction complete.");
 	}
@@ -626,8 +830,9 @@ private:
 	void scatterAndScanEdges(EdgeList* edge_list, GraphType& g) {
 		TRACER(scan_edge);
 		ScatterContext scatter(mpi.comm_2d);
+		const int edge_words = DegreeCalculation::EDGE_WORDS;
 		int64_t* edges_to_send = static_cast<int64_t*>(
-				xMPI_Alloc_mem(2 * EdgeList::CHUNK_SIZE * sizeof(int64_t)));
+				xMPI_Alloc_mem(2 * edge_words * EdgeList::CHUNK_SIZE * sizeof(int64_t)));
 		const int num_loops = edge_list->beginRead(false);
 
 		if(mpi.isMaster()) print_with_prefix("Begin counting degree. Number of iterations is %d.", num_loops);
@@ -645,8 +850,8 @@ private:
 					const int64_t v0 = edge_data[i].v0();
 					const int64_t v1 = edge_data[i].v1();
 					if (v0 == v1) continue;
-					(counts[vertex_owner(v0)])++;
-					(counts[vertex_owner(v1)])++;
+					(counts[vertex_owner(v0)]) += edge_words;
+					(counts[vertex_owner(v1)]) += edge_words;
 				} // #pragma omp for schedule(static)
 			} // #pragma omp parallel
 
@@ -676,8 +881,16 @@ private:
 					const SeparatedId v1_swizzled(vertex_owner_c(v0), vertex_local(v1), local_bits);
 					//assert (offsets[edge_owner(v0,v1)] < 2 * FILE_CHUNKSIZE);
 					edges_to_send[(offsets[vertex_owner(v0)])++] = v0_swizzled.value;
+#if VERTEX_REORDERING >= 3
+					// the neighbor as seen by the owner: ~local id if it owns it, else the global id
+					const bool same_owner = (vertex_owner(v0) == vertex_owner(v1));
+					edges_to_send[(offsets[vertex_owner(v0)])++] = same_owner ? ~int64_t(vertex_local(v1)) : v1;
+#endif
 					//assert (offsets[edge_owner(v1,v0)] < 2 * FILE_CHUNKSIZE);
 					edges_to_send[(offsets[vertex_owner(v1)])++] = v1_swizzled.value;
+#if VERTEX_REORDERING >= 3
+					edges_to_send[(offsets[vertex_owner(v1)])++] = same_owner ? ~int64_t(vertex_local(v0)) : v0;
+#endif
 				} // #pragma omp for schedule(static)
 			} // #pragma omp parallel
 
@@ -692,7 +905,7 @@ private:
 #endif
 
 			const int64_t num_recv_edges = scatter.get_recv_count();
-			degree_calc_->add(recv_edges, num_recv_edges);
+			degree_calc_->add(recv_edges, num_recv_edges / edge_words);
 
 			scatter.free(recv_edges);
 
@@ -704,7 +917,7 @@ private:
 		if(mpi.isMaster()) print_with_prefix("Finished scattering edges.");
 	}
 
-   // send edges to vertex owners of end-points and stores minimum adjacent weight per locally owned vertex
+   // send edges to vertex owners of end-points and stores minimum and maximum adjacent weight per locally owned vertex
    void scatterAndScanMinWeights(EdgeList* edge_list, GraphType& g) {
       TRACER(scan_edge);
       ScatterContext scatter(mpi.comm_2d);
@@ -714,9 +927,12 @@ private:
 
       const int64_t num_local_verts = g.num_local_verts_;
       g.vertices_minweight_ = (float*) cache_aligned_xcalloc(num_local_verts * sizeof(g.vertices_minweight_[0]));
+      g.vertices_maxweight_ = (float*) cache_aligned_xcalloc(num_local_verts * sizeof(g.vertices_maxweight_[0]));
 
-      for( int i = 0; i < num_local_verts; i++ )
+      for( int i = 0; i < num_local_verts; i++ ) {
          g.vertices_minweight_[i] = std::numeric_limits<float>::max();
+         g.vertices_maxweight_[i] = -std::numeric_limits<float>::max();
+      }
 
       if(mpi.isMaster()) print_with_prefix("Begin minimum adjacent weight calculations. Number of iterations is %d.", num_loops);
 
@@ -793,6 +1009,9 @@ private:
             if( weight < g.vertices_minweight_[local] ) {
                g.vertices_minweight_[local] = weight;
             }
+            if( weight > g.vertices_maxweight_[local] ) {
+               g.vertices_maxweight_[local] = weight;
+            }
          }
 
          scatter.free(recv_edges);
@@ -1111,6 +1330,25 @@ private:
 		const int vertex_bits_;
 	};
 
+#if NUMA_PLACEMENT
+	enum { WORDS_PER_EDGE_PART = EDGE_PART_SIZE / NBPE };
+
+	// estimated first edge of row bitmap word i (as EdgeOffset of the SSSP) before the edges are sorted:
+	// the edges of a wide row are assumed to be spread evenly over its words
+	struct WideRowEdgeOffset {
+		const int64_t* wide_row_starts;
+		WideRowEdgeOffset(const int64_t* wide_row_starts) : wide_row_starts(wide_row_starts) { }
+		int64_t operator()(int64_t word_idx) const {
+			const int64_t part = word_idx / WORDS_PER_EDGE_PART;
+			const int64_t word_in_part = word_idx % WORDS_PER_EDGE_PART;
+			if( word_in_part == 0 )
+				return wide_row_starts[part];
+			const int64_t part_length = wide_row_starts[part + 1] - wide_row_starts[part];
+			return wide_row_starts[part] + part_length * word_in_part / WORDS_PER_EDGE_PART;
+		}
+	};
+#endif
+
 	// creates edge data for the graph
 	void scatterAndStore(EdgeList* edge_list, GraphType& g) {
 		TRACER(store_edge);
@@ -1118,8 +1356,17 @@ private:
 		WeightedOwnerEdge* edges_to_send = static_cast<WeightedOwnerEdge*>(
 				xMPI_Alloc_mem(2 * EdgeList::CHUNK_SIZE * sizeof(*edges_to_send)));
 
-		g.edge_array_ =      (int64_t*)cache_aligned_xcalloc(wide_row_starts_[num_wide_rows_]*sizeof(g.edge_array_[0]));
-		g.edge_weight_array_ = (float*)cache_aligned_xcalloc(wide_row_starts_[num_wide_rows_]*sizeof(g.edge_weight_array_[0]));
+#if NUMA_PLACEMENT
+		// the edges stay on the pages of their (unsorted) wide rows, close to where the threads scan them
+		const WideRowEdgeOffset edge_offset(wide_row_starts_);
+		g.edge_array_ =      (int64_t*)huge_aligned_xmalloc(wide_row_starts_[num_wide_rows_]*sizeof(g.edge_array_[0]));
+		g.edge_weight_array_ = (float*)huge_aligned_xmalloc(wide_row_starts_[num_wide_rows_]*sizeof(g.edge_weight_array_[0]));
+		numa::make_static_placement<int64_t>(num_wide_rows_ * WORDS_PER_EDGE_PART, edge_offset).first_touch(g.edge_array_);
+		numa::make_static_placement<float>(num_wide_rows_ * WORDS_PER_EDGE_PART, edge_offset).first_touch(g.edge_weight_array_);
+#else
+		g.edge_array_ =      (int64_t*)huge_aligned_xcalloc(wide_row_starts_[num_wide_rows_]*sizeof(g.edge_array_[0]));
+		g.edge_weight_array_ = (float*)huge_aligned_xcalloc(wide_row_starts_[num_wide_rows_]*sizeof(g.edge_weight_array_[0]));
+#endif
 		src_vertexes_ =     (uint16_t*)cache_aligned_xcalloc(wide_row_starts_[num_wide_rows_]*sizeof(src_vertexes_[0]));
 		g.edge_head_ownerc_ = (uint16_t*)cache_aligned_xcalloc(wide_row_starts_[num_wide_rows_]*sizeof(g.edge_head_ownerc_[0]));
 
@@ -1318,6 +1565,7 @@ private:
 	   // NOTE: not very efficient, but time is not counted anyway
       using namespace std;
       using extedge = struct { int64_t edge; float weight; uint16_t src; uint16_t owner; };
+      vector<extedge> edges; // reused by the rows of this thread
 
 #pragma omp for
       for(int64_t i = 0; i < num_wide_rows_; ++i) {
@@ -1325,7 +1573,7 @@ private:
          const int64_t edge_count = wide_row_starts_[i+1] - edge_offset;
          const int vertex_bits = g.r_bits_ + local_bits_;
          const int64_t edge_mask = (int64_t(1) << vertex_bits) - 1;
-         vector<extedge> edges(edge_count);
+         edges.resize(edge_count);
 
          for( int j = 0, k = edge_offset; j < edge_count; j++, k++ )
             edges[j] = { g.edge_array_[k], g.edge_weight_array_[k], src_vertexes_[k], g.edge_head_ownerc_[k] };
@@ -1498,6 +1746,164 @@ private:
 		g.num_global_verts_ = num_vertices;
 	}
 
+#if COMPONENT_PREPASS
+	// finds the component of the source with the longest row by a BFS that only exchanges the (local) vertices
+	// reached in the last round, and stores the vertices of this component. In the Kronecker graphs, this is the giant component
+	void computeComponents(GraphType& g) {
+		TRACER(components);
+		const int64_t num_local_verts = g.num_local_verts_;
+		const int64_t local_bitmap_width = num_local_verts / NBPE;
+		const int64_t src_bitmap_width = local_bitmap_width * mpi.size_2dc;
+		const int lgl = g.local_bits_;
+		const int64_t local_mask = (int64_t(1) << lgl) - 1;
+		const int64_t r_mask = (int64_t(1) << g.r_bits_) - 1;
+		const int size_c = mpi.size_2dc;
+		const int size_r = mpi.size_2dr;
+		const int max_threads = omp_get_max_threads();
+
+		if(mpi.isMaster()) print_with_prefix("Begin connected component calculations.");
+
+		// the seed is the source with the longest row, ties are broken by the smallest vertex
+		int64_t seed[2] = { -1, std::numeric_limits<int64_t>::max() }; // row length, vertex
+		for(int64_t word_idx = 0; word_idx < src_bitmap_width; ++word_idx) {
+			TwodVertex non_zero_off;
+			BitmapType row_bitmap_i = g.row_word(word_idx, non_zero_off);
+			const int64_t src_c = word_idx * NBPE / num_local_verts;
+			for(; row_bitmap_i != 0; row_bitmap_i &= row_bitmap_i - 1, ++non_zero_off) {
+				const int64_t length = g.row_starts_[non_zero_off + 1] - g.row_starts_[non_zero_off];
+				if(length > seed[0]) {
+					seed[0] = length;
+					seed[1] = int64_t(g.orig_vertexes_[non_zero_off]) * mpi.size_2d + src_c * size_r + mpi.rank_2dr;
+				}
+			}
+		}
+		const int64_t local_seed_length = seed[0];
+		MPI_Allreduce(MPI_IN_PLACE, &seed[0], 1, MpiTypeOf<int64_t>::type, MPI_MAX, mpi.comm_2d);
+		if(local_seed_length != seed[0])
+			seed[1] = std::numeric_limits<int64_t>::max();
+		MPI_Allreduce(MPI_IN_PLACE, &seed[1], 1, MpiTypeOf<int64_t>::type, MPI_MIN, mpi.comm_2d);
+
+		g.is_giant_bitmap_ = (BitmapType*)cache_aligned_xcalloc(local_bitmap_width * sizeof(BitmapType));
+		// targets (of the processor column, Index: r * num_local_verts + local) that were already sent to their owner
+		BitmapType* is_sent = (BitmapType*)cache_aligned_xcalloc(local_bitmap_width * size_r * sizeof(BitmapType));
+		std::vector<uint32_t> frontier;
+		if(seed[0] >= 0 && vertex_owner(seed[1]) == mpi.rank_2d) {
+			const uint32_t seed_local = uint32_t(g.reorder_map_[vertex_local(seed[1])]);
+			g.is_giant_bitmap_[seed_local / NBPE] |= BitmapType(1) << (seed_local % NBPE);
+			frontier.push_back(seed_local);
+		}
+
+		std::vector<std::vector<uint32_t> > thread_sends(max_threads * size_r);
+		std::vector<uint32_t> src_frontier, send_buf, recv_buf;
+		std::vector<int> src_counts(size_c), src_offsets(size_c + 1);
+		std::vector<int> send_counts(size_r), send_offsets(size_r + 1), recv_counts(size_r), recv_offsets(size_r + 1);
+		int num_rounds = 0;
+		for(int64_t global_frontier = (seed[0] >= 0); global_frontier > 0; ++num_rounds) {
+			// the rows of the processor row see the frontier of all its columns
+			const int frontier_size = int(frontier.size());
+			MPI_Allgather(&frontier_size, 1, MPI_INT, src_counts.data(), 1, MPI_INT, mpi.comm_2dr);
+			src_offsets[0] = 0;
+			for(int c = 0; c < size_c; ++c)
+				src_offsets[c + 1] = src_offsets[c] + src_counts[c];
+			src_frontier.resize(src_offsets[size_c]);
+			MPI_Allgatherv(frontier.data(), frontier_size, MPI_UINT32_T,
+					src_frontier.data(), src_counts.data(), src_offsets.data(), MPI_UINT32_T, mpi.comm_2dr);
+
+#pragma omp parallel
+			{
+				std::vector<uint32_t>* const sends = &thread_sends[omp_get_thread_num() * size_r];
+#pragma omp for schedule(dynamic, 64)
+				for(int64_t i = 0; i < src_offsets[size_c]; ++i) {
+					const int c = int(std::upper_bound(src_offsets.begin(), src_offsets.end(), int(i)) - src_offsets.begin()) - 1;
+					const int64_t row = g.row_of(TwodVertex(c) * num_local_verts + src_frontier[i]);
+					if(row < 0)
+						continue;
+					for(int64_t e = g.row_starts_[row]; e < g.row_starts_[row + 1]; ++e) {
+						const int64_t tgt = g.edge_array_[e];
+						const int64_t dest = (tgt >> lgl) & r_mask;
+						const int64_t idx = dest * num_local_verts + (tgt & local_mask);
+						const BitmapType mask = BitmapType(1) << (idx % NBPE);
+						if(is_sent[idx / NBPE] & mask)
+							continue;
+						if(__sync_fetch_and_or(&is_sent[idx / NBPE], mask) & mask)
+							continue;
+						sends[dest].push_back(uint32_t(tgt & local_mask));
+					}
+				}
+			} // #pragma omp parallel
+
+			send_offsets[0] = 0;
+			for(int r = 0; r < size_r; ++r) {
+				send_counts[r] = 0;
+				for(int t = 0; t < max_threads; ++t)
+					send_counts[r] += int(thread_sends[t * size_r + r].size());
+				send_offsets[r + 1] = send_offsets[r] + send_counts[r];
+			}
+			send_buf.resize(send_offsets[size_r]);
+			for(int r = 0; r < size_r; ++r) {
+				int offset = send_offsets[r];
+				for(int t = 0; t < max_threads; ++t) {
+					std::vector<uint32_t>& sends = thread_sends[t * size_r + r];
+					std::copy(sends.begin(), sends.end(), send_buf.begin() + offset);
+					offset += int(sends.size());
+					sends.clear();
+				}
+			}
+			MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, mpi.comm_2dc);
+			recv_offsets[0] = 0;
+			for(int r = 0; r < size_r; ++r)
+				recv_offsets[r + 1] = recv_offsets[r] + recv_counts[r];
+			recv_buf.resize(recv_offsets[size_r]);
+			MPI_Alltoallv(send_buf.data(), send_counts.data(), send_offsets.data(), MPI_UINT32_T,
+					recv_buf.data(), recv_counts.data(), recv_offsets.data(), MPI_UINT32_T, mpi.comm_2dc);
+
+			// several rows of the processor column can reach the same vertex
+			frontier.clear();
+			for(size_t i = 0; i < recv_buf.size(); ++i) {
+				const uint32_t v = recv_buf[i];
+				const BitmapType mask = BitmapType(1) << (v % NBPE);
+				if(g.is_giant_bitmap_[v / NBPE] & mask)
+					continue;
+				g.is_giant_bitmap_[v / NBPE] |= mask;
+				frontier.push_back(v);
+			}
+			global_frontier = int64_t(frontier.size());
+			MPI_Allreduce(MPI_IN_PLACE, &global_frontier, 1, MpiTypeOf<int64_t>::type, MPI_SUM, mpi.comm_2d);
+		}
+		free(is_sent);
+
+		int64_t num_giant_vertices = 0;
+#pragma omp parallel for reduction(+:num_giant_vertices)
+		for(int64_t i = 0; i < local_bitmap_width; ++i)
+			num_giant_vertices += __builtin_popcountl(g.is_giant_bitmap_[i]);
+		g.giant_vertices_ = (LocalVertex*)cache_aligned_xmalloc(std::max<int64_t>(num_giant_vertices, 1) * sizeof(LocalVertex));
+		g.num_giant_vertices_ = 0;
+		for(int64_t i = 0; i < local_bitmap_width; ++i)
+			for(BitmapType bits = g.is_giant_bitmap_[i]; bits != 0; bits &= bits - 1)
+				g.giant_vertices_[g.num_giant_vertices_++] = LocalVertex(i * NBPE + __builtin_ctzl(bits));
+
+		// the words of the column settled bitmap (Index: r * num_local_verts + local) that can hold vertices of the component
+		BitmapType* column_giant_bitmap = (BitmapType*)cache_aligned_xmalloc(local_bitmap_width * size_r * sizeof(BitmapType));
+		MPI_Allgather(g.is_giant_bitmap_, local_bitmap_width, MpiTypeOf<BitmapType>::type,
+				column_giant_bitmap, local_bitmap_width, MpiTypeOf<BitmapType>::type, mpi.comm_2dc);
+		g.num_giant_column_words_ = 0;
+		for(int64_t i = 0; i < local_bitmap_width * size_r; ++i)
+			g.num_giant_column_words_ += (column_giant_bitmap[i] != 0);
+		g.giant_column_words_ = (int64_t*)cache_aligned_xmalloc(std::max<int64_t>(g.num_giant_column_words_, 1) * sizeof(int64_t));
+		for(int64_t i = 0, k = 0; i < local_bitmap_width * size_r; ++i)
+			if(column_giant_bitmap[i] != 0)
+				g.giant_column_words_[k++] = i;
+		free(column_giant_bitmap);
+
+		int64_t giant_size = g.num_giant_vertices_;
+		MPI_Allreduce(MPI_IN_PLACE, &giant_size, 1, MpiTypeOf<int64_t>::type, MPI_SUM, mpi.comm_2d);
+		if(mpi.isMaster()) print_with_prefix("Finished connected components after %d rounds: component of vertex %" PRId64 " has %" PRId64 " vertices (%f %% of the vertices with edges).",
+				num_rounds, seed[1], giant_size, 100.0 * double(giant_size) / double(std::max<int64_t>(g.num_global_verts_, 1)));
+		if(mpi.isMaster() && 2 * giant_size < g.num_global_verts_)
+			print_with_prefix("Warning: the component might not be the largest one, roots of the largest one would not be restricted.");
+	}
+#endif
+
 	//const int log_size_;
 	//const int rmask_;
 	//const int cmask_;
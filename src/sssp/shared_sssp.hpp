@@ -0,0 +1,275 @@
+/*
+ * shared_sssp.hpp
+ *
+ *  Delta-stepping for a single rank (mpi.size_2d == 1) directly on the Graph2DCSR:
+ *  no packets, no alltoall to ourselves and no expansion of the queues.
+ *  Each vertex keeps its tentative distance and the row of its predecessor in one
+ *  64-bit key, so an atomic minimum updates both consistently.
+ */
+
+#ifndef SRC_SSSP_SHARED_SSSP_HPP_
+#define SRC_SSSP_SHARED_SSSP_HPP_
+
+#include <vector>
+#include <limits>
+#include "parameters.h"
+#include "utils.hpp"
+#include "graph.hpp"
+
+class SharedMemorySssp
+{
+   typedef std::vector<LocalVertex> Bin;
+   static constexpr uint64_t no_row = 0xFFFFFFFFu; // predecessor row of the root and of unreached vertices
+   static constexpr int64_t no_bucket = std::numeric_limits<int64_t>::max();
+
+public:
+   SharedMemorySssp(const Graph2DCSR& graph)
+      : graph_(graph)
+      , keys_(NULL)
+      , expanded_(NULL)
+      , num_threads_(0)
+      , num_buckets_(0)
+      , num_light_phases_(0)
+   { }
+
+   ~SharedMemorySssp()
+   {
+      deallocate();
+   }
+
+   void allocate() {
+      const int64_t num_local_verts = graph_.num_local_verts_;
+      assert(mpi.size_2d == 1);
+      if( graph_.num_rows() >= int64_t(no_row) ) {
+         print_with_prefix("Too many rows for the shared-memory SSSP");
+         MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      num_threads_ = omp_get_max_threads();
+      keys_ = (uint64_t*)huge_aligned_xmalloc(num_local_verts * sizeof(*keys_), memory::TAG_VERTEX);
+      expanded_ = (uint32_t*)huge_aligned_xmalloc(num_local_verts * sizeof(*expanded_), memory::TAG_VERTEX);
+      bins_.resize(num_threads_);
+      expanded_lists_.resize(num_threads_);
+      thread_counts_.resize(num_threads_);
+   }
+
+   void deallocate() {
+      free(keys_); keys_ = NULL;
+      free(expanded_); expanded_ = NULL;
+      bins_.clear();
+      expanded_lists_.clear();
+      frontier_.clear();
+   }
+
+   bool is_allocated() const { return keys_ != NULL; }
+
+   // computes the distances and predecessors of the local (reordered) vertices from the root (original id);
+   // unreached vertices are not written
+   void run(int64_t root, float delta_step, float* dist, int64_t* pred) {
+      const int64_t num_local_verts = graph_.num_local_verts_;
+      const LocalVertex root_reordered = graph_.reorder_map_[vertex_local(root)];
+      assert(is_allocated());
+      num_buckets_ = num_light_phases_ = 0;
+      if( int64_t(root_reordered) >= num_local_verts )
+         return;
+
+      const uint32_t inf_bits = castFloatToUInt32(std::numeric_limits<float>::max());
+      const uint64_t inf_key = (uint64_t(inf_bits) << 32) | no_row;
+      const float bucket_width_inv = 1.0f / delta_step;
+      const int64_t* const restrict row_starts = graph_.row_starts_;
+      const int64_t* const restrict row_starts_heavy = graph_.row_starts_heavy_;
+      uint64_t* const restrict keys = keys_;
+      uint32_t* const restrict expanded = expanded_;
+
+#pragma omp parallel
+      {
+         const int tid = omp_get_thread_num();
+         std::vector<Bin>& bins = bins_[tid];
+         Bin& expanded_list = expanded_lists_[tid];
+         for( size_t b = 0; b < bins.size(); ++b )
+            bins[b].clear();
+
+#pragma omp for schedule(static)
+         for( int64_t v = 0; v < num_local_verts; ++v ) {
+            keys[v] = inf_key;
+            expanded[v] = inf_bits;
+         }
+
+#pragma omp single
+         {
+            keys[root_reordered] = no_row;
+            push(bins, 0, root_reordered);
+         } // implicit barrier
+
+         int64_t bucket = 0;
+         while( true ) {
+            // lowest non-empty bucket of all threads
+            int64_t own_min = no_bucket;
+            for( int64_t b = bucket; b < int64_t(bins.size()); ++b ) {
+               if( !bins[b].empty() ) {
+                  own_min = b;
+                  break;
+               }
+            }
+            thread_counts_[tid] = own_min;
+#pragma omp barrier
+            bucket = no_bucket;
+            for( int t = 0; t < num_threads_; ++t )
+               bucket = std::min(bucket, thread_counts_[t]);
+#pragma omp barrier // thread_counts_ is reused
+            if( bucket == no_bucket )
+               break;
+
+            if( bucket >= int64_t(bins.size()) )
+               bins.resize(bucket + 1);
+
+            // light phase, repeated until the bucket stays empty
+            while( true ) {
+               const int64_t total = gather_frontier(bins[bucket], tid);
+               if( total == 0 )
+                  break;
+#pragma omp single nowait
+               ++num_light_phases_;
+
+#pragma omp for schedule(dynamic, 64)
+               for( int64_t i = 0; i < total; ++i ) {
+                  const LocalVertex v = frontier_[i];
+                  const uint32_t dist_bits = uint32_t(keys[v] >> 32);
+                  const float dist_v = castUInt32ToFloat(dist_bits);
+                  if( bucket_of(dist_v, bucket_width_inv) != bucket ) // stale, improved into a lower bucket
+                     continue;
+
+                  // the first expansion of a vertex remembers it for the heavy edges
+                  uint32_t prev_bits = expanded[v];
+                  bool is_improved = false;
+                  while( dist_bits < prev_bits ) {
+                     const uint32_t prev = __sync_val_compare_and_swap(&expanded[v], prev_bits, dist_bits);
+                     if( prev == prev_bits ) {
+                        is_improved = true;
+                        break;
+                     }
+                     prev_bits = prev;
+                  }
+                  if( !is_improved )
+                     continue;
+                  if( v != root_reordered && graph_.local_vertex_isDeg1(v) ) // its only neighbor is closer
+                     continue;
+                  if( prev_bits == inf_bits )
+                     expanded_list.push_back(v);
+
+                  const int64_t row = graph_.row_of(v);
+                  if( row >= 0 )
+                     relax_edges(bins, row_starts[row], row_starts_heavy[row], row, dist_v, bucket_width_inv);
+               } // implicit barrier
+            }
+
+            // heavy phase: the distances of the bucket are final now
+            const int64_t num_expanded = gather_frontier(expanded_list, tid);
+#pragma omp for schedule(dynamic, 16)
+            for( int64_t i = 0; i < num_expanded; ++i ) {
+               const LocalVertex v = frontier_[i];
+               const int64_t row = graph_.row_of(v);
+               if( row >= 0 )
+                  relax_edges(bins, row_starts_heavy[row], row_starts[row + 1], row,
+                        castUInt32ToFloat(uint32_t(keys[v] >> 32)), bucket_width_inv);
+            } // implicit barrier
+
+#pragma omp single nowait
+            ++num_buckets_;
+            ++bucket;
+         }
+
+         const LocalVertex* const restrict orig_vertexes = graph_.orig_vertexes_;
+#pragma omp for schedule(static)
+         for( int64_t v = 0; v < num_local_verts; ++v ) {
+            const uint64_t key = keys[v];
+            if( (key >> 32) == inf_bits )
+               continue;
+            const uint64_t row = key & no_row;
+            dist[v] = castUInt32ToFloat(uint32_t(key >> 32));
+            pred[v] = (row == no_row) ? root : int64_t(orig_vertexes[row]);
+         }
+      } // #pragma omp parallel
+   }
+
+   int64_t num_buckets() const { return num_buckets_; }
+   int64_t num_light_phases() const { return num_light_phases_; }
+
+private:
+
+   static int64_t bucket_of(float dist, float bucket_width_inv) {
+      return int64_t(dist * bucket_width_inv);
+   }
+
+   // concatenates the lists of all threads into frontier_ and clears them; called by the whole team,
+   // returns the total length
+   int64_t gather_frontier(Bin& list, int tid) {
+      const int64_t own_size = int64_t(list.size());
+      thread_counts_[tid] = own_size;
+#pragma omp barrier
+      int64_t offset = 0;
+      int64_t total = 0;
+      for( int t = 0; t < num_threads_; ++t ) {
+         if( t == tid ) offset = total;
+         total += thread_counts_[t];
+      }
+#pragma omp barrier // thread_counts_ is reused
+      if( total == 0 )
+         return 0;
+
+#pragma omp single
+      {
+         if( int64_t(frontier_.size()) < total )
+            frontier_.resize(total);
+      } // implicit barrier
+
+      std::copy(list.begin(), list.end(), frontier_.begin() + offset);
+      list.clear();
+#pragma omp barrier
+      return total;
+   }
+
+   static void push(std::vector<Bin>& bins, int64_t bucket, LocalVertex v) {
+      if( bucket >= int64_t(bins.size()) )
+         bins.resize(bucket + 1);
+      bins[bucket].push_back(v);
+   }
+
+   void relax_edges(std::vector<Bin>& bins, int64_t e_start, int64_t e_end, int64_t row, float dist,
+         float bucket_width_inv)
+   {
+      const int64_t* const restrict edge_array = graph_.edge_array_;
+      const float* const restrict edge_weight_array = graph_.edge_weight_array_;
+      const int64_t local_mask = (int64_t(1) << graph_.local_bits_) - 1;
+      uint64_t* const restrict keys = keys_;
+
+      for( int64_t e = e_start; e < e_end; ++e ) {
+         const LocalVertex tgt = LocalVertex(edge_array[e] & local_mask);
+         const float dist_new = dist + edge_weight_array[e];
+         const uint64_t key = (uint64_t(castFloatToUInt32(dist_new)) << 32) | uint64_t(row);
+         uint64_t cur = keys[tgt];
+         while( key < cur ) {
+            const uint64_t prev = __sync_val_compare_and_swap(&keys[tgt], cur, key);
+            if( prev == cur ) {
+               // only a new distance needs a new queue entry
+               if( (key >> 32) != (cur >> 32) )
+                  push(bins, bucket_of(dist_new, bucket_width_inv), tgt);
+               break;
+            }
+            cur = prev;
+         }
+      }
+   }
+
+   const Graph2DCSR& graph_;
+   uint64_t* keys_; // distance bits (high) and predecessor row (low) of the local vertices
+   uint32_t* expanded_; // distance bits with which a vertex was expanded last
+   int num_threads_;
+   std::vector<std::vector<Bin> > bins_; // per thread: bucket -> vertices
+   std::vector<Bin> expanded_lists_; // per thread: vertices expanded in the current bucket, gathered for the heavy phase
+   std::vector<int64_t> thread_counts_;
+   std::vector<LocalVertex> frontier_; // vertices of the current light or heavy phase of all threads
+   int64_t num_buckets_;
+   int64_t num_light_phases_;
+};
+
+#endif /* SRC_SSSP_SHARED_SSSP_HPP_ */
@@ -27,6 +27,7 @@
 #include "fjmpi_comm.hpp"
 #include "bottom_up_comm.hpp"
 #include "sssp_state.hpp"
+#include "shared_sssp.hpp"
 #include "utils.hpp"
 #include "low_level_func.h"
 
@@ -61,6 +62,11 @@ public:
 
 		BUCKET_UNIT_SIZE = 1024,
 
+		// entries per independently coded block of compressed NQ expansion
+		NQ_CODE_BLOCK = 1024,
+		// min. number of row NQ entries for compressed expansion
+		NQ_COMPRESSION_MIN_SIZE = 8192,
+
 		// non-parameters
 		NBPE = PRM::NBPE,
 		LOG_NBPE = PRM::LOG_NBPE,
@@ -76,19 +82,14 @@ public:
 
 	class QueuedVertexes {
 	public:
-      int64_t preds[BUCKET_UNIT_SIZE];
-      LocalVertex v[BUCKET_UNIT_SIZE];
-      float weights[BUCKET_UNIT_SIZE];
+		LocalVertex v[BUCKET_UNIT_SIZE];
 		int length;
 		enum { SIZE = BUCKET_UNIT_SIZE };
 
 		QueuedVertexes() : length(0) { }
-		void append_nocheck(LocalVertex val, int64_t pred, float weight) {
-		   assert(weight >= 0.0);
+		void append_nocheck(LocalVertex val) {
 		   assert(length < SIZE);
-			v[length] = val;
-         preds[length] = pred;
-			weights[length++] = weight;
+			v[length++] = val;
 		}
 		bool full() { return (length == SIZE); }
 		int size() { return length; }
@@ -97,9 +98,29 @@ public:
 
 	struct ThreadLocalBuffer {
 		QueuedVertexes* cur_buffer;
+#if VERBOSE_MODE
+		// relaxation counts of this thread, added to profiling:: at the end of each top-down phase
+		int64_t node_shared_filtered;
+		int64_t hub_delegated;
+		int64_t fold_self_relaxed;
+		int64_t fold_sent_relaxed;
+#endif
 		LocalPacket fold_packet[1];
 	};
 
+	// values that are globally reduced at a phase boundary (in one packed reduction)
+	struct PhaseReduction {
+		int64_t nq_size; // sum
+		int64_t n_settled; // sum
+		int64_t next_bucket; // min
+	};
+
+	// tentative distance of a hub vertex, reduced by (dist, pred)
+	struct HubValue {
+		int64_t dist; // bits of the (non-negative) float distance
+		int64_t pred; // INT64_MAX if not improved in this phase
+	};
+
 	SsspBase()
 		: bottom_up_substep_(NULL)
 		, top_down_comm_(this)
@@ -113,6 +134,7 @@ public:
 		, denom_to_bottom_up_(DENOM_TOPDOWN_TO_BOTTOMUP)
 		, denom_bitmap_to_list_(DENOM_BITMAP_TO_LIST)
       , vertices_pos_(NULL)
+		, shared_sssp_(graph_)
 		, thread_sync_(omp_get_max_threads())
 	{
 	   const char* delta_step_char = std::getenv("DELTA_STEP");
@@ -121,6 +143,14 @@ public:
 	   is_bellman_ford_ = false;
 	   is_presolve_mode_ = false;
 	   work_buf_state_= Work_buf_state::none;
+	   scan_vertices_ = NULL;
+	   scan_size_ = 0;
+	   settled_in_component_ = clean_settled_component_ = false;
+	   distance_only_ = false;
+#if BUCKET_FUSION
+	   fusion_in_next_ = NULL;
+	   nq_is_fused_ = cq_is_fused_ = false;
+#endif
 
 	   if( delta_step_char ) {
 	      delta_step_ = atof(delta_step_char);
@@ -131,6 +161,7 @@ public:
 	   assert(0.0 < delta_step_ && delta_step_ <= 1.0);
 
 	   if( mpi.isMaster() ) print_with_prefix("delta_step=%f \n", delta_step_);
+	   if( mpi.isMaster() ) print_with_prefix("fold transport: %s \n", td_comm_.exchange_name());
 	}
 
 	virtual ~SsspBase()
@@ -148,9 +179,12 @@ public:
 
 		int log_local_verts_unit = get_msb_index(std::max<int>(BFELL_SORT, NBPE) * 8);
 
+		memory::TagScope tag_scope(memory::TAG_GRAPH);
 		detail::GraphConstructor2DCSR<EdgeList> constructor;
 		constructor.construct(edge_list, log_local_verts_unit, graph_);
 		graph_.separateHeavyEdges(delta_step_);
+		compress_rows();
+		place_edges();
 	}
 
 	void prepare_sssp() {
@@ -160,13 +194,55 @@ public:
 
 	void run_sssp(int64_t root, int64_t* pred, float* dist);
 
+	// with PRED_RECONSTRUCTION, the predecessors are not reconstructed and run_sssp sets all of them to -1
+	void set_distance_only(bool distance_only) { distance_only_ = distance_only; }
+
 	void end_sssp() {
 		deallocate_memory();
 	}
 
+	// prints the share of the pages of the edge and vertex arrays that are on the NUMA node
+	// of the thread that scans them
+	void print_numa_locality(const int64_t* pred, const float* dist) {
+#if NUMA_PLACEMENT
+		enum { EDGES, WEIGHTS, DIST, PRED, LOCKS, NUM_ARRAYS };
+		int64_t send_stats[2 * NUM_ARRAYS + 1] = { 0 };
+		const int64_t num_local_verts = graph_.num_local_verts_;
+		const EdgeOffset edge_offset(graph_);
+		numa::make_static_placement<int64_t>(graph_.row_bitmap_length(), edge_offset)
+				.count_local_pages(graph_.edge_array_, send_stats[2 * EDGES], send_stats[2 * EDGES + 1]);
+		numa::make_static_placement<float>(graph_.row_bitmap_length(), edge_offset)
+				.count_local_pages(graph_.edge_weight_array_, send_stats[2 * WEIGHTS], send_stats[2 * WEIGHTS + 1]);
+#if NODE_SHARED_DIST
+		dist = node_dist_local_;
+#endif
+		numa::make_static_placement<float>(num_local_verts)
+				.count_local_pages(dist, send_stats[2 * DIST], send_stats[2 * DIST + 1]);
+		numa::make_static_placement<int64_t>(num_local_verts)
+				.count_local_pages(pred, send_stats[2 * PRED], send_stats[2 * PRED + 1]);
+#if USE_DISTANCE_LOCKS
+		numa::make_static_placement<omp_lock_t>(num_local_verts)
+				.count_local_pages(vertices_locks_, send_stats[2 * LOCKS], send_stats[2 * LOCKS + 1]);
+#endif
+		send_stats[2 * NUM_ARRAYS] = numa::count_thread_nodes();
+		int64_t sum_stats[2 * NUM_ARRAYS];
+		int64_t max_nodes;
+		MPI_Reduce(send_stats, sum_stats, 2 * NUM_ARRAYS, MpiTypeOf<int64_t>::type, MPI_SUM, 0, mpi.comm_2d);
+		MPI_Reduce(&send_stats[2 * NUM_ARRAYS], &max_nodes, 1, MpiTypeOf<int64_t>::type, MPI_MAX, 0, mpi.comm_2d);
+		if( mpi.isMaster() ) {
+			double local_pct[NUM_ARRAYS];
+			for( int i = 0; i < NUM_ARRAYS; ++i )
+				local_pct[i] = (sum_stats[2 * i + 1] > 0) ? 100.0 * sum_stats[2 * i] / sum_stats[2 * i + 1] : 100.0;
+			print_with_prefix("NUMA locality (threads of a rank on up to %" PRId64 " nodes): pages local to their thread: "
+					"edges %.1f %%, weights %.1f %%, dist %.1f %%, pred %.1f %%, locks %.1f %%", max_nodes,
+					local_pct[EDGES], local_pct[WEIGHTS], local_pct[DIST], local_pct[PRED], local_pct[LOCKS]);
+		}
+#endif
+	}
+
    SsspState get_state() {
       const float bucket_upper = (delta_epoch_ + 1.0) * delta_step_;
-	   SsspState state = (SsspState){ vertices_isSettled_, bucket_upper, is_bellman_ford_, is_light_phase_, has_settled_vertices_, is_presolve_mode_};
+	   SsspState state = (SsspState){ vertices_isSettled_, bucket_upper, is_bellman_ford_, is_light_phase_, has_settled_vertices_, is_presolve_mode_, active_node_dists_};
 	   return state;
 	}
 
@@ -174,6 +250,53 @@ public:
 
 private:
 
+	// switches to the hypersparse row index if few rows of this rank are non-empty
+	void compress_rows() {
+#if HYPERSPARSE_ROWS
+		const int64_t bytes_bitmap = graph_.row_index_bytes();
+		const bool is_compressed = graph_.compress_rows(HYPERSPARSE_ROWS == 2);
+		int64_t send_stats[] = { is_compressed, bytes_bitmap, graph_.row_index_bytes() };
+		int64_t sum_stats[3];
+		MPI_Reduce(send_stats, sum_stats, 3, MpiTypeOf<int64_t>::type, MPI_SUM, 0, mpi.comm_2d);
+		if( mpi.isMaster() ) {
+			print_with_prefix("Hypersparse row index on %" PRId64 " of %d ranks, row index %f MB (%f MB with bitmaps)",
+					sum_stats[0], mpi.size_2d, to_mega(sum_stats[2]), to_mega(sum_stats[1]));
+		}
+#endif
+	}
+
+#if NUMA_PLACEMENT
+	// first edge of the rows of row bitmap word i, the edges are scanned by a static loop over these words
+	// in the bitmap top-down; the list top-down splits the CQ by its edges in each phase instead
+	struct EdgeOffset {
+		const GraphType& graph;
+		EdgeOffset(const GraphType& graph) : graph(graph) { }
+		int64_t operator()(int64_t word_idx) const {
+			if( word_idx == graph.row_bitmap_length() )
+				return graph.row_starts_[graph.num_rows()];
+			TwodVertex first_row;
+			graph.row_word(word_idx, first_row);
+			return graph.row_starts_[first_row];
+		}
+	};
+#endif
+
+	// moves the edges of the rows that each thread scans to the NUMA node of the thread; the construction
+	// placed them by first touch already, but only by an estimate of the final rows
+	void place_edges() {
+#if NUMA_PLACEMENT == 2
+		const EdgeOffset edge_offset(graph_);
+		int num_moved = numa::make_static_placement<int64_t>(graph_.row_bitmap_length(), edge_offset)
+				.move_pages(graph_.edge_array_);
+		if( !numa::make_static_placement<float>(graph_.row_bitmap_length(), edge_offset)
+				.move_pages(graph_.edge_weight_array_) )
+			num_moved = 0;
+		MPI_Reduce(mpi.isMaster() ? MPI_IN_PLACE : &num_moved, &num_moved, 1, MPI_INT, MPI_SUM, 0, mpi.comm_2d);
+		if( mpi.isMaster() )
+			print_with_prefix("Edges moved with mbind on %d of %d ranks (first touch on the others)", num_moved, mpi.size_2d);
+#endif
+	}
+
 	int64_t get_bitmap_size_src() const {
 		return graph_.num_local_verts_ / NBPE * mpi.size_2dr;
 	}
@@ -205,15 +328,20 @@ private:
 		const int64_t vertices_pos_length = graph_.num_local_verts_ * max_threads;
 #endif
 
+#if SHARED_MEMORY_ENGINE
+		if( mpi.size_2d == 1 )
+		   shared_sssp_.allocate();
+#endif
+
 		assert(!vertices_pos_);
-		vertices_pos_ = (int32_t*)cache_aligned_xmalloc(vertices_pos_length * sizeof(vertices_pos_[0]));
+		vertices_pos_ = (int32_t*)cache_aligned_xmalloc(vertices_pos_length * sizeof(vertices_pos_[0]), memory::TAG_DEDUP);
 
 #pragma omp parallel for schedule(static)
 		for( int64_t i = 0; i < vertices_pos_length; ++i )
 		   vertices_pos_[i] = -1;
 
 #if USE_DISTANCE_LOCKS
-		vertices_locks_ = (omp_lock_t*)cache_aligned_xmalloc(graph_.num_local_verts_ * sizeof(vertices_locks_[0]));
+		vertices_locks_ = (omp_lock_t*)huge_aligned_xmalloc(graph_.num_local_verts_ * sizeof(vertices_locks_[0]), memory::TAG_LOCKS);
 
 #pragma omp parallel for schedule(static)
 		for( int64_t i = 0; i < graph_.num_local_verts_; ++i )
@@ -238,12 +366,16 @@ private:
 		 */
 
 		a2a_comm_buf_.allocate_memory(graph_.num_local_verts_ * sizeof(int32_t) * 50); // TODO: accuracy previous value: 50
+#ifdef USE_BOTTOM_UP
+		bu_comm_.register_buffers();
+#endif
+		td_comm_.register_buffers();
 
 		top_down_comm_.max_num_rows = graph_.num_local_verts_ * 16 / PRM::TOP_DOWN_PENDING_WIDTH + 1000;
 		top_down_comm_.tmp_rows = (TopDownRow*)cache_aligned_xmalloc(
-				top_down_comm_.max_num_rows*2*sizeof(TopDownRow)); // for debug
+				top_down_comm_.max_num_rows*2*sizeof(TopDownRow), memory::TAG_COMM); // for debug
 
-		thread_local_buffer_ = (ThreadLocalBuffer**)cache_aligned_xmalloc(sizeof(thread_local_buffer_[0])*max_threads);
+		thread_local_buffer_ = (ThreadLocalBuffer**)cache_aligned_xmalloc(sizeof(thread_local_buffer_[0])*max_threads, memory::TAG_COMM);
 
 		const int bottom_up_vertex_count_per_thread = (bitmap_width/BU_SUBSTEP + max_threads - 1) / max_threads * NBPE;
 		const int packet_buffer_length = std::max(
@@ -251,7 +383,7 @@ private:
 				sizeof(TwodVertex) * 2 * bottom_up_vertex_count_per_thread);
 		const int buffer_width = roundup<int>(
 				sizeof(ThreadLocalBuffer) + packet_buffer_length, CACHE_LINE);
-		buffer_.thread_local_ = cache_aligned_xcalloc(buffer_width*max_threads);
+		buffer_.thread_local_ = cache_aligned_xcalloc(buffer_width*max_threads, memory::TAG_COMM);
 		for(int i = 0; i < max_threads; ++i) {
 			ThreadLocalBuffer* tlb = (ThreadLocalBuffer*)
 							((uint8_t*)buffer_.thread_local_ + buffer_width*i);
@@ -259,6 +391,7 @@ private:
 			thread_local_buffer_[i] = tlb;
 		}
 		packet_buffer_is_dirty_ = true;
+		nq_empty_buffer_.set_tag(memory::TAG_QUEUE);
 
 		enum { NBUF = PRM::BOTTOM_UP_BUFFER };
 		work_buf_size_ = std::max<uint64_t>( {
@@ -276,7 +409,7 @@ private:
 		nq_recv_buf_ = nullptr;
 		shared_visited_ = nullptr;
 		new_visited_ = old_visited_ = visited_buffer_ = visited_buffer_orig_ =  buffer_.shared_memory_ = nullptr;
-		work_buf_ = (int8_t*) page_aligned_xcalloc(work_buf_size_);
+		work_buf_ = (int8_t*) page_aligned_xcalloc(work_buf_size_, memory::TAG_QUEUE);
 
 #if 0
 		const int shared_offset_length = (max_threads * mpi.size_z * BU_SUBSTEP + 1);
@@ -304,7 +437,11 @@ private:
 		assert(smem_ptr == (int8_t*)buffer_.shared_memory_ + total_size_of_shared_memory);
 #endif
 
-		//vertices_isInCurrentBucket_ = (BitmapType*)cache_aligned_xmalloc(bitmap_width * sizeof(*vertices_isInCurrentBucket_));
+		vertices_isInCurrentBucket_ = (BitmapType*)cache_aligned_xcalloc(get_bitmap_size_local() * sizeof(*vertices_isInCurrentBucket_), memory::TAG_DEDUP);
+#if BUCKET_FUSION
+		fusion_in_next_ = (BitmapType*)cache_aligned_xcalloc(get_bitmap_size_local() * sizeof(*fusion_in_next_), memory::TAG_DEDUP);
+		fusion_next_.resize(max_threads);
+#endif
 
 		bottom_up_substep_ = new MpiBottomUpSubstepComm(mpi.comm_2dr);
 		bottom_up_substep_->register_memory(buffer_.shared_memory_, total_size_of_shared_memory);
@@ -312,9 +449,9 @@ private:
 		nq_buf_length_ = bitmap_width;
 		cq_root_list_ = nullptr;
 		nq_root_list_ = nullptr;
-		cq_distance_list_ = (float*)page_aligned_xmalloc(cq_distance_buf_length_ * sizeof(*cq_distance_list_));
-		nq_distance_list_ = (float*)page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_distance_list_));
-		nq_list_ = (TwodVertex*)page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_list_));
+		cq_distance_list_ = (float*)page_aligned_xmalloc(cq_distance_buf_length_ * sizeof(*cq_distance_list_), memory::TAG_QUEUE);
+		nq_distance_list_ = (float*)page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_distance_list_), memory::TAG_QUEUE);
+		nq_list_ = (TwodVertex*)page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_list_), memory::TAG_QUEUE);
 
 		assert(graph_.num_local_verts_ % NBPE == 0);
 		vertices_isSettled_ = (BitmapType*)cache_aligned_xmalloc(bitmap_width * sizeof(*vertices_isSettled_) * mpi.size_2dr);
@@ -323,17 +460,98 @@ private:
 		cq_any_ = NULL;
 		global_nq_size_ = max_nq_size_ = nq_size_ = cq_size_ = 0;
 		bitmap_or_list_ = false;
+
+		MPI_Type_contiguous(3, MpiTypeOf<int64_t>::type, &phase_reduction_type_);
+		MPI_Type_commit(&phase_reduction_type_);
+		MPI_Op_create(phase_reduction_reduce, 1, &phase_reduction_op_);
+		phase_reduction_requests_[0] = phase_reduction_requests_[1] = MPI_REQUEST_NULL;
+		nq_recv_sizes_.resize(mpi.comm_r.size);
+		next_bucket_cached_ = -1;
+
+		active_node_dists_ = NULL;
+		dist_user_ = NULL;
+#if NODE_SHARED_DIST
+		allocate_node_shared_dist();
+#endif
+#if HUB_DELEGATION_VERTICES
+		allocate_hubs();
+#endif
+	}
+
+#if HUB_DELEGATION_VERTICES
+	// replicates the distances of the first (i.e., highest degree) local vertices of each rank in the processor column
+	void allocate_hubs() {
+		hub_count_ = std::min<int64_t>(HUB_DELEGATION_VERTICES, graph_.num_local_verts_);
+		hub_slots_ = hub_count_ * mpi.size_2dr;
+		hub_keys_ = (uint64_t*)cache_aligned_xmalloc(hub_slots_ * sizeof(*hub_keys_));
+		hub_preds_ = (int64_t*)cache_aligned_xmalloc(hub_slots_ * omp_get_max_threads() * sizeof(*hub_preds_));
+		hub_values_.resize(hub_slots_);
+
+		MPI_Type_contiguous(2, MpiTypeOf<int64_t>::type, &hub_value_type_);
+		MPI_Type_commit(&hub_value_type_);
+		MPI_Op_create(hub_value_reduce, 1, &hub_value_op_);
+
+		if( mpi.isMaster() ) print_with_prefix("hub delegation: %" PRId64 " vertices per rank", hub_count_);
 	}
+#endif
+
+#if NODE_SHARED_DIST
+	// puts the distances into memory that is shared among the ranks of the processor column on the same node
+	void allocate_node_shared_dist() {
+		MPI_Comm_split_type(mpi.comm_2dc, MPI_COMM_TYPE_SHARED, mpi.rank_2dr, MPI_INFO_NULL, &node_col_comm_);
+		int node_size;
+		MPI_Comm_size(node_col_comm_, &node_size);
+
+		MPI_Win_allocate_shared(graph_.num_local_verts_ * sizeof(float), sizeof(float), MPI_INFO_NULL, node_col_comm_, &node_dist_local_, &node_dist_win_);
+#if NUMA_PLACEMENT
+		numa::make_static_placement<float>(graph_.num_local_verts_).first_touch(node_dist_local_);
+#endif
+
+		std::vector<int> node_ranks_2dr(node_size);
+		MPI_Allgather(&mpi.rank_2dr, 1, MPI_INT, node_ranks_2dr.data(), 1, MPI_INT, node_col_comm_);
+
+		node_dists_.assign(mpi.size_2dr, NULL);
+		for( int i = 0; i < node_size; ++i ) {
+			MPI_Aint size;
+			int disp_unit;
+			float* base;
+			MPI_Win_shared_query(node_dist_win_, i, &size, &disp_unit, &base);
+			assert(0 <= node_ranks_2dr[i] && node_ranks_2dr[i] < mpi.size_2dr);
+			node_dists_[node_ranks_2dr[i]] = base;
+		}
+
+		node_dist_clean_ = false;
+
+		if( mpi.isMaster() ) print_with_prefix("node-shared distances: %d co-located ranks per column", node_size);
+	}
+#endif
 
 	void deallocate_memory()
 	{
 	   assert(!cq_root_list_ && !nq_root_list_);
 	   free(vertices_isSettledLocal_); vertices_isSettledLocal_ = NULL;
 	   free(vertices_isSettled_); vertices_isSettled_ = NULL;
+	   free(vertices_isInCurrentBucket_); vertices_isInCurrentBucket_ = NULL;
+#if BUCKET_FUSION
+	   free(fusion_in_next_); fusion_in_next_ = NULL;
+#endif
 	   free(cq_distance_list_); cq_distance_list_ = NULL;
 	   free(nq_distance_list_); nq_distance_list_ = NULL;
 	   free(nq_list_); nq_list_ = NULL;
 	   free(vertices_pos_); vertices_pos_ = NULL;
+	   shared_sssp_.deallocate();
+	   MPI_Op_free(&phase_reduction_op_);
+	   MPI_Type_free(&phase_reduction_type_);
+#if NODE_SHARED_DIST
+	   MPI_Win_free(&node_dist_win_); node_dist_local_ = NULL;
+	   MPI_Comm_free(&node_col_comm_);
+#endif
+#if HUB_DELEGATION_VERTICES
+	   free(hub_keys_); hub_keys_ = NULL;
+	   free(hub_preds_); hub_preds_ = NULL;
+	   MPI_Op_free(&hub_value_op_);
+	   MPI_Type_free(&hub_value_type_);
+#endif
 
 #if USE_DISTANCE_LOCKS
 #pragma omp parallel for schedule(static)
@@ -346,6 +564,10 @@ private:
 		//shared_free(buffer_.shared_memory_); buffer_.shared_memory_ = NULL;
 		free(work_buf_);
 		free(thread_local_buffer_); thread_local_buffer_ = NULL;
+#ifdef USE_BOTTOM_UP
+		bu_comm_.release_buffers();
+#endif
+		td_comm_.release_buffers();
 		a2a_comm_buf_.deallocate_memory();
 	}
 
@@ -357,13 +579,13 @@ private:
          nq_buf_length_ = result_size;
          free(nq_list_);
          free(nq_distance_list_);
-         nq_distance_list_ = (float*) page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_distance_list_));
-         nq_list_ = (TwodVertex*) page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_list_));
+         nq_distance_list_ = (float*) page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_distance_list_), memory::TAG_QUEUE);
+         nq_list_ = (TwodVertex*) page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_list_), memory::TAG_QUEUE);
          // std::cout << mpi.rank_2d << " reallocate nq for bucket generation!" << '\n';
 
          if( nq_root_list_ ) {
             free(nq_root_list_);
-            nq_root_list_ = (int64_t*) page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_root_list_));
+            nq_root_list_ = (int64_t*) page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_root_list_), memory::TAG_QUEUE);
          }
       }
    }
@@ -375,7 +597,7 @@ private:
       if( work_buf_size_ < new_size ) {
          work_buf_size_ = new_size;
          free(work_buf_);
-         work_buf_ = page_aligned_xmalloc(work_buf_size_);
+         work_buf_ = page_aligned_xmalloc(work_buf_size_, memory::TAG_QUEUE);
       }
    }
 
@@ -387,8 +609,8 @@ public:
 	class CommBufferPool {
 	public:
 		void allocate_memory(int size) {
-			first_buffer_ = cache_aligned_xmalloc(size);
-			second_buffer_ = cache_aligned_xmalloc(size);
+			first_buffer_ = cache_aligned_xmalloc(size, memory::TAG_COMM);
+			second_buffer_ = cache_aligned_xmalloc(size, memory::TAG_COMM);
 			current_index_ = 0;
 			pool_buffer_size_ = size;
 			num_buffers_ = size / PRM::COMM_BUFFER_SIZE;
@@ -737,13 +959,15 @@ public:
 
    // marks already settled vertices in new_visited bitmap
    void bucket_mark_settled_bitmap() {
-      const uint64_t num_local_verts = graph_.num_local_verts_;
+      const int64_t scan_size = get_scan_size();
       const float bbound_upper = (delta_epoch_ + 1) * delta_step_;
       const float bbound_lower = (delta_epoch_) * delta_step_;
       BitmapType* const restrict is_settled = (BitmapType*)vertices_isSettledLocal_;
 
-#pragma omp parallel for schedule(static)
-      for( uint64_t i = 0; i < num_local_verts; i++ ) {
+      memory::g_team.parallel([&]() {
+#pragma omp for schedule(static) nowait
+      for( int64_t k = 0; k < scan_size; k++ ) {
+         const uint64_t i = scan_vertex(k);
 
 #if 0
          if( dist_[i] > bbound_upper && dist_[i] < bbound_lower + graph_.vertices_minweight_[i]  )
@@ -758,6 +982,7 @@ public:
             is_settled[word] |= BitmapType(1) << bit;
          }
       }
+      });
    }
 
    // expands settled vertices nq list (to bitmap)
@@ -782,16 +1007,54 @@ public:
       MPI_Allgatherv(nq_list_, n_settled, MpiTypeOf<TwodVertex>::type, recv_buf, recv_size, recv_off, MpiTypeOf<TwodVertex>::type, mpi.comm_c.comm);
 #endif
 
+      settled_list_to_bitmap(recv_buf, settled_size);
+   }
+
+   // expands settled vertices nq list in coded form (to bitmap); list needs to be sorted
+   void expand_settled_list_coded(int n_settled) {
+      const int comm_size = mpi.comm_c.size;
+      int recv_size[comm_size];
+      MPI_Allgather(&n_settled, 1, MPI_INT, recv_size, 1, MPI_INT, mpi.comm_c.comm);
+      int64_t settled_size = 0;
+      for( int i = 0; i < comm_size; ++i )
+         settled_size += recv_size[i];
+
+      memory::ScratchScope stream_scratch(scratch_);
+      int stream_bytes;
+      uint8_t* const stream = encode_vertex_stream(nq_list_, NULL, 0, n_settled, stream_bytes);
+
+      update_work_buf(settled_size * int64_t(sizeof(TwodVertex)));
+      TwodVertex* recv_buf = (TwodVertex*) work_buf_;
+      int64_t recv_bytes;
+      allgather_vertex_stream(stream, stream_bytes, recv_size, mpi.comm_c.comm, comm_size, 0, recv_buf, NULL, recv_bytes);
+      VERBOSE(g_expand_list_comm += recv_bytes);
+
+      settled_list_to_bitmap(recv_buf, settled_size);
+   }
+
+   // marks the given settled vertices (of the processor column) in the settled bitmap
+   void settled_list_to_bitmap(const TwodVertex* settled_list, int64_t settled_size) {
       const int lgl = graph_.local_bits_;
       const uint32_t local_mask = (uint32_t(1) << lgl) - 1;
       const int64_t num_local_verts = graph_.num_local_verts_;
 
-      if( !settled_is_clean )
+      if( !settled_is_clean ) {
+         if( clean_settled_component_ ) {
+            const int64_t* const giant_words = graph_.giant_column_words_;
+            memory::g_team.parallel([&]() {
+#pragma omp for schedule(static) nowait
+            for( int64_t k = 0; k < graph_.num_giant_column_words_; k++ )
+               vertices_isSettled_[giant_words[k]] = 0;
+            });
+         }
+         else
          memory::clean_mt(vertices_isSettled_, get_bitmap_size_local() * mpi.size_2dr * sizeof(*vertices_isSettled_));
+      }
 
-#pragma omp parallel for schedule(static)
-      for( int i = 0; i < settled_size; i++ ) {
-         const SeparatedId src(recv_buf[i]);
+      memory::g_team.parallel([&]() {
+#pragma omp for schedule(static) nowait
+      for( int64_t i = 0; i < settled_size; i++ ) {
+         const SeparatedId src(settled_list[i]);
          const TwodVertex src_c = src.value >> lgl;
          const TwodVertex compact = src_c * num_local_verts + (src.value & local_mask);
          const TwodVertex word_idx = compact >> LOG_NBPE;
@@ -801,13 +1064,14 @@ public:
 #pragma omp atomic update
          vertices_isSettled_[word_idx] |= (uint64_t(1) << bit_idx);
       }
+      });
 
       assert(!mpi.isYdimAvailable());
    }
 
    // marks newly settled vertices and stores in nq_list (but also marks bitmap)
    void bucket_mark_settled_list(int& n_settled_new) {
-      const uint64_t num_local_verts = graph_.num_local_verts_;
+      const int64_t scan_size = get_scan_size();
       const float bbound_upper = (delta_epoch_ + 1) * delta_step_;
       const float bbound_lower = (delta_epoch_) * delta_step_;
       BitmapType* const is_settled = (BitmapType*)vertices_isSettledLocal_;
@@ -815,13 +1079,13 @@ public:
       int threads_offset[max_threads + 1];
       const TwodVertex shifted_r = TwodVertex(mpi.rank_2dr) << graph_.local_bits_;
 
-#pragma omp parallel
-      {
+      memory::g_team.parallel([&]() {
          const int tid = omp_get_thread_num();
          int count = 0;
 
 #pragma omp for schedule(static) nowait
-         for( uint64_t i = 0; i < num_local_verts; i++ ) {
+         for( int64_t k = 0; k < scan_size; k++ ) {
+            const uint64_t i = scan_vertex(k);
             if( dist_[i] < bbound_upper || dist_[i] < bbound_lower + graph_.vertices_minweight_[i] ) {
                const uint64_t word = i >> LOG_NBPE;
                const uint64_t bit = i & NBPE_MASK;
@@ -845,7 +1109,8 @@ public:
 
          int offset = threads_offset[tid];
 #pragma omp for schedule(static) nowait
-         for( uint64_t i = 0; i < num_local_verts; i++ ) {
+         for( int64_t k = 0; k < scan_size; k++ ) {
+            const uint64_t i = scan_vertex(k);
             if( dist_[i] < bbound_upper || dist_[i] < bbound_lower + graph_.vertices_minweight_[i] ) {
                const uint64_t word = i >> LOG_NBPE;
                const uint64_t bit = i & NBPE_MASK;
@@ -857,25 +1122,40 @@ public:
                }
             }
          }
-      } // parallel region
+      }); // parallel region
    }
 
-   // expands settled vertices as bitmap
-   void bucket_expand_settled_bitmap(int64_t global_nq_size) {
+   // expands settled vertices as bitmap; global_settled_size is the (estimated) number of newly settled vertices
+   void bucket_expand_settled_bitmap(int64_t global_settled_size) {
 #if VERBOSE_MODE
       const double expand_start_time = MPI_Wtime();
 #endif
 
-      const double ratio = double(global_nq_size) / double(graph_.num_global_verts_);
+      // choose representation with least (estimated) volume; lists are weighted by 2 for the processing overhead
+      const int64_t bitmap_bytes = graph_.num_local_verts_ * mpi.size_2d / CHAR_BIT;
+      const int64_t list_bytes = global_settled_size * int64_t(sizeof(TwodVertex));
+#if SETTLED_EXPAND_COMPRESSION
+      const int64_t coded_bytes = global_settled_size * vlq::sparsity_factor(graph_.num_local_verts_ * mpi.size_2d, global_settled_size);
+      const bool use_coded = (global_settled_size >= NQ_CODE_BLOCK && 4 * coded_bytes < 3 * list_bytes);
+#else
+      const int64_t coded_bytes = list_bytes;
+      const bool use_coded = false;
+#endif
 
-      // todo use parameter
-      if( ratio < 0.008 ) {
+      if( 2 * (use_coded ? coded_bytes : list_bytes) < bitmap_bytes ) {
          int n_settled_new;
          bucket_mark_settled_list(n_settled_new);
-         expand_settled_list(n_settled_new);
 
-         if( mpi.isMaster() )
-            printf("...expanded settled vertices! (list + calib) \n");
+         if( use_coded ) {
+            expand_settled_list_coded(n_settled_new);
+            if( mpi.isMaster() )
+               printf("...expanded settled vertices! (coded list + calib) \n");
+         }
+         else {
+            expand_settled_list(n_settled_new);
+            if( mpi.isMaster() )
+               printf("...expanded settled vertices! (list + calib) \n");
+         }
       }
       else {
          bucket_mark_settled_bitmap();
@@ -894,86 +1174,175 @@ public:
 #endif
    }
 
+   // gets index of the bucket (after the current epoch) that contains the given distance
+   int bucket_get_index(float min) const {
+      int index = std::numeric_limits<int>::max();
+      if( min < comp::infinity )
+      {
+         const double delta_step = delta_step_;
+         index = int(double(min) / delta_step - double(comp::eps_default));
+         if( !comp::isGE(min, index * delta_step) || index == delta_epoch_ )
+            index++;
+
+         if( min >= (index + 1.0) * delta_step )
+            index++;
+
+         assert(comp::isGE(min, index * delta_step) && min < (index + 1.0) * delta_step);
+
+         // todo remove
+         if( !comp::isGE(min, index * delta_step) || min >= (index + 1.0) * delta_step ) {
+            printf("numerics issue with delta step! \n");
+            print_with_prefix("issue: min=%f (index + 1) * delta_step)=%f  delta_epoch_=%d", min, (index + 1) * delta_step, delta_epoch_);
+            print_with_prefix("issue: min=%f index * delta_step_=%f, index=%d", min, index * delta_step, index);
+            MPI_Barrier(MPI_COMM_WORLD);
+            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+         }
+      }
+      return index;
+   }
+
 	// gets index of next non-empty bucket
    int bucket_get_next_nonempty(bool with_z) {
       TRACER(td_make_nq_list);
       assert(!with_z && "currently not supported"); // if ever use with_z, then change as in top_down_make_nq_list
       assert(!is_bellman_ford_);
 
+      // already reduced at the end of the heavy phase or at the beginning of an empty one?
+      if( next_bucket_cached_ >= 0 ) {
+         const int index = next_bucket_cached_;
+         next_bucket_cached_ = -1;
+         return index;
+      }
+
+      int index = bucket_get_local_next_nonempty();
+      MPI_Allreduce(MPI_IN_PLACE, &index, 1, MpiTypeOf<int>::type, MPI_MIN, mpi.comm_2d);
+
+      return index;
+   }
+
+   // gets index of the next local non-empty bucket
+   int bucket_get_local_next_nonempty() {
       const int max_threads = omp_get_max_threads();
       const float bbound_lower = (delta_epoch_ + 1) * delta_step_;
       float mindists[max_threads];
 
       //printf("[%f, %f] \n", bbound_lower, bbound_upper);
-#pragma omp parallel
-      {
-         const uint64_t num_local_verts = uint64_t(graph_.num_local_verts_);
+      memory::g_team.parallel([&]() {
+         const int64_t scan_size = get_scan_size();
          const int tid = omp_get_thread_num();
          float min = std::numeric_limits<float>::max();
 
 #pragma omp for schedule(static) nowait
-         for( uint64_t i = 0; i < num_local_verts; i++ ) {
+         for( int64_t k = 0; k < scan_size; k++ ) {
+            const uint64_t i = scan_vertex(k);
             if( comp::isGE(dist_[i], bbound_lower) && dist_[i] < min )
                min = dist_[i];
          }
 
          mindists[tid] = min;
-      } // omp parallel
+      }); // omp parallel
 
       float min = mindists[0];
       for( int i = 1; i < max_threads; i++ )
          if( mindists[i] < min )
             min = mindists[i];
 
-      int index = std::numeric_limits<int>::max();
-      if( min < comp::infinity )
-      {
-         const double delta_step = delta_step_;
-         index = int(double(min) / delta_step - double(comp::eps_default));
-         if( !comp::isGE(min, index * delta_step) || index == delta_epoch_ )
-            index++;
-
-         if( min >= (index + 1.0) * delta_step )
-            index++;
+      return bucket_get_index(min);
+   }
 
-         assert(comp::isGE(min, index * delta_step) && min < (index + 1.0) * delta_step);
+   // gets global size of the current bucket (without degree one vertices), the number of newly settled vertices and the next non-empty bucket
+   PhaseReduction bucket_get_sizes() {
+      assert(!is_bellman_ford_);
+      const float bbound_lower = delta_epoch_ * delta_step_;
+      const float bbound_upper = (delta_epoch_ + 1.0) * delta_step_;
+      const BitmapType* const is_settled = vertices_isSettledLocal_;
+
+      const int64_t scan_size = get_scan_size();
+      int64_t count = 0;
+      int64_t n_settled = 0;
+      float min_next = std::numeric_limits<float>::max();
+
+      memory::g_team.parallel([&]() {
+#pragma omp for reduction(+: count, n_settled) reduction(min: min_next) schedule(static)
+      for( int64_t k = 0; k < scan_size; k++ ) {
+         const uint64_t i = scan_vertex(k);
+         const float dist = dist_[i];
+         if( comp::isGE(dist, bbound_lower) && dist < bbound_upper ) {
+            if( !graph_.local_vertex_isDeg1(i) && !bucket_vertex_is_pruned(i, dist, bbound_upper) )
+               count++;
+         }
+         else if( comp::isGE(dist, bbound_upper) && dist < min_next ) {
+            min_next = dist;
+         }
 
-         // todo remove
-         if( !comp::isGE(min, index * delta_step) || min >= (index + 1.0) * delta_step ) {
-            printf("numerics issue with delta step! \n");
-            print_with_prefix("issue: min=%f (index + 1) * delta_step)=%f  delta_epoch_=%d", min, (index + 1) * delta_step, delta_epoch_);
-            print_with_prefix("issue: min=%f index * delta_step_=%f, index=%d", min, index * delta_step, index);
-            MPI_Barrier(MPI_COMM_WORLD);
-            MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+         // same criterion as in bucket_mark_settled_list
+         if( dist < bbound_upper || dist < bbound_lower + graph_.vertices_minweight_[i] ) {
+            if( !(is_settled[i >> LOG_NBPE] & BitmapType(1) << (i & NBPE_MASK)) )
+               n_settled++;
          }
       }
+      });
 
-      MPI_Allreduce(MPI_IN_PLACE, &index, 1, MpiTypeOf<int>::type, MPI_MIN, mpi.comm_2d);
+      phase_reduction_start(count, n_settled, bucket_get_index(min_next));
+      return phase_reduction_wait();
+   }
 
-      return index;
+   // combines the phase values of two processes
+   static void phase_reduction_reduce(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype) {
+      const PhaseReduction* in = (const PhaseReduction*) invec;
+      PhaseReduction* inout = (PhaseReduction*) inoutvec;
+      for( int i = 0; i < *len; i++ ) {
+         inout[i].nq_size += in[i].nq_size;
+         inout[i].n_settled += in[i].n_settled;
+         inout[i].next_bucket = std::min(inout[i].next_bucket, in[i].next_bucket);
+      }
    }
 
-   int64_t bucket_get_nq_size() {
-      const float bbound_lower = delta_epoch_ * delta_step_;
-      const float bbound_upper = is_bellman_ford_ ? comp::infinity : (delta_epoch_ + 1.0) * delta_step_;
+   // starts the (non-blocking) global reduction of the phase values
+   void phase_reduction_start(int64_t nq_size, int64_t n_settled, int next_bucket) {
+      assert(phase_reduction_requests_[0] == MPI_REQUEST_NULL);
+      const PhaseReduction send = { nq_size, n_settled, next_bucket };
+      phase_reduction_send_ = send;
+      MPI_Iallreduce(&phase_reduction_send_, &phase_reduction_recv_, 1, phase_reduction_type_, phase_reduction_op_,
+            mpi.comm_2d, &phase_reduction_requests_[0]);
+   }
 
-      const uint64_t num_local_verts = uint64_t(graph_.num_local_verts_);
-      int count = 0;
+   // starts the (non-blocking) gathering of the local NQ sizes within the processor row
+   void phase_gather_nq_size_start(int nq_size) {
+      assert(phase_reduction_requests_[1] == MPI_REQUEST_NULL);
+      nq_send_size_ = nq_size;
+      MPI_Iallgather(&nq_send_size_, 1, MPI_INT, nq_recv_sizes_.data(), 1, MPI_INT, mpi.comm_r.comm,
+            &phase_reduction_requests_[1]);
+   }
 
-#pragma omp parallel for reduction(+: count) schedule(static)
-      for( uint64_t i = 0; i < num_local_verts; i++ ) {
-         if( comp::isGE(dist_[i], bbound_lower) && dist_[i] < bbound_upper ) {
-            if( graph_.local_vertex_isDeg1(i) ) {
-               continue;
-            }
-            count++;
-         }
-      }
+   // waits for the pending phase reduction and NQ size gathering
+   const PhaseReduction& phase_reduction_wait() {
+      MPI_Waitall(2, phase_reduction_requests_, MPI_STATUSES_IGNORE);
+      return phase_reduction_recv_;
+   }
+
+   // number of local vertices the bucket scans have to visit in the current run
+   int64_t get_scan_size() const {
+      return scan_vertices_ ? scan_size_ : graph_.num_local_verts_;
+   }
+
+   // k-th vertex visited by the bucket scans, in ascending order
+   uint64_t scan_vertex(int64_t k) const {
+      return scan_vertices_ ? uint64_t(scan_vertices_[k]) : uint64_t(k);
+   }
 
-      int64_t send_nq_size = count;
-      int64_t nq_sum;
-      MPI_Allreduce(&send_nq_size, &nq_sum, 1, MpiTypeOf<int64_t>::type, MPI_SUM, mpi.comm_2d);
-      return nq_sum;
+   // does the bucket vertex have nothing to relax in the current phase? In the light phase this holds if all its edges
+   // are outer-short (leave the bucket), in the heavy phase if all of them are inner-short (already relaxed)
+   bool bucket_vertex_is_pruned(uint64_t v, float dist, float bbound_upper) const {
+#if SHORT_EDGE_PRUNING
+      if( is_bellman_ford_ || is_presolve_mode_ )
+         return false;
+      if( is_light_phase_ )
+         return !(graph_.vertices_minweight_[v] + dist < bbound_upper); // same test as in the light phase send loop
+      return comp::isLT(graph_.vertices_maxweight_[v] + dist, bbound_upper); // same test as in the heavy phase send loop
+#else
+      return false;
+#endif
    }
 
    int bucket_make_nq_list(bool with_z, TwodVertex shifted_rc) {
@@ -986,23 +1355,37 @@ public:
       const float bbound_lower = delta_epoch_ * delta_step_;
       const float bbound_upper = is_bellman_ford_ ? comp::infinity : (delta_epoch_ + 1.0) * delta_step_;
 
+      // an empty light phase would end the epoch, so the light phase starts with the whole bucket
+      const bool with_pruning = !is_light_phase_;
+      int64_t num_pruned = 0;
+
       //printf("[%f, %f] \n", bbound_lower, bbound_upper);
-#pragma omp parallel
-      {
+      memory::g_team.parallel([&]() {
+#ifndef NDEBUG
          const uint64_t num_local_verts = uint64_t(graph_.num_local_verts_);
+#endif
+         const int64_t scan_size = get_scan_size();
          const int tid = omp_get_thread_num();
          int count = 0;
+         int64_t thread_pruned = 0;
 
 #pragma omp for schedule(static) nowait
-         for( uint64_t i = 0; i < num_local_verts; i++ ) {
+         for( int64_t k = 0; k < scan_size; k++ ) {
+            const uint64_t i = scan_vertex(k);
             if( comp::isGE(dist_[i], bbound_lower) && dist_[i] < bbound_upper ) {
                if( graph_.local_vertex_isDeg1(i) ) {
                   continue;
                }
+               if( with_pruning && bucket_vertex_is_pruned(i, dist_[i], bbound_upper) ) {
+                  thread_pruned++;
+                  continue;
+               }
                count++;
             }
          }
          threads_offset[tid + 1] = count;
+#pragma omp atomic
+         num_pruned += thread_pruned;
 #pragma omp barrier
 #pragma omp single
          {
@@ -1023,9 +1406,10 @@ public:
          int offset = threads_offset[tid];
          const bool next_bitmap_or_list = next_bitmap_or_list_;
 #pragma omp for schedule(static) nowait
-         for( uint64_t i = 0; i < num_local_verts; i++ ) {
+         for( int64_t k = 0; k < scan_size; k++ ) {
+            const uint64_t i = scan_vertex(k);
             if( comp::isGE(dist_[i], bbound_lower) && dist_[i] < bbound_upper ) {
-               if( graph_.local_vertex_isDeg1(i) ) {
+               if( graph_.local_vertex_isDeg1(i) || (with_pruning && bucket_vertex_is_pruned(i, dist_[i], bbound_upper)) ) {
                   continue;
                }
                assert(nq_list_[offset] == num_local_verts);
@@ -1045,7 +1429,8 @@ public:
             print_with_prefix("bucket issue!");
             MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
          }
-      }
+      });
+      VERBOSE(profiling::pruned_vertices[1] += num_pruned);
 
       return result_size;
    }
@@ -1063,14 +1448,25 @@ public:
 		int th_offset_storage[max_threads+1];
 		int *th_offset = with_z ? s_.offset : th_offset_storage;
 
-		int64_t* nq_preds = nullptr;
+#ifndef NDEBUG
+		const int64_t num_local_verts = graph_.num_local_verts_;
+#endif
+		const float bucket_upper = (delta_epoch_ + 1.0) * delta_step_;
+		const bool is_list = !next_bitmap_or_list_;
+		const TwodVertex shift = is_list ? shifted_rc : 0;
+		BitmapType* const restrict in_nq = vertices_isInCurrentBucket_;
+		int th_kept[node_threads + 1];
+		int64_t num_pruned = 0;
 
 		int result_size = 0;
 		const int num_buffers = nq_.stack_.size();
-#pragma omp parallel
-		{
+		// a single buffer is not worth waking up the other threads (frequent in the tail phases)
+		const bool is_parallel = (num_buffers > 1);
+		const int team_size = is_parallel ? node_threads : 1;
+		memory::g_team.parallel([&]() {
 			const int tid = omp_get_thread_num() + max_threads * rank_z;
 			int count = 0;
+			int64_t thread_pruned = 0;
 #pragma omp for schedule(static) nowait
 			for(int i = 0; i < num_buffers; ++i) {
 				count += nq_.stack_[i]->length;
@@ -1080,127 +1476,100 @@ public:
 #pragma omp single
 			{
             th_offset[0] = 0;
-            for(int i = 0; i < node_threads; ++i) {
+            for(int i = 0; i < team_size; ++i) {
                th_offset[i+1] += th_offset[i];
             }
 
 				//if(with_z) s_.sync->barrier();
-				result_size = th_offset[node_threads];
-
-            update_nq_capacity(result_size);
-
-            if( is_presolve_mode_ )
-               nq_preds = nq_root_list_;
-            else
-               nq_preds = (int64_t*) cache_aligned_xmalloc(result_size * sizeof(*nq_preds));
+				if( nq_dedup_buf_.size() < size_t(th_offset[team_size]) ) {
+				   const size_t old_capacity = nq_dedup_buf_.capacity();
+				   nq_dedup_buf_.resize(th_offset[team_size]);
+				   memory::add_usage(memory::TAG_DEDUP, (nq_dedup_buf_.capacity() - old_capacity) * sizeof(LocalVertex));
+				}
 			} // implicit barrier
-#ifndef NDEBUG
-#pragma omp for schedule(static)
-			for(int i = 0; i < result_size; ++i)
-			   nq_list_[i] = graph_.num_local_verts_;
-#endif
 
-			int offset = th_offset[tid];
+			// the first thread that marks a vertex keeps it, its distance (and predecessor) is already in dist_ (pred_)
+			LocalVertex* const restrict unique = nq_dedup_buf_.data() + th_offset[tid];
+			int n_unique = 0;
 #pragma omp for schedule(static) nowait
 			for(int i = 0; i < num_buffers; ++i) {
-			   assert(nq_preds);
 				const int len = nq_.stack_[i]->length;
 				const LocalVertex* const src = nq_.stack_[i]->v;
-            const int64_t* const preds = nq_.stack_[i]->preds;
-				const float* const src_weights = nq_.stack_[i]->weights;
-				TwodVertex* restrict dst = nq_list_ + offset;
-				int64_t* restrict dst_preds = nq_preds + offset;
-				float* restrict dst_weights = nq_distance_list_ + offset;
-				assert(len + offset <= nq_buf_length_);
-
 				for(int c = 0; c < len; ++c) {
-					dst[c] = src[c]; // | shifted_rc;
-					dst_weights[c] = src_weights[c];
-					dst_preds[c] = preds[c];
+				   const LocalVertex vertex = src[c];
+				   assert(vertex < num_local_verts);
+				   const BitmapType mask = BitmapType(1) << (vertex & NBPE_MASK);
+				   BitmapType* const word = &in_nq[vertex >> LOG_NBPE];
+				   if( (*word & mask) || (__sync_fetch_and_or(word, mask) & mask) )
+				      continue;
+				   unique[n_unique++] = vertex;
 				}
-
-				offset += len;
 			}
-			assert (offset == th_offset[tid+1]);
-		} // implicit barrier
-
-      const int64_t num_local_verts = graph_.num_local_verts_;
-
-		// filter out duplicates
-		for( int i = 0; i < result_size; i++ ) {
-		   const int64_t vertex = int64_t(nq_list_[i]);
-
-		   assert(0 <= vertex && vertex < num_local_verts);
-		   if( vertices_pos_[vertex] < 0 ) {
-		      vertices_pos_[vertex] = i;
-		      dist_[vertex] = nq_distance_list_[i];
-		      pred_[vertex] = nq_preds[i];
-		      continue;
-		   }
-
-		   const int twin_pos = vertices_pos_[vertex];
-		   assert(nq_list_[i] == nq_list_[twin_pos]);
-		   assert(twin_pos < i);
-
-		   if( nq_distance_list_[i] < nq_distance_list_[twin_pos] ) {
-            vertices_pos_[vertex] = i;
-		      nq_list_[twin_pos] = num_local_verts;
-
-            dist_[vertex] = nq_distance_list_[i];
-            pred_[vertex] = nq_preds[i];
-		   }
-		   else {
-		      nq_list_[i] = num_local_verts;
-		   }
-		}
-
-		const int result_size_old = result_size;
-		result_size = 0;
-
-      if( next_bitmap_or_list_ ) {
-         for( int i = 0; i < result_size_old; i++ ) {
-            const TwodVertex vertex = nq_list_[i];
-            if( vertex >= uint64_t(num_local_verts) )
-               continue;
-
-            vertices_pos_[vertex] = -1;
-            if( graph_.local_vertex_isDeg1(vertex) )
-               continue;
-
-            nq_list_[result_size] = vertex; // here is the difference
-            if( is_presolve_mode_ ) nq_root_list_[result_size] = nq_root_list_[i];
-            nq_distance_list_[result_size++] = nq_distance_list_[i];
-         }
-         assert(0 && "todo should not be used by now");
-      }
-      else {
-         for( int i = 0; i < result_size_old; i++ ) {
-            const TwodVertex vertex = nq_list_[i];
-            if( vertex >= uint64_t(num_local_verts) )
-               continue;
+			assert(n_unique <= th_offset[tid+1] - th_offset[tid]);
+#pragma omp barrier
 
-            vertices_pos_[vertex] = -1;
-            if( graph_.local_vertex_isDeg1(vertex) )
-               continue;
+			// unmarks the vertices and removes those that are not to be expanded
+			int n_kept = 0;
+			for(int k = 0; k < n_unique; ++k) {
+			   const LocalVertex vertex = unique[k];
+			   in_nq[vertex >> LOG_NBPE] &= ~(BitmapType(1) << (vertex & NBPE_MASK));
+			   if( graph_.local_vertex_isDeg1(vertex) )
+			      continue;
+			   if( is_list && bucket_vertex_is_pruned(vertex, dist_[vertex], bucket_upper) ) {
+			      thread_pruned++;
+			      continue;
+			   }
+			   unique[n_kept++] = vertex;
+			}
+			th_kept[tid+1] = n_kept;
+#pragma omp atomic
+			num_pruned += thread_pruned;
+#pragma omp barrier
+#pragma omp single
+			{
+			   th_kept[0] = 0;
+			   for(int i = 0; i < team_size; ++i)
+			      th_kept[i+1] += th_kept[i];
+			   result_size = th_kept[team_size];
+			   update_nq_capacity(result_size);
+			} // implicit barrier
 
-            nq_list_[result_size] = vertex | shifted_rc; // here is the difference
-            if( is_presolve_mode_ ) nq_root_list_[result_size] = nq_root_list_[i];
-            nq_distance_list_[result_size++] = nq_distance_list_[i];
-         }
-      }
+			TwodVertex* const restrict dst = nq_list_ + th_kept[tid];
+			float* const restrict dst_dists = nq_distance_list_ + th_kept[tid];
+			for(int k = 0; k < n_kept; ++k) {
+			   const LocalVertex vertex = unique[k];
+			   dst[k] = vertex | shift;
+			   dst_dists[k] = dist_[vertex];
+			   if( is_presolve_mode_ ) nq_root_list_[th_kept[tid] + k] = pred_[vertex];
+			}
+		}, is_parallel); // #pragma omp parallel
+		VERBOSE(profiling::pruned_vertices[0] += num_pruned);
 
-      if( !is_presolve_mode_ )
-         free(nq_preds);
+		assert(is_list && "todo should not be used by now");
+#if BUCKET_FUSION
+		if( is_list && !is_presolve_mode_ && !is_bellman_ford_ )
+		   result_size = top_down_fuse_bucket(result_size, shifted_rc);
+#endif
 		return result_size;
 	}
 
-	void top_down_expand_nq(int nq_size) {
+	// expands the NQ within the processor row; row_nq_sizes are the already gathered NQ sizes of the row (if available)
+	void top_down_expand_nq(int nq_size, const int* row_nq_sizes = NULL) {
 		TRACER(td_expand_nq_list);
 		assert(nq_size >= 0);
+#if BUCKET_FUSION
+		cq_is_fused_ = nq_is_fused_;
+		nq_is_fused_ = false;
+#endif
 		const int comm_size = mpi.comm_r.size;
 		int recv_size[comm_size];
 		int recv_off[comm_size+1];
-		MPI_Allgather(&nq_size, 1, MPI_INT, recv_size, 1, MPI_INT, mpi.comm_r.comm);
+		if( row_nq_sizes ) {
+		   memcpy(recv_size, row_nq_sizes, comm_size * sizeof(*recv_size));
+		}
+		else {
+		   MPI_Allgather(&nq_size, 1, MPI_INT, recv_size, 1, MPI_INT, mpi.comm_r.comm);
+		}
 		recv_off[0] = 0;
 		for(int i = 0; i < comm_size; ++i) {
 			recv_off[i+1] = recv_off[i] + recv_size[i];
@@ -1210,25 +1579,38 @@ public:
 		if( cq_distance_buf_length_ < int64_t(cq_size_) ) {
 		   cq_distance_buf_length_ = int64_t(cq_size_);
 		   free(cq_distance_list_);
-		   cq_distance_list_ = (float*)page_aligned_xmalloc(cq_distance_buf_length_ * sizeof(*cq_distance_list_));
+		   cq_distance_list_ = (float*)page_aligned_xmalloc(cq_distance_buf_length_ * sizeof(*cq_distance_list_), memory::TAG_QUEUE);
 
 		   if( cq_root_list_ ) {
 		      free(cq_root_list_);
-		      cq_root_list_ = (int64_t*)page_aligned_xmalloc(cq_distance_buf_length_ * sizeof(*cq_root_list_));
+		      cq_root_list_ = (int64_t*)page_aligned_xmalloc(cq_distance_buf_length_ * sizeof(*cq_root_list_), memory::TAG_QUEUE);
 		   }
 		}
 
+#if VERBOSE_MODE
+		if( !next_bitmap_or_list_ )
+		   profiling::expand_list_raw_bytes += int64_t(cq_size_) * int64_t(sizeof(TwodVertex) + sizeof(float));
+#endif
+
+		if( !next_bitmap_or_list_ && expand_nq_use_compression(recv_size, comm_size) ) {
+		   top_down_expand_nq_compressed(nq_size, recv_size);
+		   return;
+		}
+
 		// using bitmap?
 		if( next_bitmap_or_list_ ) {
 	      const int64_t bitmap_width = get_bitmap_size_local();
 	      assert(mpi.comm_r.size == mpi.size_2dc);
 	      assert(work_buf_size_ >= mpi.size_2dc * bitmap_width * int64_t(sizeof(BitmapType)));
-	      BitmapType* const restrict nq_bitmap = (BitmapType*)cache_aligned_xcalloc(bitmap_width * sizeof(*nq_bitmap));
+	      memory::ScratchScope phase_scratch(scratch_);
+	      BitmapType* const restrict nq_bitmap = phase_scratch.alloc<BitmapType>(bitmap_width);
+	      memset(nq_bitmap, 0, bitmap_width * sizeof(*nq_bitmap));
 	      BitmapType* recv_buffer_bitmap = (BitmapType*) work_buf_;
 	      static_assert(sizeof(BitmapType) == sizeof(*cq_any_), "wrong data size");
 
 	      // todo maybe don't parallelize?
-#pragma omp parallel for schedule(static) if( nq_size > 1000 )
+	      memory::g_team.parallel([&]() {
+#pragma omp for schedule(static) nowait
 	      for( int64_t i = 0; i < nq_size; i++ ) {
 	         const uint64_t v = nq_list_[i];
 	         const uint64_t v_word = v >> LOG_NBPE;
@@ -1237,6 +1619,7 @@ public:
 #pragma omp atomic update
 	         nq_bitmap[v_word] |= uint64_t(1) << v_bit;
 	      }
+	      }, nq_size > 1000);
 
 
 #if ENABLE_MY_ALLGATHER == 1
@@ -1246,7 +1629,6 @@ public:
 #else
          MPI_Allgather(nq_bitmap, bitmap_width, get_mpi_type(nq_bitmap[0]), recv_buffer_bitmap, bitmap_width, get_mpi_type(nq_bitmap[0]), mpi.comm_2dr);
 #endif
-         free(nq_bitmap);
          cq_any_ = recv_buffer_bitmap;
          work_buf_state_ = Work_buf_state::cq;
 		}
@@ -1276,6 +1658,10 @@ public:
 		MPI_Allgatherv(nq_distance_list_, nq_size, MpiTypeOf<float>::type, recv_buf_weight, recv_size, recv_off, MpiTypeOf<float>::type, mpi.comm_r.comm);
 #endif
 		VERBOSE(g_expand_list_comm += cq_size_ * sizeof(TwodVertex));
+#if VERBOSE_MODE
+		if( !next_bitmap_or_list_ )
+		   profiling::expand_list_sent_bytes += int64_t(cq_size_) * int64_t(sizeof(TwodVertex) + sizeof(float));
+#endif
 		assert(cq_distance_list_ == recv_buf_weight);
 
 		if( nq_root_list_ ) {
@@ -1288,21 +1674,363 @@ public:
          MPI_Allgatherv(nq_root_list_, nq_size, MpiTypeOf<int64_t>::type, cq_root_list_, recv_size, recv_off, MpiTypeOf<int64_t>::type, mpi.comm_r.comm);
 #endif
 		}
-	}
+	}
+
+	static int varint_length(uint64_t v) {
+	   int length = 1;
+	   while( v >= 128 ) {
+	      v >>= 7;
+	      length++;
+	   }
+	   return length;
+	}
+
+	static int64_t expand_nq_num_blocks(int64_t nq_size) {
+	   return (nq_size + NQ_CODE_BLOCK - 1) / NQ_CODE_BLOCK;
+	}
+
+	// should the NQ list be expanded compressed? NOTE: same result on all processes of the row
+	bool expand_nq_use_compression(const int* recv_size, int comm_size) const {
+#if NQ_EXPAND_COMPRESSION
+	   if( nq_root_list_ )
+	      return false;
+
+	   int64_t total_size = 0;
+	   int64_t estimated_bytes = 0;
+	   for( int i = 0; i < comm_size; ++i ) {
+	      total_size += recv_size[i];
+	      // vertex difference plus (usually 3 byte) distance
+	      estimated_bytes += int64_t(recv_size[i]) * (vlq::sparsity_factor(graph_.num_local_verts_, recv_size[i]) + 3);
+	   }
+	   const int64_t raw_bytes = total_size * int64_t(sizeof(TwodVertex) + sizeof(float));
+
+	   return (total_size >= NQ_COMPRESSION_MIN_SIZE && total_size < std::numeric_limits<int>::max() / 16
+	         && 4 * estimated_bytes < 3 * raw_bytes);
+#else
+	   return false;
+#endif
+	}
+
+	// codes sorted vertices (and distances XOR-ed with dist_base, if dists is given) as varint differences in
+	// independent blocks of NQ_CODE_BLOCK entries; stream layout: uint32 block offsets (in bytes, num_blocks + 1) | blocks.
+	// The stream is allocated from scratch_, so the caller has to hold a scope
+	uint8_t* encode_vertex_stream(const TwodVertex* list, const float* dists, uint32_t dist_base, int64_t n, int& stream_bytes) const {
+	   const int64_t num_blocks = expand_nq_num_blocks(n);
+	   const int64_t header_bytes = (num_blocks + 1) * sizeof(uint32_t);
+	   uint32_t* const block_offsets = (uint32_t*)scratch_.alloc(header_bytes);
+
+	   // 1. compute the lengths of the coded blocks
+	   memory::g_team.parallel([&]() {
+#pragma omp for schedule(static) nowait
+	   for( int64_t b = 0; b < num_blocks; b++ ) {
+	      const int64_t i_start = b * NQ_CODE_BLOCK;
+	      const int64_t i_end = std::min<int64_t>(i_start + NQ_CODE_BLOCK, n);
+	      int64_t length = 0;
+	      TwodVertex prev = 0;
+	      for( int64_t i = i_start; i < i_end; i++ ) {
+	         assert(i == i_start || list[i] > prev);
+	         length += varint_length(list[i] - prev);
+	         if( dists )
+	            length += varint_length(castFloatToUInt32(dists[i]) ^ dist_base);
+	         prev = list[i];
+	      }
+	      block_offsets[b + 1] = length;
+	   }
+	   }, num_blocks > 1);
+
+	   block_offsets[0] = header_bytes;
+	   for( int64_t b = 0; b < num_blocks; b++ )
+	      block_offsets[b + 1] += block_offsets[b];
+
+	   stream_bytes = roundup<int>(block_offsets[num_blocks], sizeof(uint32_t));
+	   uint8_t* const stream = (uint8_t*)scratch_.alloc(stream_bytes);
+	   memcpy(stream, block_offsets, header_bytes);
+
+	   // 2. code the blocks
+	   memory::g_team.parallel([&]() {
+#pragma omp for schedule(static) nowait
+	   for( int64_t b = 0; b < num_blocks; b++ ) {
+	      const int64_t i_start = b * NQ_CODE_BLOCK;
+	      const int64_t i_end = std::min<int64_t>(i_start + NQ_CODE_BLOCK, n);
+	      uint8_t* p = stream + block_offsets[b];
+	      TwodVertex prev = 0;
+	      for( int64_t i = i_start; i < i_end; i++ ) {
+	         const uint64_t diff = list[i] - prev;
+	         int len;
+	         VARINT_ENCODE_MACRO_64(p, diff, len);
+	         p += len;
+	         if( dists ) {
+	            const uint32_t dist_code = castFloatToUInt32(dists[i]) ^ dist_base;
+	            VARINT_ENCODE_MACRO_32(p, dist_code, len);
+	            p += len;
+	         }
+	         prev = list[i];
+	      }
+	      assert(p == stream + block_offsets[b + 1]);
+	   }
+	   }, num_blocks > 1);
+
+	   return stream;
+	}
+
+	// all-gathers the coded vertex streams within comm and decodes them to out_list (and out_dists, if given);
+	// recv_size: number of entries per process
+	void allgather_vertex_stream(uint8_t* stream, int stream_bytes, const int* recv_size, MPI_Comm comm, int comm_size,
+	      uint32_t dist_base, TwodVertex* restrict out_list, float* restrict out_dists, int64_t& recv_bytes_total) const {
+	   int recv_bytes[comm_size];
+	   int recv_bytes_off[comm_size + 1];
+	   int64_t recv_off[comm_size + 1];
+	   int64_t recv_blocks_off[comm_size + 1];
+	   MPI_Allgather(&stream_bytes, 1, MPI_INT, recv_bytes, 1, MPI_INT, comm);
+	   recv_bytes_off[0] = 0;
+	   recv_off[0] = 0;
+	   recv_blocks_off[0] = 0;
+	   for( int i = 0; i < comm_size; ++i ) {
+	      recv_bytes_off[i + 1] = recv_bytes_off[i] + recv_bytes[i];
+	      recv_off[i + 1] = recv_off[i] + recv_size[i];
+	      recv_blocks_off[i + 1] = recv_blocks_off[i] + expand_nq_num_blocks(recv_size[i]);
+	   }
+
+	   memory::ScratchScope recv_scratch(scratch_);
+	   uint8_t* const recv_buf = recv_scratch.alloc<uint8_t>(recv_bytes_off[comm_size]);
+	   MPI_Allgatherv(stream, stream_bytes, MPI_BYTE, recv_buf, recv_bytes, recv_bytes_off, MPI_BYTE, comm);
+
+	   // decode the blocks of all processes
+	   const int64_t total_blocks = recv_blocks_off[comm_size];
+	   memory::g_team.parallel([&]() {
+#pragma omp for schedule(dynamic, 16) nowait
+	   for( int64_t k = 0; k < total_blocks; k++ ) {
+	      const int r = int(std::upper_bound(recv_blocks_off, recv_blocks_off + comm_size + 1, k) - recv_blocks_off) - 1;
+	      assert(0 <= r && r < comm_size && recv_blocks_off[r] <= k && k < recv_blocks_off[r + 1]);
+	      const int64_t b = k - recv_blocks_off[r];
+	      const uint8_t* const block_stream = recv_buf + recv_bytes_off[r];
+	      const uint8_t* p = block_stream + ((const uint32_t*)block_stream)[b];
+	      const int64_t i_start = recv_off[r] + b * NQ_CODE_BLOCK;
+	      const int64_t i_end = std::min<int64_t>(i_start + NQ_CODE_BLOCK, recv_off[r + 1]);
+	      TwodVertex prev = 0;
+	      for( int64_t i = i_start; i < i_end; i++ ) {
+	         uint64_t diff;
+	         int len;
+	         VARINT_DECODE_MACRO_64(p, diff, len);
+	         p += len;
+	         prev += diff;
+	         out_list[i] = prev;
+	         if( out_dists ) {
+	            uint32_t dist_code;
+	            VARINT_DECODE_MACRO_32(p, dist_code, len);
+	            p += len;
+	            out_dists[i] = castUInt32ToFloat(dist_code ^ dist_base);
+	         }
+	      }
+	      assert(p == block_stream + ((const uint32_t*)block_stream)[b + 1]);
+	   }
+	   }, total_blocks > comm_size);
+
+	   recv_bytes_total = recv_bytes_off[comm_size];
+	}
+
+	// expands the NQ list compressed: vertices are sorted and coded as differences, distances are XOR-ed with the
+	// lower bucket bound
+	void top_down_expand_nq_compressed(int nq_size, const int* recv_size) {
+	   TRACER(td_expand_nq_list);
+	   const uint32_t lower_bits = castFloatToUInt32(float(delta_epoch_ * delta_step_));
+
+	   sort2(nq_list_, nq_distance_list_, nq_size);
+
+	   memory::ScratchScope stream_scratch(scratch_);
+	   int stream_bytes;
+	   uint8_t* const stream = encode_vertex_stream(nq_list_, nq_distance_list_, lower_bits, nq_size, stream_bytes);
+
+	   update_work_buf(int64_t(cq_size_) * int64_t(sizeof(TwodVertex)));
+	   TwodVertex* const cq_list = (TwodVertex*) work_buf_;
+	   int64_t recv_bytes;
+	   allgather_vertex_stream(stream, stream_bytes, recv_size, mpi.comm_r.comm, mpi.comm_r.size,
+	         lower_bits, cq_list, cq_distance_list_, recv_bytes);
+	   VERBOSE(profiling::expand_list_sent_bytes += recv_bytes);
+
+	   cq_any_ = cq_list;
+	   work_buf_state_ = Work_buf_state::cq;
+	}
+
+	// builds the local NQ (in SRC format) while the global NQ size is reduced; returns local NQ size
+	int top_down_reduce_and_make_nq() {
+		TRACER(td_expand);
+		if( !is_light_phase_ ) {
+		   assert(!is_bellman_ford_);
+		   assert(0 == nq_size_);
+		   // the heavy phase ends the bucket, so its reduction finds the next non-empty one
+		   if( !is_presolve_mode_ ) {
+		      phase_reduction_start(0, 0, bucket_get_local_next_nonempty());
+		      next_bucket_cached_ = int(phase_reduction_wait().next_bucket);
+		   }
+		   global_nq_size_ = 0;
+		   return 0;
+		}
+
+		PROF(profiling::TimeKeeper tk_all);
+		assert(!next_bitmap_or_list_);
+		phase_reduction_start(nq_size_, 0, std::numeric_limits<int>::max());
+
+		const TwodVertex shifted_c = TwodVertex(mpi.rank_2dc) << graph_.local_bits_;
+		const int nq_size = top_down_make_nq(false, shifted_c);
+
+		phase_gather_nq_size_start(nq_size);
+		global_nq_size_ = phase_reduction_wait().nq_size;
+		PROF(gather_nq_time_ += tk_all);
+
+		return nq_size;
+	}
+
+
+#if BUCKET_FUSION
+	// relaxes the light edges among the own vertices of the NQ until no own vertex of the current bucket improves,
+	// in rounds over the vertices improved in the previous round; the improved vertices are added to the NQ so that
+	// the next phase sends their other edges, the diagonal edges are not sent again (see cq_is_fused_)
+	int top_down_fuse_bucket(int nq_size, TwodVertex shifted_c) {
+		TRACER(td_fuse);
+		const int lgl = graph_.local_bits_;
+		const int r_mask = (1 << graph_.r_bits_) - 1;
+		const int r = mpi.rank_2dr;
+		const TwodVertex local_mask = (TwodVertex(1) << lgl) - 1;
+		const TwodVertex compact_base = TwodVertex(mpi.rank_2dc) * graph_.num_local_verts_;
+		const int64_t src_base = int64_t(mpi.rank_2dc) * mpi.size_2dr + r;
+		const float bucket_upper = (delta_epoch_ + 1.0) * delta_step_;
+		const int64_t* const edge_array = graph_.edge_array_;
+		const float* const edge_weight_array = graph_.edge_weight_array_;
+		BitmapType* const in_next = fusion_in_next_;
+		const int max_threads = omp_get_max_threads();
+		int th_new[max_threads + 1];
+		VERBOSE(const int nq_size_initial = nq_size);
+
+		std::vector<TwodVertex>& frontier = fusion_worklist_;
+		frontier.resize(nq_size);
+		memory::g_team.parallel([&]() {
+#pragma omp for nowait
+		for( int i = 0; i < nq_size; i++ ) {
+			const TwodVertex v = nq_list_[i] & local_mask;
+			vertices_pos_[v] = i;
+			frontier[i] = v;
+		}
+		});
+
+		while( !frontier.empty() ) {
+			int num_new = 0;
+			memory::g_team.parallel([&]() {
+				const int tid = omp_get_thread_num();
+				const int num_threads = omp_get_num_threads();
+				std::vector<TwodVertex>& next = fusion_next_[tid];
+				VERBOSE(int64_t num_relaxed = 0);
+				VERBOSE(int64_t num_pruned = 0);
+				next.clear();
+
+#pragma omp for schedule(dynamic, 16)
+				for( int64_t k = 0; k < int64_t(frontier.size()); k++ ) {
+					const TwodVertex v = frontier[k];
+					const int64_t non_zero_off = graph_.row_of(compact_base + v);
+					if( non_zero_off < 0 )
+						continue;
+
+					const int64_t src_orig = int64_t(graph_.orig_vertexes_[non_zero_off]) * mpi.size_2d + src_base;
+					const float distance = dist_[v];
+
+					// the light edges are sorted by the target row, the own targets lie in between
+					const int64_t* const e_begin = edge_array + graph_.row_starts_[non_zero_off];
+					const int64_t* const e_end = edge_array + graph_.row_starts_heavy_[non_zero_off];
+					const int64_t* e = std::lower_bound(e_begin, e_end, r,
+							[lgl, r_mask](int64_t tgt, int row) { return ((tgt >> lgl) & r_mask) < row; });
+
+					for( ; e < e_end && ((*e >> lgl) & r_mask) == r; ++e ) {
+						const float dist_new = edge_weight_array[e - edge_array] + distance;
+						const LocalVertex tgt_local = *e & local_mask;
+						if( dist_new >= bucket_upper || !comp::isLT(dist_new, dist_[tgt_local]) )
+							continue;
+						if( !top_down_relax(tgt_local, dist_new, src_orig) )
+							continue;
+
+						VERBOSE(num_relaxed++);
+						if( graph_.local_vertex_isDeg1(tgt_local) )
+							continue;
+						if( bucket_vertex_is_pruned(tgt_local, dist_new, bucket_upper) ) {
+							VERBOSE(num_pruned++);
+							continue;
+						}
+						const BitmapType mask = BitmapType(1) << (tgt_local & NBPE_MASK);
+						if( !(__sync_fetch_and_or(&in_next[tgt_local >> LOG_NBPE], mask) & mask) )
+							next.push_back(tgt_local);
+					}
+				} // implicit barrier
+				VERBOSE(__sync_fetch_and_add(&profiling::bucket_fusion_relaxed, num_relaxed));
+				VERBOSE(__sync_fetch_and_add(&profiling::pruned_vertices[0], num_pruned));
+
+				// vertices that are not in the NQ yet; each vertex is in one list only
+				int n_new = 0;
+				for( size_t k = 0; k < next.size(); k++ )
+					n_new += (vertices_pos_[next[k]] < 0);
+				th_new[tid + 1] = n_new;
+#pragma omp barrier
+#pragma omp single
+				{
+					th_new[0] = 0;
+					for( int t = 0; t < num_threads; ++t )
+						th_new[t + 1] += th_new[t];
+					num_new = th_new[num_threads];
+					while( nq_size + num_new > nq_buf_length_ )
+						grow_nq_capacity(nq_size);
+					th_new[num_threads] = 0;
+					for( int t = 0; t < num_threads; ++t )
+						th_new[num_threads] += fusion_next_[t].size();
+					frontier.resize(th_new[num_threads]);
+				} // implicit barrier
+
+				int pos = nq_size + th_new[tid];
+				int64_t frontier_off = 0;
+				for( int t = 0; t < tid; ++t )
+					frontier_off += fusion_next_[t].size();
+				for( size_t k = 0; k < next.size(); k++ ) {
+					const TwodVertex v = next[k];
+					__sync_fetch_and_and(&in_next[v >> LOG_NBPE], ~(BitmapType(1) << (v & NBPE_MASK)));
+					frontier[frontier_off + k] = v;
+					if( vertices_pos_[v] < 0 ) {
+						vertices_pos_[v] = pos;
+						nq_list_[pos++] = v | shifted_c;
+					}
+				}
+			}); // #pragma omp parallel
+			nq_size += num_new;
+		}
 
-	void top_down_expand() {
-		TRACER(td_expand);
-		// expand NQ within a processor column
-		// convert NQ to a SRC format
-		assert(!next_bitmap_or_list_);
-		const TwodVertex shifted_c = TwodVertex(mpi.rank_2dc) << graph_.local_bits_;
-		const int nq_size = top_down_make_nq(false, shifted_c);
-		top_down_expand_nq(nq_size);
+		// the distances of the NQ are the final ones of the fusion
+		memory::g_team.parallel([&]() {
+#pragma omp for nowait
+		for( int i = 0; i < nq_size; i++ ) {
+			const TwodVertex v = nq_list_[i] & local_mask;
+			nq_distance_list_[i] = dist_[v];
+			vertices_pos_[v] = -1;
+		}
+		});
+		nq_is_fused_ = true;
+
+		VERBOSE(profiling::bucket_fusion_added += nq_size - nq_size_initial);
+		return nq_size;
 	}
 
+	// doubles the NQ buffers, keeping the first 'used' entries
+	void grow_nq_capacity(int used) {
+		assert(!nq_root_list_);
+		nq_buf_length_ *= 2;
+		TwodVertex* const nq_list = (TwodVertex*) page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_list_), memory::TAG_QUEUE);
+		float* const nq_distance_list = (float*) page_aligned_xmalloc(nq_buf_length_ * sizeof(*nq_distance_list_), memory::TAG_QUEUE);
+		memcpy(nq_list, nq_list_, used * sizeof(*nq_list_));
+		memcpy(nq_distance_list, nq_distance_list_, used * sizeof(*nq_distance_list_));
+		free(nq_list_);
+		free(nq_distance_list_);
+		nq_list_ = nq_list;
+		nq_distance_list_ = nq_distance_list;
+	}
+#endif
 
-	// expands current bucket vertices (and distances)
-   void top_down_expand_bucket(int64_t& global_nq_size) {
+	// expands current bucket vertices (and distances); global_size_known: global_nq_size is already given
+   void top_down_expand_bucket(int64_t& global_nq_size, bool global_size_known = false) {
 #if VERBOSE_MODE
       const double expand_start_time = MPI_Wtime();
 #endif
@@ -1311,14 +2039,16 @@ public:
       const TwodVertex shifted_c = TwodVertex(mpi.rank_2dc) << graph_.local_bits_;
       const int nq_size = bucket_make_nq_list(false, shifted_c);
 
-      int64_t send_nq_size = nq_size;
-      int64_t nq_sum;
-      MPI_Allreduce(&send_nq_size, &nq_sum, 1, MpiTypeOf<int64_t>::type, MPI_SUM, mpi.comm_2d);
-      global_nq_size = nq_sum;
+      if( !global_size_known )
+         phase_reduction_start(nq_size, 0, std::numeric_limits<int>::max());
+      phase_gather_nq_size_start(nq_size);
+      const PhaseReduction& reduced = phase_reduction_wait();
+      if( !global_size_known )
+         global_nq_size = reduced.nq_size;
 
       if( global_nq_size > 0 ) {
          // expand NQ within processor column
-         top_down_expand_nq(nq_size);
+         top_down_expand_nq(nq_size, nq_recv_sizes_.data());
 
          if( mpi.isMaster() ) {
             if( is_bellman_ford_ )
@@ -1594,6 +2324,28 @@ public:
 #endif
 	) {
 	   const int dest = (tgt >> lgl) & r_mask;
+#if NODE_SHARED_DIST
+	   // target on a co-located rank is already at least as close?
+	   if( active_node_dists_ && active_node_dists_[dest] && !(tgt_weight < active_node_dists_[dest][tgt & ((int64_t(1) << lgl) - 1)]) ) {
+	      VERBOSE(thread_local_buffer_[omp_get_thread_num()]->node_shared_filtered++);
+	      return;
+	   }
+#endif
+#if HUB_DELEGATION_VERTICES
+	   const int64_t tgt_local = tgt & ((int64_t(1) << lgl) - 1);
+	   if( tgt_local < hub_count_ && !is_presolve_mode_ ) {
+	      top_down_hub_relax(dest * hub_count_ + tgt_local, tgt_weight, src);
+	      return;
+	   }
+#endif
+#if SELF_FOLD_FAST_PATH
+	   if( dest == mpi.rank_2dr && !is_presolve_mode_ ) {
+	      VERBOSE(thread_local_buffer_[omp_get_thread_num()]->fold_self_relaxed++);
+	      top_down_relax_self(tgt & ((int64_t(1) << lgl) - 1), tgt_weight, src);
+	      return;
+	   }
+#endif
+	   VERBOSE(thread_local_buffer_[omp_get_thread_num()]->fold_sent_relaxed++);
 		LocalPacket& pk = packet_array[dest];
 
 		// is the packet full?
@@ -1609,9 +2361,11 @@ public:
 			//std::cout << "rank" << mpi.rank_2d << " new source: " << src << '\n';
 
 			if( !is_presolve_mode_ ) {
+#if !PRED_RECONSTRUCTION
 	         assert(!((src >> 32) & 0x80000000u));
 			   pk.data.t[pk.length++] = (src >> 32) | 0x80000000u;
 			   pk.data.t[pk.length++] = (uint32_t)src;
+#endif
 			} else {
             assert(!((root >> 32) & 0x80000000u));
             pk.data.t[pk.length++] = (root >> 32) | 0x80000000u;
@@ -1623,8 +2377,110 @@ public:
 		//printf("rank%d sends %u,%f (length=%d) to row%d \n", mpi.rank_2d, uint32_t(tgt & ((uint32_t(1) << lgl) - 1)), tgt_weight, pk.length, dest);
 	}
 
+	// relaxes a received distance of a local vertex, returns whether the distance was improved
+	bool top_down_relax(LocalVertex tgt_local, float weight, int64_t pred_v) {
+		float* const dist = dist_;
+		bool is_improved = false;
+#if PRED_RECONSTRUCTION
+		// only the distance is written, so an atomic minimum suffices (non-negative floats compare like their bits);
+		// presolving needs the roots in pred_
+		if( !is_presolve_mode_ ) {
+			uint32_t* const dist_bits = reinterpret_cast<uint32_t*>(&dist[tgt_local]);
+			uint32_t cur = *dist_bits;
+			while( comp::isLT(weight, castUInt32ToFloat(cur)) ) {
+				const uint32_t prev = __sync_val_compare_and_swap(dist_bits, cur, castFloatToUInt32(weight));
+				if( prev == cur ) {
+					is_improved = true;
+					break;
+				}
+				cur = prev;
+			}
+			return is_improved;
+		}
+#endif
+#if USE_DISTANCE_LOCKS
+		omp_set_lock(&vertices_locks_[tgt_local]);
+#endif
+		// todo better have a relative comparison here?
+		if( comp::isLT(weight, dist[tgt_local]) ) {
+			assert(comp::isLE(delta_epoch_ * delta_step_, weight)); // weight should not be in lower bucket
+			dist[tgt_local] = weight;
+			pred_[tgt_local] = pred_v;
+			is_improved = true;
+		}
+#if USE_DISTANCE_LOCKS
+		omp_unset_lock(&vertices_locks_[tgt_local]);
+#endif
+		return is_improved;
+	}
+
+#if SELF_FOLD_FAST_PATH
+	// applies a relaxation of an own vertex in the sending thread, as top_down_receive would after the fold
+	void top_down_relax_self(LocalVertex tgt_local, float weight, int64_t src) {
+		if( !(weight < dist_[tgt_local] && top_down_relax(tgt_local, weight, src)) || !is_light_phase_ )
+			return;
+
+		ThreadLocalBuffer* const tlb = thread_local_buffer_[omp_get_thread_num()];
+		QueuedVertexes* buf = tlb->cur_buffer;
+		if(buf == NULL) buf = nq_empty_buffer_.get();
+		if(buf->full()) {
+			nq_.push(buf); buf = nq_empty_buffer_.get();
+		}
+		buf->append_nocheck(tgt_local);
+		tlb->cur_buffer = buf;
+	}
+
+	// relaxes the edges [start, end) to own vertices directly, filtered as in collect_targets_ptr
+	void top_down_relax_self_range(const int64_t* restrict edge_array, int64_t start, int64_t end,
+			int lgl, int64_t src, float dist, bool is_heavy)
+	{
+		const float* const restrict edge_weight_array = graph_.edge_weight_array_;
+		const int64_t lmask = (int64_t(1) << lgl) - 1;
+		const int r_bits = graph_.r_bits_;
+		const int64_t L = graph_.num_local_verts_;
+		const bool with_settled = has_settled_vertices_;
+		const float bucket_upper = (delta_epoch_ + 1.0) * delta_step_;
+		VERBOSE(thread_local_buffer_[omp_get_thread_num()]->fold_self_relaxed += end - start);
+
+		for( int64_t e = start; e < end; ++e ) {
+			if( with_settled && top_down_target_is_settled(edge_array[e], r_bits, lgl, L) )
+				continue;
+
+			const float dist_new = edge_weight_array[e] + dist;
+			if( !is_bellman_ford_ ) {
+				if( is_light_phase_ ? (dist_new >= bucket_upper) : (!is_heavy && comp::isLT(dist_new, bucket_upper)) )
+					continue;
+			}
+			top_down_relax_self(edge_array[e] & lmask, dist_new, src);
+		}
+	}
+#endif
+
+#if HUB_DELEGATION_VERTICES
+	// min-reduces the relaxation into the local slot of the hub instead of sending it
+	void top_down_hub_relax(int64_t slot, float weight, int64_t src) {
+		const uint32_t tid = omp_get_thread_num();
+		const uint64_t dist_bits = castFloatToUInt32(weight);
+		uint64_t cur = hub_keys_[slot];
+		VERBOSE(thread_local_buffer_[tid]->hub_delegated++);
+		if( !(dist_bits < (cur >> 32)) )
+			return;
+
+		// the slot keeps the thread of the minimum, so the predecessor is only written by this thread
+		hub_preds_[tid * hub_slots_ + slot] = src;
+		const uint64_t key = (dist_bits << 32) | tid;
+		while( dist_bits < (cur >> 32) ) {
+			const uint64_t prev = __sync_val_compare_and_swap(&hub_keys_[slot], cur, key);
+			if( prev == cur )
+				break;
+			cur = prev;
+		}
+	}
+#endif
+
+	// skip_own_row: the edges to own vertices were relaxed by the bucket fusion
 	void top_down_send_large(const int64_t* restrict edge_array, int64_t start, int64_t end,
-			int lgl, int r_mask, int64_t src, int64_t root, float dist, bool is_heavy)
+			int lgl, int r_mask, int64_t src, int64_t root, float dist, bool is_heavy, bool skip_own_row = false)
 	{
 		assert (end >= start);
 		assert(!(src & int64_t(1) << 63));
@@ -1657,6 +2513,18 @@ public:
 				next = (left + right) / 2;
 			} while(left < next);
 			// start ... right -> i
+			if( skip_own_row && i == mpi.rank_2dr ) {
+				start = right;
+				continue;
+			}
+#if SELF_FOLD_FAST_PATH
+			if( i == mpi.rank_2dr && !is_presolve_mode_ ) {
+				top_down_relax_self_range(edge_array, start, right, lgl, src, dist, is_heavy);
+				start = right;
+				continue;
+			}
+#endif
+			VERBOSE(thread_local_buffer_[omp_get_thread_num()]->fold_sent_relaxed += right - start);
 			td_comm_.put_ptr(start, right - start, header, dist, i);
 			start = right;
 		}
@@ -1664,12 +2532,27 @@ public:
 	}
 
 
+#if VERBOSE_MODE
+	void flush_relax_counters(ThreadLocalBuffer* tlb) {
+		__sync_fetch_and_add(&profiling::node_shared_filtered, tlb->node_shared_filtered);
+		__sync_fetch_and_add(&profiling::hub_delegated, tlb->hub_delegated);
+		__sync_fetch_and_add(&profiling::fold_self_relaxed, tlb->fold_self_relaxed);
+		__sync_fetch_and_add(&profiling::fold_sent_relaxed, tlb->fold_sent_relaxed);
+		tlb->node_shared_filtered = tlb->hub_delegated = 0;
+		tlb->fold_self_relaxed = tlb->fold_sent_relaxed = 0;
+	}
+#endif
+
 	void top_down_parallel_section() {
 		TRACER(td_par_sec);
 		PROF(profiling::TimeKeeper tk_all);
 		const bool clear_packet_buffer = packet_buffer_is_dirty_;
 		packet_buffer_is_dirty_ = false;
+		memory::ScratchScope phase_scratch(scratch_);
 		TwodVertex* restrict cq_rowsums = nullptr;
+		int64_t* restrict cq_row_offs = nullptr;
+		int64_t* restrict cq_edge_offs = nullptr;
+		int64_t* restrict thread_edge_sums = nullptr;
 
 #if TOP_DOWN_SEND_LB == 2
 #define IF_LARGE_EDGE if(e_end_phase - e_start > PRM::TOP_DOWN_PENDING_WIDTH/10)
@@ -1680,28 +2563,23 @@ public:
 #endif
 
 		if( bitmap_or_list_ ) {
-         const uint64_t bitmap_size = get_bitmap_size_local() * mpi.size_2dc;
-         const BitmapType* const restrict cq_bitmap = (BitmapType*)cq_any_;
-		   cq_rowsums = (TwodVertex*)cache_aligned_xmalloc(bitmap_size * sizeof(*cq_rowsums));
-
-#pragma omp parallel for schedule(static)
-		   for( uint64_t i = 1; i < bitmap_size; i++ ) {
-		      cq_rowsums[i] = __builtin_popcountl(cq_bitmap[i - 1]);
-		   }
-
-		   cq_rowsums[0] = 0;
-		   for( uint64_t i = 2; i < bitmap_size; i++ )
-		      cq_rowsums[i] += cq_rowsums[i - 1];
+		   cq_rowsums = phase_scratch.alloc<TwodVertex>(get_bitmap_size_local() * mpi.size_2dc);
+		}
+		else {
+		   // for the edge-balanced partitioning of the CQ list
+		   cq_row_offs = phase_scratch.alloc<int64_t>(cq_size_ + 1);
+		   cq_edge_offs = phase_scratch.alloc<int64_t>(cq_size_ + 1);
+		   thread_edge_sums = phase_scratch.alloc<int64_t>(omp_get_max_threads() + 1);
 		}
 
 		debug("begin parallel");
-#pragma omp parallel
-		{
+		memory::g_team.parallel([&]() {
 			SET_OMP_AFFINITY;
 			PROF(profiling::TimeKeeper tk_all);
 			PROF(profiling::TimeSpan ts_commit);
 			VERBOSE(int64_t num_edge_relax = 0);
 			VERBOSE(int64_t num_large_edge = 0);
+			VERBOSE(int64_t num_pruned_edge = 0);
 			const int64_t* const restrict edge_array = graph_.edge_array_;
 #if TOP_DOWN_SEND_LB != 1
 			const float* const restrict edge_weight_array = graph_.edge_weight_array_;
@@ -1728,13 +2606,26 @@ public:
 				const BitmapType* const restrict cq_bitmap = (BitmapType*)cq_any_;
 				const int64_t bitmap_size_local = get_bitmap_size_local();
 				const int64_t bitmap_size = bitmap_size_local * mpi.size_2dc;
+
+				// CQ row sums, in the same parallel region to save a fork/join
+#pragma omp for schedule(static)
+				for( int64_t i = 1; i < bitmap_size; i++ ) {
+				   cq_rowsums[i] = __builtin_popcountl(cq_bitmap[i - 1]);
+				}
+#pragma omp single
+				{
+				   cq_rowsums[0] = 0;
+				   for( int64_t i = 2; i < bitmap_size; i++ )
+				      cq_rowsums[i] += cq_rowsums[i - 1];
+				} // implicit barrier
+
 	#pragma omp for
 				for(int64_t word_idx = 0; word_idx < bitmap_size; ++word_idx) {
 					const BitmapType cq_bit_i = cq_bitmap[word_idx];
 					if(cq_bit_i == BitmapType(0)) continue;
 
-					const BitmapType row_bitmap_i = graph_.row_bitmap_[word_idx];
-					const TwodVertex bmp_row_sum = graph_.row_sums_[word_idx];
+					TwodVertex bmp_row_sum;
+					const BitmapType row_bitmap_i = graph_.row_word(word_idx, bmp_row_sum);
                const TwodVertex cq_rowsum = cq_rowsums[word_idx];
 
                BitmapType bit_flags = cq_bit_i & row_bitmap_i;
@@ -1769,8 +2660,10 @@ public:
                   {
                      for( int64_t e = e_start; e < e_end; ++e ) {
                         const int64_t tgt = edge_array[e];
-                        if( top_down_target_is_settled(tgt, r_bits, lgl, L) )
+                        if( top_down_target_is_settled(tgt, r_bits, lgl, L) ) {
+                           VERBOSE(num_pruned_edge++);
                            continue;
+                        }
 
                         top_down_send(tgt, edge_weight_array[e] + distance, lgl, r_mask, packet_array, src_orig, root
                            profiling_commit(ts_commit) );
@@ -1791,41 +2684,96 @@ public:
             const float bucket_upper = (delta_epoch_ + 1.0) * delta_step_;
             const bool is_bellman_ford = is_bellman_ford_;
             const bool is_light_phase = is_light_phase_;
+#if BUCKET_FUSION
+            const bool is_fused = cq_is_fused_ && is_light_phase && !is_bellman_ford;
+#else
+            const bool is_fused = false;
+#endif
 
-#pragma omp for
-				for(int64_t i = 0; i < int64_t(cq_size_); ++i) {
-					const SeparatedId src(cq_list[i]);
-					const TwodVertex src_c = src.value >> lgl;
-					const TwodVertex compact = src_c * L + (src.value & local_mask);
-					const TwodVertex word_idx = compact >> LOG_NBPE;
-					const int bit_idx = compact & NBPE_MASK;
-					const BitmapType row_bitmap_i = graph_.row_bitmap_[word_idx];
-					const BitmapType mask = BitmapType(1) << bit_idx;
-
-					if(row_bitmap_i & mask) {
-						const BitmapType low_mask = (BitmapType(1) << bit_idx) - 1;
-						const TwodVertex non_zero_off = graph_.row_sums_[word_idx] + __builtin_popcountl(graph_.row_bitmap_[word_idx] & low_mask);
+            const int tid = omp_get_thread_num();
+            const int num_threads = omp_get_num_threads();
+
+            // weight of a CQ entry: one for the entry plus the number of edges scanned in this phase
+            {
+               const int64_t chunk_begin = int64_t(cq_size_) * tid / num_threads;
+               const int64_t chunk_end = int64_t(cq_size_) * (tid + 1) / num_threads;
+               int64_t edge_sum = 0;
+               for(int64_t i = chunk_begin; i < chunk_end; ++i) {
+                  const SeparatedId src(cq_list[i]);
+                  const TwodVertex src_c = src.value >> lgl;
+                  const int64_t non_zero_off = graph_.row_of(src_c * L + (src.value & local_mask));
+                  int64_t weight = 1;
+                  cq_row_offs[i] = -1;
+
+                  if( non_zero_off >= 0 ) {
+                     const int64_t e_end_scan = (is_light_phase && !is_bellman_ford) ? graph_.row_starts_heavy_[non_zero_off] : graph_.row_starts_[non_zero_off + 1];
+                     cq_row_offs[i] = non_zero_off;
+                     weight += e_end_scan - graph_.row_starts_[non_zero_off];
+                  }
+                  cq_edge_offs[i] = weight;
+                  edge_sum += weight;
+               }
+               thread_edge_sums[tid + 1] = edge_sum;
+#pragma omp barrier
+#pragma omp single
+               {
+                  thread_edge_sums[0] = 0;
+                  for(int t = 0; t < num_threads; ++t)
+                     thread_edge_sums[t + 1] += thread_edge_sums[t];
+                  cq_edge_offs[cq_size_] = thread_edge_sums[num_threads];
+               } // implicit barrier
+               int64_t offset = thread_edge_sums[tid];
+               for(int64_t i = chunk_begin; i < chunk_end; ++i) {
+                  const int64_t weight = cq_edge_offs[i];
+                  cq_edge_offs[i] = offset;
+                  offset += weight;
+               }
+#pragma omp barrier
+            }
+
+            // each thread takes an equal share of the total weight, long rows are split between threads
+            const int64_t total_weight = cq_edge_offs[cq_size_];
+            const int64_t part_begin = total_weight * tid / num_threads;
+            const int64_t part_end = total_weight * (tid + 1) / num_threads;
+            int64_t i = std::upper_bound(cq_edge_offs, cq_edge_offs + cq_size_, part_begin) - cq_edge_offs - 1;
+
+				for(i = std::max<int64_t>(i, 0); i < int64_t(cq_size_) && cq_edge_offs[i] < part_end; ++i) {
+					const int64_t non_zero_off = cq_row_offs[i];
+					// weight unit 0 is the entry itself, unit k > 0 the (k-1)-th scanned edge
+					const int64_t part_lo = std::max<int64_t>(part_begin - cq_edge_offs[i], 0);
+					const int64_t part_hi = std::min<int64_t>(part_end, cq_edge_offs[i + 1]) - cq_edge_offs[i];
+
+					if( non_zero_off >= 0 && part_lo < part_hi ) {
+						const SeparatedId src(cq_list[i]);
+						const TwodVertex src_c = src.value >> lgl;
 						const int64_t src_orig = int64_t(graph_.orig_vertexes_[non_zero_off]) * P + src_c * R + r;
 						const int64_t root = is_presolve_mode_ ? cq_root_list_[i] : (-1);
 					   const int64_t e_start = graph_.row_starts_[non_zero_off];
                   const int64_t e_end = graph_.row_starts_[non_zero_off + 1];
+                  const int64_t e_start_heavy = graph_.row_starts_heavy_[non_zero_off];
                   const float distance = cq_distance_list[i];
+                  // the own row of an own vertex is done if the bucket was fused
+                  const bool skip_own_row = is_fused && src_c == TwodVertex(mpi.rank_2dc);
 #if TOP_DOWN_SEND_LB == 2
-                  const int64_t e_end_phase = is_light_phase_proper ? graph_.row_starts_heavy_[non_zero_off] : e_end;
+                  const int64_t e_end_phase = is_light_phase_proper ? e_start_heavy : e_end;
 #endif
+                  // the part of the scanned edges of this thread, split at the heavy edges
+                  const int64_t e_lo = e_start + std::max<int64_t>(part_lo - 1, 0);
+                  const int64_t e_hi = e_start + std::max<int64_t>(part_hi - 1, 0);
+                  const int64_t e_mid = std::min(std::max(e_start_heavy, e_lo), e_hi);
+                  VERBOSE(const bool is_row_begin = (part_lo == 0));
 
                   IF_LARGE_EDGE
 #if TOP_DOWN_SEND_LB > 0
                   {
-                     const int64_t e_start_heavy = graph_.row_starts_heavy_[non_zero_off];
                      if( is_light_phase_proper ) {
-                        top_down_send_large(edge_array, e_start, e_start_heavy, lgl, r_mask, src_orig, root, distance, false);
+                        top_down_send_large(edge_array, e_lo, e_hi, lgl, r_mask, src_orig, root, distance, false, skip_own_row);
                      }
                      else {
-                        top_down_send_large(edge_array, e_start, e_start_heavy, lgl, r_mask, src_orig, root, distance, false);
-                        top_down_send_large(edge_array, e_start_heavy, e_end, lgl, r_mask, src_orig, root, distance, true);
+                        top_down_send_large(edge_array, e_lo, e_mid, lgl, r_mask, src_orig, root, distance, false);
+                        top_down_send_large(edge_array, e_mid, e_hi, lgl, r_mask, src_orig, root, distance, true);
                      }
-                     VERBOSE(num_large_edge += e_end - e_start);
+                     VERBOSE(if( is_row_begin ) num_large_edge += e_end - e_start);
                   }
 #endif // #if TOP_DOWN_SEND_LB > 0
                   ELSE
@@ -1833,62 +2781,74 @@ public:
                   {
                      if( is_bellman_ford ) {
                         assert(with_settled);
-                        for( int64_t e = e_start; e < e_end; ++e ) {
+                        for( int64_t e = e_lo; e < e_hi; ++e ) {
                            const int64_t tgt = edge_array[e];
-                           if( top_down_target_is_settled(tgt, r_bits, lgl, L) )
+                           if( top_down_target_is_settled(tgt, r_bits, lgl, L) ) {
+                              VERBOSE(num_pruned_edge++);
                               continue;
+                           }
 
                            top_down_send(tgt, edge_weight_array[e] + distance, lgl, r_mask, packet_array,
                                  src_orig, root profiling_commit(ts_commit));
                         }
                      }
                      else if( is_light_phase ) {
-                        const int64_t e_start_heavy = graph_.row_starts_heavy_[non_zero_off];
-                        for( int64_t e = e_start; e < e_start_heavy; ++e ) {
+                        assert(e_hi <= e_start_heavy);
+                        for( int64_t e = e_lo; e < e_hi; ++e ) {
                            const float dist_new = edge_weight_array[e] + distance;
                            if( dist_new >= bucket_upper )
                               continue;
 
                            const int64_t tgt = edge_array[e];
-                           if( with_settled && top_down_target_is_settled(tgt, r_bits, lgl, L) )
+                           if( skip_own_row && ((tgt >> lgl) & r_mask) == r )
                               continue;
+                           if( with_settled && top_down_target_is_settled(tgt, r_bits, lgl, L) ) {
+                              VERBOSE(num_pruned_edge++);
+                              continue;
+                           }
 
                            top_down_send(tgt, dist_new, lgl, r_mask, packet_array,
                                  src_orig, root profiling_commit(ts_commit));
                         }
                      }
                      else { // heavy phase
-                        const int64_t e_start_heavy = graph_.row_starts_heavy_[non_zero_off];
-                        for( int64_t e = e_start; e < e_start_heavy; ++e ) {
+                        for( int64_t e = e_lo; e < e_mid; ++e ) {
                            const float dist_new = edge_weight_array[e] + distance;
-                           if( comp::isLT(dist_new, bucket_upper) )
+                           if( comp::isLT(dist_new, bucket_upper) ) { // inner-short, relaxed in the light phase
+                              VERBOSE(num_pruned_edge++);
                               continue;
+                           }
 
                            const int64_t tgt = edge_array[e];
-                           if( with_settled && top_down_target_is_settled(tgt, r_bits, lgl, L) )
+                           if( with_settled && top_down_target_is_settled(tgt, r_bits, lgl, L) ) {
+                              VERBOSE(num_pruned_edge++);
                               continue;
+                           }
 
                            top_down_send(tgt, dist_new, lgl, r_mask, packet_array,
                                  src_orig, root profiling_commit(ts_commit));
                         }
 
-                        for( int64_t e = e_start_heavy; e < e_end; ++e ) {
+                        for( int64_t e = e_mid; e < e_hi; ++e ) {
                            const float dist_new = edge_weight_array[e] + distance;
                            assert(!comp::isLT(dist_new, bucket_upper));
 
                            const int64_t tgt = edge_array[e];
-                           if( with_settled && top_down_target_is_settled(tgt, r_bits, lgl, L) )
+                           if( with_settled && top_down_target_is_settled(tgt, r_bits, lgl, L) ) {
+                              VERBOSE(num_pruned_edge++);
                               continue;
+                           }
 
                            top_down_send(tgt, dist_new, lgl, r_mask, packet_array,
                                  src_orig, root profiling_commit(ts_commit));
                         }
                      }
-                     VERBOSE(num_edge_relax += e_end - e_start + 1);
+                     VERBOSE(if( is_row_begin ) num_edge_relax += e_end - e_start + 1);
                   }
 #endif // #if TOP_DOWN_SEND_LB != 1
-					} // if(row_bitmap_i & mask) {
-				} // #pragma omp for // implicit barrier
+					} // if( non_zero_off >= 0 && part_lo < part_hi ) {
+				}
+#pragma omp barrier // the flush reads the packets of all threads
 			}
 
 			// flush buffer
@@ -1912,11 +2872,12 @@ public:
 			PROF(commit_time_ += ts_commit);
 			VERBOSE(__sync_fetch_and_add(&num_edge_top_down_, num_edge_relax));
 			VERBOSE(__sync_fetch_and_add(&num_td_large_edge_, num_large_edge));
-		} // #pragma omp parallel reduction(+:num_edge_relax)
+			VERBOSE(__sync_fetch_and_add(&num_td_pruned_edge_, num_pruned_edge));
+			VERBOSE(flush_relax_counters(thread_local_buffer_[omp_get_thread_num()]));
+		}); // #pragma omp parallel reduction(+:num_edge_relax)
 #undef IF_LARGE_EDGE
 #undef ELSE
 
-		if( cq_rowsums ) free(cq_rowsums);
 		PROF(parallel_reg_time_ += tk_all);
 		debug("finished parallel");
 	}
@@ -1937,6 +2898,10 @@ public:
       SsspState state = get_state();
       td_comm_.run_with_both(graph_, state, vertices_pos_);
 #endif
+#if HUB_DELEGATION_VERTICES
+		if( !is_presolve_mode_ )
+			top_down_hub_reduction();
+#endif
 
 		PROF(profiling::TimeKeeper tk_all);
 		// flush NQ buffer and count NQ total
@@ -1975,20 +2940,62 @@ public:
       PROF(seq_proc_time_ += tk_all);
       PROF(MPI_Barrier(mpi.comm_2d));
       PROF(fold_competion_wait_ += tk_all);
+	}
 
-		if( !is_light_phase_ ) {
-		   assert(!is_bellman_ford_);
-		   assert(0 == nq_size_);
-		   global_nq_size_ = 0;
+
+#if HUB_DELEGATION_VERTICES
+	static void hub_value_reduce(void* invec, void* inoutvec, int* len, MPI_Datatype* datatype) {
+		const HubValue* in = (const HubValue*) invec;
+		HubValue* inout = (HubValue*) inoutvec;
+		for( int i = 0; i < *len; i++ ) {
+			if( in[i].dist < inout[i].dist || (in[i].dist == inout[i].dist && in[i].pred < inout[i].pred) )
+				inout[i] = in[i];
 		}
-		else {
-         int64_t send_nq_size = nq_size_;
-         MPI_Allreduce(&send_nq_size, &global_nq_size_, 1, MpiTypeOf<int64_t>::type, MPI_SUM, mpi.comm_2d);
+	}
+
+	// reconciles the hub distances of the processor column and applies the improvements of the own hubs
+	void top_down_hub_reduction() {
+		const uint64_t no_thread = 0xFFFFFFFFu;
+		HubValue* const values = hub_values_.data();
+
+		memory::g_team.parallel([&]() {
+#pragma omp for schedule(static) nowait
+		for( int64_t s = 0; s < hub_slots_; ++s ) {
+			const uint64_t key = hub_keys_[s];
+			values[s].dist = key >> 32;
+			values[s].pred = ((key & no_thread) == no_thread) ? INT64_MAX : hub_preds_[(key & no_thread) * hub_slots_ + s];
 		}
+		});
+		MPI_Allreduce(MPI_IN_PLACE, values, hub_slots_, hub_value_type_, hub_value_op_, mpi.comm_2dc);
 
-      PROF(gather_nq_time_ += tk_all);
-	}
+		for( int64_t s = 0; s < hub_slots_; ++s )
+			hub_keys_[s] = (uint64_t(values[s].dist) << 32) | no_thread;
 
+		// same as in top_down_receive
+		ThreadLocalBuffer* const tlb = thread_local_buffer_[0];
+		QueuedVertexes* buf = tlb->cur_buffer;
+		if(buf == NULL) buf = nq_empty_buffer_.get();
+		const HubValue* const own_values = values + mpi.rank_2dr * hub_count_;
+		for( int64_t tgt_local = 0; tgt_local < hub_count_; ++tgt_local ) {
+			if( own_values[tgt_local].pred == INT64_MAX )
+				continue;
+			const float weight = castUInt32ToFloat(uint32_t(own_values[tgt_local].dist));
+			if( !comp::isLT(weight, dist_[tgt_local]) )
+				continue;
+			assert(comp::isLE(delta_epoch_ * delta_step_, weight)); // weight should not be in lower bucket
+
+			dist_[tgt_local] = weight;
+			pred_[tgt_local] = own_values[tgt_local].pred;
+			if( is_light_phase_ ) {
+				if(buf->full()) {
+					nq_.push(buf); buf = nq_empty_buffer_.get();
+				}
+				buf->append_nocheck(tgt_local);
+			}
+		}
+		tlb->cur_buffer = buf;
+	}
+#endif
 
    void top_down_receive_ptr_presolve(uint32_t* stream, int length, int thread_id) {
       assert(thread_id >= 0);
@@ -2062,7 +3069,6 @@ public:
 			ThreadLocalBuffer* tlb = thread_local_buffer_[tid];
 			QueuedVertexes* buf = tlb->cur_buffer;
 			if(buf == NULL) buf = nq_empty_buffer_.get();
-			int64_t* restrict const pred = pred_;
 	      float* restrict const dist = dist_;
 
 			while(true) {
@@ -2090,35 +3096,11 @@ public:
 		             const float weight = castUInt32ToFloat(ptr[i + 1]);
 		             assert(0 <= tgt_local && tgt_local < graph_.num_local_verts_);
 
-		             if( weight < dist[tgt_local] ) {
-		 #if USE_DISTANCE_LOCKS
-		                if( !with_nq )
-		                   omp_set_lock(&vertices_locks_[tgt_local]);
-		 #endif
-
-		                // todo better have a relative comparison here?
-		                if( comp::isLT(weight, dist[tgt_local]) ) {
-		                   if( !with_nq ) {
-		                      dist[tgt_local] = weight;
-		                      pred[tgt_local] = pred_v;
-		 #if USE_DISTANCE_LOCKS
-		                      omp_unset_lock(&vertices_locks_[tgt_local]);
-		 #endif
-		                   }
-		                   assert(comp::isLE(delta_epoch_ * delta_step_, weight)); // weight should not be in lower bucket
-
-		                   if( with_nq ) {
-		                      if(buf->full()) {
-		                         nq_.push(buf); buf = nq_empty_buffer_.get();
-		                      }
-		                      buf->append_nocheck(tgt_local, pred_v, weight);
-		                   }
-		                }
-		 #if USE_DISTANCE_LOCKS
-		                else if( !with_nq )  {
-		                   omp_unset_lock(&vertices_locks_[tgt_local]);
+		             if( weight < dist[tgt_local] && top_down_relax(tgt_local, weight, pred_v) && with_nq ) {
+		                if(buf->full()) {
+		                   nq_.push(buf); buf = nq_empty_buffer_.get();
 		                }
-		 #endif
+		                buf->append_nocheck(tgt_local);
 		             }
 					}
 				}
@@ -2141,7 +3123,6 @@ public:
       ThreadLocalBuffer* const tlb = thread_local_buffer_[thread_id];
       QueuedVertexes* buf = tlb->cur_buffer;
       if(buf == NULL) buf = nq_empty_buffer_.get();
-      int64_t* restrict const pred = pred_;
       float* restrict const dist = dist_;
 
       // ------------------- //
@@ -2167,37 +3148,11 @@ public:
             //  printf("rank%d receive: %d,%f pred=%" PRId64 " \n", mpi.rank_2d, tgt_local, castUInt32ToFloat(stream[c + 1]), pred_v);
              //printf("pred_v=%u target=%u weight=%f i=%d\n", unsigned(pred_v), tgt_local, weight, i);
 
-             if( weight < dist[tgt_local] ) {
- #if USE_DISTANCE_LOCKS
-                if( !with_nq )
-                   omp_set_lock(&vertices_locks_[tgt_local]);
- #endif
-
-                // todo better have a relative comparison here?
-                if( comp::isLT(weight, dist[tgt_local]) ) {
-                   //printf("...updated node %d (%f->%f, src=%d) \n", tgt_orig, std::min(100.0f, dist[tgt_orig]), weight, unsigned(pred_v));
-
-                   if( !with_nq ) {
-                      dist[tgt_local] = weight;
-                      pred[tgt_local] = pred_v;
- #if USE_DISTANCE_LOCKS
-                      omp_unset_lock(&vertices_locks_[tgt_local]);
- #endif
-                   }
-                   assert(comp::isLE(delta_epoch_ * delta_step_, weight)); // weight should not be in lower bucket
-
-                   if( with_nq ) {
-                      if(buf->full()) {
-                         nq_.push(buf); buf = nq_empty_buffer_.get();
-                      }
-                      buf->append_nocheck(tgt_local, pred_v, weight);
-                   }
+             if( weight < dist[tgt_local] && top_down_relax(tgt_local, weight, pred_v) && with_nq ) {
+                if(buf->full()) {
+                   nq_.push(buf); buf = nq_empty_buffer_.get();
                 }
- #if USE_DISTANCE_LOCKS
-                else if( !with_nq )  {
-                   omp_unset_lock(&vertices_locks_[tgt_local]);
-                }
- #endif
+                buf->append_nocheck(tgt_local);
              }
           }
 #if TOP_DOWN_RECV_LB
@@ -2284,7 +3239,6 @@ public:
 		QueuedVertexes* buf = tlb->cur_buffer;
 		if(buf == NULL) buf = nq_empty_buffer_.get();
 		//BitmapType* visited = (BitmapType*)new_visited_;
-		int64_t* restrict const pred = pred_;
 		float* restrict const dist = dist_;
 	//	const int cur_level = current_level_;
 		int64_t pred_v = -1;
@@ -2298,7 +3252,7 @@ public:
 				assert(!(v & 0x40000000u)); // currently not supported
 			}
 			else {
-				assert (pred_v != -1);
+				assert (pred_v != -1 || PRED_RECONSTRUCTION);
 
 				const LocalVertex tgt_local = v;
 				assert(tgt_local == (v & ((LocalVertex(1) << graph_.local_bits_) - 1)));
@@ -2308,40 +3262,11 @@ public:
             //printf("pred_v=%u target=%u weight=%f i=%d\n", unsigned(pred_v), tgt_local, weight, i);
             assert(0 <= tgt_local && tgt_local < graph_.num_local_verts_);
 
-            if( weight < dist[tgt_local] ) {
-#if USE_DISTANCE_LOCKS
-               if( !with_nq )
-                  omp_set_lock(&vertices_locks_[tgt_local]);
-#endif
-
-               // todo better have a relative comparison here?
-               if( comp::isLT(weight, dist[tgt_local]) ) {
-                    // std::cout << " pred=" <<  pred_v <<  " update node " << graph_.invert_map_[tgt_local] << " weight:" << dist[tgt_local] << " -> " << weight << '\n';
-
-                  //printf("...updated node %d (%f->%f, src=%d) \n", tgt_orig, std::min(100.0f, dist[tgt_orig]), weight, unsigned(pred_v));
-
-                  if( !with_nq ) {
-                     dist[tgt_local] = weight;
-                     pred[tgt_local] = pred_v;
-#if USE_DISTANCE_LOCKS
-                     omp_unset_lock(&vertices_locks_[tgt_local]);
-#endif
-                  }
-
-                  assert(comp::isLE(delta_epoch_ * delta_step_, weight)); // weight should not be in lower bucket
-
-                  if( with_nq ) {
-                     if(buf->full()) {
-                        nq_.push(buf); buf = nq_empty_buffer_.get();
-                     }
-                     buf->append_nocheck(tgt_local, pred_v, weight);
-                  }
-               }
-#if USE_DISTANCE_LOCKS
-               else if( !with_nq )  {
-                  omp_unset_lock(&vertices_locks_[tgt_local]);
+            if( weight < dist[tgt_local] && top_down_relax(tgt_local, weight, pred_v) && with_nq ) {
+               if(buf->full()) {
+                  nq_.push(buf); buf = nq_empty_buffer_.get();
                }
-#endif
+               buf->append_nocheck(tgt_local);
             }
 			}
 		}
@@ -3044,8 +3969,9 @@ public:
 
 		int half_bitmap_width = get_bitmap_size_local() / 2;
 		int buffer_size = half_bitmap_width * sizeof(BitmapType) / sizeof(TwodVertex);
-		// TODO: reduce memory allocation
-		int8_t* vertex_enabled = (int8_t*)cache_aligned_xcalloc(buffer_size*sizeof(int8_t));
+		memory::ScratchScope list_scratch(scratch_);
+		int8_t* vertex_enabled = list_scratch.alloc<int8_t>(buffer_size);
+		memset(vertex_enabled, 0, buffer_size * sizeof(*vertex_enabled));
 
 		int comm_size = mpi.size_2dc;
 		int visited_count[comm_size];
@@ -3060,7 +3986,6 @@ public:
 		VERBOSE(botto_up_print_stt(num_blocks, num_vertexes, visited_count));
 		VERBOSE(bottom_up_substep_->print_stt());
 
-		free(vertex_enabled); vertex_enabled = NULL;
 	}
 
 	struct BottomUpReceiver : public Runnable {
@@ -3113,9 +4038,12 @@ public:
 		PRINT_VAL("%zd", sizeof(TwodVertex));
 
 		PRINT_VAL("%d", NUMA_BIND);
+		PRINT_VAL("%d", NUMA_PLACEMENT);
 		PRINT_VAL("%d", CPU_BIND_CHECK);
 		PRINT_VAL("%d", PRINT_BINDING);
 		PRINT_VAL("%d", SHARED_MEMORY);
+		PRINT_VAL("%d", SHARED_MEMORY_ENGINE);
+		PRINT_VAL("%d", PERSISTENT_REGION);
 
 		PRINT_VAL("%d", MPI_FUNNELED);
 		PRINT_VAL("%d", OPENMP_SUB_THREAD);
@@ -3240,7 +4168,10 @@ public:
 
    BitmapType* vertices_isSettled_;
    BitmapType* vertices_isSettledLocal_;
-   BitmapType* vertices_isInCurrentBucket_; // marks whether local vertex is in current bucket
+   BitmapType* vertices_isInCurrentBucket_; // marks local vertices already taken into the NQ, only set within top_down_make_nq
+   std::vector<LocalVertex> nq_dedup_buf_; // deduplicated NQ vertices by thread
+   mutable memory::ScratchArena scratch_; // temporary buffers of a phase (master thread only, the per-thread buffers are persistent)
+   SharedMemorySssp shared_sssp_; // used instead of the phases if there is only one rank
 	BitmapType* shared_visited_; // shared memory
 	TwodVertex* nq_recv_buf_; // shared memory (memory space is shared with work_buf_)
 
@@ -3275,8 +4206,52 @@ public:
 	memory::SpinBarrier thread_sync_;
 	std::vector<int64_t> prev_buckets_sizes;
 
+	// packed global reduction at phase boundaries
+	PhaseReduction phase_reduction_send_;
+	PhaseReduction phase_reduction_recv_;
+	MPI_Datatype phase_reduction_type_;
+	MPI_Op phase_reduction_op_;
+	MPI_Request phase_reduction_requests_[2]; // reduction, gathering of NQ sizes
+	int nq_send_size_;
+	std::vector<int> nq_recv_sizes_; // NQ sizes within the processor row
+	int next_bucket_cached_; // next non-empty bucket if already known, otherwise -1
+
+	// distances of the ranks of the processor column on the same node
+#if NODE_SHARED_DIST
+	MPI_Comm node_col_comm_;
+	MPI_Win node_dist_win_;
+	float* node_dist_local_; // used as dist_ during run_sssp
+	bool node_dist_clean_; // all entries of node_dist_local_ are infinite, restored by finalize_sssp_run
+	std::vector<const float*> node_dists_; // by rank_2dr (rank in comm_2dc), NULL if not co-located
+#endif
+	const float* const* active_node_dists_; // only set during run_sssp, otherwise NULL
+#if HUB_DELEGATION_VERTICES
+	// replicated hub distances, slot = rank_2dr * hub_count_ + local vertex
+	int64_t hub_count_;
+	int64_t hub_slots_;
+	uint64_t* hub_keys_; // distance bits << 32 | thread of the minimum in the current phase
+	int64_t* hub_preds_; // by thread and slot
+	std::vector<HubValue> hub_values_;
+	MPI_Datatype hub_value_type_;
+	MPI_Op hub_value_op_;
+#endif
+	float* dist_user_; // distance array of the caller if dist_ is node-shared
+#if BUCKET_FUSION
+	std::vector<TwodVertex> fusion_worklist_; // own vertices whose diagonal edges are to be relaxed
+	std::vector<std::vector<TwodVertex> > fusion_next_; // vertices improved by each thread in the current round
+	BitmapType* fusion_in_next_; // vertices in fusion_next_
+	bool nq_is_fused_; // the diagonal light edges of the NQ are relaxed
+	bool cq_is_fused_; // the CQ is expanded from a fused NQ
+#endif
+	const LocalVertex* scan_vertices_; // vertices of the root's component if restricted, else NULL
+	int64_t scan_size_;
+	bool settled_in_component_; // the settled bitmaps can only hold vertices of the component (after a restricted run)
+	bool clean_settled_component_; // the current run only cleans the settled words of the component
+	bool distance_only_; // see set_distance_only
+
 	VERBOSE(int64_t num_edge_top_down_);
 	VERBOSE(int64_t num_td_large_edge_);
+	VERBOSE(int64_t num_td_pruned_edge_); // relaxations skipped because they cannot improve the target
 	VERBOSE(int64_t num_edge_bottom_up_);
 	struct {
 		void* thread_local_;
@@ -3299,7 +4274,11 @@ private:
 	bool bellman_ford_is_promising(void) const;
 	void initialize_sssp_run();
 	void execute_sssp_run(int64_t root);
+	void execute_epochs(int64_t root);
    void finalize_sssp_run(int64_t root);
+#if PRED_RECONSTRUCTION
+   void reconstruct_predecessors(int64_t root);
+#endif
    void run_sssp_phases();
    void initialize_next_epoch(int64_t root, bool& hasNewEpoch);
    void initialize_heavy_phase(bool& epochHasHeavyEdges);
@@ -3348,6 +4327,13 @@ void SsspBase::initialize_sssp_run()
    bitmap_or_list_ = next_bitmap_or_list_;
    growing_or_shrinking_ = true;
    prev_buckets_sizes.clear();
+   next_bucket_cached_ = -1;
+
+   // a restricted run only touches the vertices of the root's component, as long as the settled bitmaps are not
+   // dirty from an unrestricted run
+   const bool is_restricted = (scan_vertices_ != NULL);
+   clean_settled_component_ = is_restricted && settled_in_component_;
+   settled_in_component_ = is_restricted;
 
    const int64_t num_local_verts = graph_.num_local_verts_;
    const int64_t bitmap_width = get_bitmap_size_local();
@@ -3359,19 +4345,55 @@ void SsspBase::initialize_sssp_run()
          assert(vertices_pos_[i] == -1);
 #endif
 
-   memory::clean_mt(vertices_isSettledLocal_, bitmap_width * sizeof(*vertices_isSettledLocal_));
+   if( clean_settled_component_ ) {
+      const LocalVertex* const scan_vertices = scan_vertices_;
+#pragma omp parallel for schedule(static)
+      for( int64_t k = 0; k < scan_size_; k++ ) {
+         const uint64_t word = scan_vertices[k] >> LOG_NBPE;
+         if( k == 0 || (scan_vertices[k - 1] >> LOG_NBPE) != word )
+            vertices_isSettledLocal_[word] = 0;
+      }
+   }
+   else
+      memory::clean_mt(vertices_isSettledLocal_, bitmap_width * sizeof(*vertices_isSettledLocal_));
+
+   // finalize_sssp_run resets the reached node-shared distances and only reads the predecessors of reached vertices,
+   // so after a finalized run nothing is left to do here
+#if NODE_SHARED_DIST
+   const bool is_clean = (dist == node_dist_local_ && node_dist_clean_);
+   node_dist_clean_ = false;
+#else
+   const bool is_clean = false;
+#endif
 
+   if( !is_clean && is_restricted ) {
+      // finalize_sssp_run ignores the distances of the other vertices
+      const LocalVertex* const scan_vertices = scan_vertices_;
+#pragma omp parallel for schedule(static)
+      for( int64_t k = 0; k < scan_size_; k++ ) {
+         pred[scan_vertices[k]] = -1;
+         dist[scan_vertices[k]] = std::numeric_limits<float>::max();
+      }
+   }
+   else if( !is_clean ) {
 #pragma omp parallel
-   {
+      {
 #pragma omp for nowait
-      for(int64_t i = 0; i < num_local_verts; ++i)
-         pred[i] = -1;
+         for(int64_t i = 0; i < num_local_verts; ++i)
+            pred[i] = -1;
 
 #pragma omp for nowait
-      for(int64_t i = 0; i < num_local_verts; ++i)
-         dist[i] = std::numeric_limits<float>::max();
+         for(int64_t i = 0; i < num_local_verts; ++i)
+            dist[i] = std::numeric_limits<float>::max();
+      }
    }
 
+#if HUB_DELEGATION_VERTICES
+   const uint64_t hub_key_init = (uint64_t(castFloatToUInt32(std::numeric_limits<float>::max())) << 32) | 0xFFFFFFFFu;
+   for( int64_t s = 0; s < hub_slots_; ++s )
+      hub_keys_[s] = hub_key_init;
+#endif
+
    assert (nq_.stack_.size() == 0);
    assert(!mpi.isYdimAvailable());
    //if(mpi.isYdimAvailable()) s_.sync->barrier();
@@ -3381,7 +4403,13 @@ void SsspBase::initialize_sssp_run()
 // actually execute the computations
 void SsspBase::execute_sssp_run(int64_t root)
 {
-   // main loop, iterates over the epochs
+   memory::g_team.run([&]() { execute_epochs(root); });
+}
+
+
+// main loop, iterates over the epochs
+void SsspBase::execute_epochs(int64_t root)
+{
    while( true ) {
       bool hasNewEpoch;
 
@@ -3421,7 +4449,6 @@ void SsspBase::finalize_sssp_run(int64_t root) {
 
    const int64_t num_orig_local_verts = graph_.num_orig_local_verts_;
    const int64_t num_local_verts = graph_.num_local_verts_;
-   const LocalVertex* const restrict invert_map = graph_.invert_map_;
 
    assert(work_buf_size_ >= int64_t(sizeof(int64_t)) * graph_.num_orig_local_verts_);
    assert(num_local_verts <= num_orig_local_verts);
@@ -3439,52 +4466,315 @@ void SsspBase::finalize_sssp_run(int64_t root) {
       assert(graph_.local_vertex_isDeg1(reordered));
    }
 
-   // 1. update the predecessors
+   // permutes the predecessors and distances of the reached vertices back to the original order in one pass;
+   // a vertex is reached iff its distance is finite, the predecessors of the others are not initialized
 
+   const LocalVertex* const restrict reorder_map = graph_.reorder_map_;
    int64_t* const restrict pred = pred_;
-   int64_t* pred_tmp = (int64_t*) work_buf_;
-   assert(work_buf_size_ % alignof(*pred_tmp) == 0);
+   float* const restrict dist = dist_;
+   // dist_ might be node-shared and only hold the local vertices, then the distances are written directly
+   float* const dist_out = (dist_user_ != NULL) ? dist_user_ : dist;
+   const bool dist_in_place = (dist_out == dist);
+   const bool reset_dist = (dist_user_ != NULL);
+   // a restricted run did not reset the distances outside the root's component
+   const BitmapType* const restrict is_in_component = scan_vertices_ ? graph_.is_giant_bitmap_ : NULL;
+   const bool has_preds = !(PRED_RECONSTRUCTION && distance_only_);
+
+   update_work_buf(roundup<int64_t>(num_orig_local_verts * (sizeof(int64_t) + (dist_in_place ? sizeof(float) : 0)), sizeof(int64_t)));
+   int64_t* const restrict pred_tmp = (int64_t*) work_buf_;
+   float* const restrict dist_tmp = dist_in_place ? (float*) (pred_tmp + num_orig_local_verts) : dist_out;
+   work_buf_state_ = Work_buf_state::dists;
 
-#pragma omp parallel for schedule(static)
-   for( int64_t i = 0; i < num_orig_local_verts; i++ ) {
-      pred_tmp[i] = -1;
+#pragma omp parallel
+   {
+#pragma omp for schedule(static)
+      for( int64_t i = 0; i < num_orig_local_verts; i++ ) {
+         const LocalVertex v = reorder_map[i];
+         if( int64_t(v) < num_local_verts && dist[v] < comp::infinity
+               && (!is_in_component || (is_in_component[v >> LOG_NBPE] & (BitmapType(1) << (v & NBPE_MASK)))) ) {
+            assert(pred[v] >= 0 || !has_preds);
+            pred_tmp[i] = has_preds ? pred[v] : -1;
+            dist_tmp[i] = dist[v];
+            if( reset_dist )
+               dist[v] = std::numeric_limits<float>::max();
+         }
+         else {
+            if( reset_dist && int64_t(v) < num_local_verts )
+               dist[v] = std::numeric_limits<float>::max();
+            pred_tmp[i] = -1;
+            dist_tmp[i] = std::numeric_limits<float>::max();
+         }
+      } // implicit barrier
+
+#pragma omp for schedule(static) nowait
+      for( int64_t i = 0; i < num_orig_local_verts; i++ )
+         pred[i] = pred_tmp[i];
+
+      if( dist_in_place ) {
+#pragma omp for schedule(static) nowait
+         for( int64_t i = 0; i < num_orig_local_verts; i++ )
+            dist[i] = dist_tmp[i];
+      }
    }
 
-#pragma omp parallel for schedule(static)
-   for( int64_t i = 0; i < num_local_verts; i++ ) {
-      if( pred[i] < 0 ) {
-         assert(pred[i] == -1);
-         continue;
+#if NODE_SHARED_DIST
+   node_dist_clean_ = reset_dist;
+#endif
+}
+
+#if PRED_RECONSTRUCTION
+// sets the predecessor of every reached vertex but the root to a neighbor on a shortest path, after the distances are final.
+// First, only neighbors with strictly smaller distance are taken; vertices that are only reached by (almost) zero weight edges
+// take a tight neighbor that got its predecessor in the previous round. Thus, the predecessors form a tree.
+// The distances are gathered as bitmaps of the reached vertices with their distances in compact lists, and only the
+// tight edges are sent to the owners of their targets, as (target, source) pairs.
+void SsspBase::reconstruct_predecessors(int64_t root) {
+   TRACER(pred_reconstruction);
+   VERBOSE(const double start_time = MPI_Wtime());
+   const int64_t num_local_verts = graph_.num_local_verts_;
+   const int64_t local_bitmap_width = num_local_verts / NBPE;
+   const int64_t src_bitmap_width = local_bitmap_width * mpi.size_2dc;
+   const int lgl = graph_.local_bits_;
+   const int64_t local_mask = (int64_t(1) << lgl) - 1;
+   const int64_t r_mask = (int64_t(1) << graph_.r_bits_) - 1;
+   const int64_t P = mpi.size_2d;
+   const int C = mpi.size_2dc;
+   const int R = mpi.size_2dr;
+   const int r = mpi.rank_2dr;
+   const int max_threads = omp_get_max_threads();
+   const int64_t* const restrict edge_array = graph_.edge_array_;
+   const float* const restrict edge_weight_array = graph_.edge_weight_array_;
+   const float* const restrict dist = dist_;
+   int64_t* const restrict pred = pred_;
+   const int64_t no_pred = std::numeric_limits<int64_t>::max();
+   // a restricted run did not reset the distances outside the root's component
+   const BitmapType* const is_in_component = scan_vertices_ ? graph_.is_giant_bitmap_ : NULL;
+
+   BitmapType* is_reached = (BitmapType*)cache_aligned_xmalloc(local_bitmap_width * sizeof(*is_reached));
+   BitmapType* has_pred = (BitmapType*)cache_aligned_xcalloc(local_bitmap_width * sizeof(*has_pred));
+   int64_t num_reached = 0;
+#pragma omp parallel for schedule(static) reduction(+: num_reached)
+   for( int64_t w = 0; w < local_bitmap_width; w++ ) {
+      BitmapType bits = 0;
+      for( int b = 0; b < NBPE; b++ ) {
+         const int64_t v = w * NBPE + b;
+         if( dist[v] < comp::infinity && (!is_in_component || (is_in_component[w] & (BitmapType(1) << b))) ) {
+            bits |= BitmapType(1) << b;
+            pred[v] = no_pred;
+         }
       }
-      const LocalVertex tgt_orig = invert_map[i];
-      assert(0 <= tgt_orig && tgt_orig < num_orig_local_verts);
-      pred_tmp[tgt_orig] = pred[i];
+      is_reached[w] = bits;
+      num_reached += __builtin_popcountl(bits);
+   }
+   int64_t num_assigned = 0;
+   int64_t root_reordered = -1;
+   if( vertex_owner(root) == mpi.rank_2d ) {
+      root_reordered = graph_.reorder_map_[vertex_local(root)];
+      assert(is_reached[root_reordered >> LOG_NBPE] & (BitmapType(1) << (root_reordered & NBPE_MASK)));
+      pred[root_reordered] = root;
+      has_pred[root_reordered >> LOG_NBPE] |= BitmapType(1) << (root_reordered & NBPE_MASK);
+      num_assigned = 1;
    }
-   memory::copy_mt(pred, pred_tmp, num_orig_local_verts * sizeof(*pred_tmp));
 
+   // distances of the reached vertices in ascending order
+   std::vector<int64_t> word_offsets(local_bitmap_width + 1);
+   word_offsets[0] = 0;
+   for( int64_t w = 0; w < local_bitmap_width; w++ )
+      word_offsets[w + 1] = word_offsets[w] + __builtin_popcountl(is_reached[w]);
+   std::vector<float> reached_dists(num_reached);
+#pragma omp parallel for schedule(static)
+   for( int64_t w = 0; w < local_bitmap_width; w++ ) {
+      int64_t k = word_offsets[w];
+      for( BitmapType bits = is_reached[w]; bits != 0; bits &= bits - 1 )
+         reached_dists[k++] = dist[w * NBPE + __builtin_ctzl(bits)];
+   }
 
-   // 2. update the distances
+   // the reached vertices of the processor row (sources) and column (targets) with their distances
+   struct ReachedDists {
+      BitmapType* bitmap; // Index: rank in the communicator * num_local_verts + local
+      std::vector<int64_t> offsets; // of the first distance of each word
+      std::vector<float> dists;
+
+      float get(int64_t idx) const {
+         const BitmapType word = bitmap[idx >> LOG_NBPE];
+         const BitmapType bit = BitmapType(1) << (idx & NBPE_MASK);
+         if( !(word & bit) )
+            return std::numeric_limits<float>::max();
+         return dists[offsets[idx >> LOG_NBPE] + __builtin_popcountl(word & (bit - 1))];
+      }
+   } row_reached, col_reached;
+   const auto gather_reached = [&](ReachedDists& reached, MPI_Comm comm, int comm_size) {
+      const int64_t width = local_bitmap_width * comm_size;
+      reached.bitmap = (BitmapType*)cache_aligned_xmalloc(width * sizeof(*reached.bitmap));
+      MPI_Allgather(is_reached, local_bitmap_width, MpiTypeOf<BitmapType>::type,
+            reached.bitmap, local_bitmap_width, MpiTypeOf<BitmapType>::type, comm);
+      reached.offsets.resize(width + 1);
+      reached.offsets[0] = 0;
+      for( int64_t w = 0; w < width; w++ )
+         reached.offsets[w + 1] = reached.offsets[w] + __builtin_popcountl(reached.bitmap[w]);
+      std::vector<int> counts(comm_size), displs(comm_size);
+      for( int i = 0; i < comm_size; i++ ) {
+         displs[i] = int(reached.offsets[i * local_bitmap_width]);
+         counts[i] = int(reached.offsets[(i + 1) * local_bitmap_width]) - displs[i];
+      }
+      reached.dists.resize(reached.offsets[width]);
+      MPI_Allgatherv(reached_dists.data(), int(num_reached), MPI_FLOAT,
+            reached.dists.data(), counts.data(), displs.data(), MPI_FLOAT, comm);
+   };
+   gather_reached(row_reached, mpi.comm_2dr, C);
+   gather_reached(col_reached, mpi.comm_2dc, R);
+   std::vector<float>().swap(reached_dists);
+
+   std::vector<std::vector<int64_t> > thread_sends(max_threads * R); // (target, source) pairs by row of the target
+   std::vector<std::vector<uint32_t> > thread_frontier(max_threads);
+   std::vector<uint32_t> frontier, src_frontier; // vertices that got their predecessor in the previous round
+   std::vector<int64_t> send_buf, recv_buf;
+   std::vector<int> src_counts(C), src_offsets(C + 1);
+   std::vector<int> send_counts(R), send_offsets(R + 1), recv_counts(R), recv_offsets(R + 1);
+
+   int num_rounds = 0;
+   int64_t num_missing = 0;
+   for( bool changed = true; changed; ++num_rounds ) {
+      const bool is_first_round = (num_rounds == 0);
+      if( !is_first_round ) {
+         const int frontier_size = int(frontier.size());
+         MPI_Allgather(&frontier_size, 1, MPI_INT, src_counts.data(), 1, MPI_INT, mpi.comm_2dr);
+         src_offsets[0] = 0;
+         for( int c = 0; c < C; c++ )
+            src_offsets[c + 1] = src_offsets[c] + src_counts[c];
+         src_frontier.resize(src_offsets[C]);
+         MPI_Allgatherv(frontier.data(), frontier_size, MPI_UINT32_T,
+               src_frontier.data(), src_counts.data(), src_offsets.data(), MPI_UINT32_T, mpi.comm_2dr);
+      }
 
-   float* const restrict dist = dist_;
-   float* dist_tmp = (float*) work_buf_;
-   work_buf_state_ = Work_buf_state::dists;
-   assert(work_buf_size_ % alignof(*dist_tmp) == 0);
+#pragma omp parallel
+      {
+         std::vector<int64_t>* const sends = &thread_sends[omp_get_thread_num() * R];
+         // sends the tight edges of a reached source
+         const auto send_tight_edges = [&](TwodVertex compact, int64_t row, float distance) {
+            const int64_t src_orig = int64_t(graph_.orig_vertexes_[row]) * P + int64_t(compact / num_local_verts) * R + r;
+            for( int64_t e = graph_.row_starts_[row]; e < graph_.row_starts_[row + 1]; e++ ) {
+               const int64_t tgt = edge_array[e];
+               const int64_t dest = (tgt >> lgl) & r_mask;
+               const float tgt_dist = col_reached.get(dest * num_local_verts + (tgt & local_mask));
+               if( !comp::isEQ(edge_weight_array[e] + distance, tgt_dist) || (is_first_round && !(distance < tgt_dist)) )
+                  continue;
+               sends[dest].push_back(tgt & local_mask);
+               sends[dest].push_back(src_orig);
+            }
+         };
+
+         if( is_first_round ) {
+#pragma omp for schedule(dynamic, 64)
+            for( int64_t word_idx = 0; word_idx < src_bitmap_width; word_idx++ ) {
+               TwodVertex non_zero_off;
+               BitmapType row_bitmap_i = graph_.row_word(word_idx, non_zero_off);
+               const BitmapType reached_i = row_reached.bitmap[word_idx];
+               for( ; row_bitmap_i != 0; row_bitmap_i &= row_bitmap_i - 1, ++non_zero_off ) {
+                  const BitmapType bit = row_bitmap_i & -row_bitmap_i;
+                  if( !(reached_i & bit) )
+                     continue;
+                  const float distance = row_reached.dists[row_reached.offsets[word_idx] + __builtin_popcountl(reached_i & (bit - 1))];
+                  send_tight_edges(word_idx * NBPE + __builtin_ctzl(bit), non_zero_off, distance);
+               }
+            }
+         }
+         else {
+#pragma omp for schedule(dynamic, 64)
+            for( int64_t i = 0; i < src_offsets[C]; i++ ) {
+               const int c = int(std::upper_bound(src_offsets.begin(), src_offsets.end(), int(i)) - src_offsets.begin()) - 1;
+               const TwodVertex compact = TwodVertex(c) * num_local_verts + src_frontier[i];
+               const int64_t row = graph_.row_of(compact);
+               if( row >= 0 )
+                  send_tight_edges(compact, row, row_reached.get(compact));
+            }
+         }
+      } // #pragma omp parallel
+
+      send_offsets[0] = 0;
+      for( int d = 0; d < R; d++ ) {
+         send_counts[d] = 0;
+         for( int t = 0; t < max_threads; t++ )
+            send_counts[d] += int(thread_sends[t * R + d].size());
+         send_offsets[d + 1] = send_offsets[d] + send_counts[d];
+      }
+      send_buf.resize(send_offsets[R]);
+      for( int d = 0; d < R; d++ ) {
+         int64_t offset = send_offsets[d];
+         for( int t = 0; t < max_threads; t++ ) {
+            std::vector<int64_t>& sends = thread_sends[t * R + d];
+            std::copy(sends.begin(), sends.end(), send_buf.begin() + offset);
+            offset += sends.size();
+            sends.clear();
+         }
+      }
+      MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, mpi.comm_2dc);
+      recv_offsets[0] = 0;
+      for( int d = 0; d < R; d++ )
+         recv_offsets[d + 1] = recv_offsets[d] + recv_counts[d];
+      recv_buf.resize(recv_offsets[R]);
+      MPI_Alltoallv(send_buf.data(), send_counts.data(), send_offsets.data(), MpiTypeOf<int64_t>::type,
+            recv_buf.data(), recv_counts.data(), recv_offsets.data(), MpiTypeOf<int64_t>::type, mpi.comm_2dc);
+
+      // the smallest source of this round becomes the predecessor of a vertex without one
+      const int64_t num_recv = int64_t(recv_buf.size()) / 2;
+#pragma omp parallel
+      {
+#pragma omp for schedule(static)
+         for( int64_t i = 0; i < num_recv; i++ ) {
+            const int64_t tgt_local = recv_buf[2 * i];
+            const int64_t src = recv_buf[2 * i + 1];
+            if( has_pred[tgt_local >> LOG_NBPE] & (BitmapType(1) << (tgt_local & NBPE_MASK)) )
+               continue;
+            int64_t old_pred = pred[tgt_local];
+            while( src < old_pred && !__sync_bool_compare_and_swap(&pred[tgt_local], old_pred, src) )
+               old_pred = pred[tgt_local];
+         } // implicit barrier
 
-#pragma omp parallel for schedule(static)
-   for( int64_t i = 0; i < num_orig_local_verts; i++ ) {
-      dist_tmp[i] = std::numeric_limits<float>::max();
+         std::vector<uint32_t>& new_preds = thread_frontier[omp_get_thread_num()];
+#pragma omp for schedule(static)
+         for( int64_t i = 0; i < num_recv; i++ ) {
+            const int64_t tgt_local = recv_buf[2 * i];
+            const BitmapType mask = BitmapType(1) << (tgt_local & NBPE_MASK);
+            if( (has_pred[tgt_local >> LOG_NBPE] & mask) || pred[tgt_local] == no_pred )
+               continue;
+            if( !(__sync_fetch_and_or(&has_pred[tgt_local >> LOG_NBPE], mask) & mask) )
+               new_preds.push_back(uint32_t(tgt_local));
+         }
+      } // #pragma omp parallel
+
+      frontier.clear();
+      for( int t = 0; t < max_threads; t++ ) {
+         frontier.insert(frontier.end(), thread_frontier[t].begin(), thread_frontier[t].end());
+         thread_frontier[t].clear();
+      }
+      num_assigned += frontier.size();
+      // the root is a source of the later rounds as well, it can have neighbors at the same distance
+      if( is_first_round && root_reordered >= 0 )
+         frontier.push_back(uint32_t(root_reordered));
+
+      int64_t counts[2] = { int64_t(frontier.size()), num_reached - num_assigned }; // sources of the next round, still missing
+      MPI_Allreduce(MPI_IN_PLACE, counts, 2, MpiTypeOf<int64_t>::type, MPI_SUM, mpi.comm_2d);
+      num_missing = counts[1];
+      changed = (counts[0] > 0 && num_missing > 0);
    }
 
-#pragma omp parallel for schedule(static)
-   for( int64_t i = 0; i < num_local_verts; i++ ) {
-      if( dist[i] >= comp::infinity )
-         continue;
-      const LocalVertex tgt_orig = invert_map[i];
-      assert(0 <= tgt_orig && tgt_orig < num_orig_local_verts);
-      dist_tmp[tgt_orig] = dist[i];
+   // the predecessors of the others would be left at no_pred
+   if( num_missing > 0 ) {
+      if( mpi.isMaster() )
+         print_with_prefix("Error: no predecessor found for %" PRId64 " reached vertices", num_missing);
+      MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
    }
-   memory::copy_mt(dist, dist_tmp, num_orig_local_verts * sizeof(*dist_tmp));
+
+   free(is_reached);
+   free(has_pred);
+   free(row_reached.bitmap);
+   free(col_reached.bitmap);
+
+   VERBOSE(profiling::pred_reconstruction_time += MPI_Wtime() - start_time);
+   VERBOSE(profiling::pred_reconstruction_rounds += num_rounds);
 }
+#endif
 
 // initializes next epoch of delta-stepping algorithm
 void SsspBase::initialize_next_epoch(int64_t root, bool& hasNewEpoch)
@@ -3516,6 +4806,7 @@ void SsspBase::initialize_next_epoch(int64_t root, bool& hasNewEpoch)
 
          is_bellman_ford_ = true;
          next_bitmap_or_list_ = true;
+         next_bucket_cached_ = -1;
 
          if( mpi.isMaster() )
             printf("Switched to Bellman-Ford! \n");
@@ -3552,21 +4843,26 @@ void SsspBase::initialize_heavy_phase(bool& epochHasHeavyEdges)
 {
    assert(is_light_phase_);
    is_light_phase_ = false;
-   const int64_t global_nq_size = bucket_get_nq_size();
+   const PhaseReduction sizes = bucket_get_sizes();
+   const int64_t global_nq_size = sizes.nq_size;
    epochHasHeavyEdges = (global_nq_size > 0);
 
+   // distances do not change without heavy phase, so the next bucket is already known
+   if( !epochHasHeavyEdges )
+      next_bucket_cached_ = int(sizes.next_bucket);
+
    // todo have some relative limit for global_next_bucket_size_!
    if( (global_nq_size >= 1000 || has_settled_vertices_ ) )
    {
-      bucket_expand_settled_bitmap(global_nq_size);
+      bucket_expand_settled_bitmap(sizes.n_settled);
       assert(has_settled_vertices_);
    }
 
    if( !epochHasHeavyEdges )
       return;
 
-   int64_t size;
-   top_down_expand_bucket(size);
+   int64_t size = global_nq_size;
+   top_down_expand_bucket(size, true);
    assert(global_nq_size == size);
 }
 
@@ -3585,7 +4881,7 @@ void SsspBase::run_sssp_phases()
 
 #if VERBOSE_MODE
       double prev_time = MPI_Wtime();
-      num_edge_top_down_ = num_td_large_edge_ = num_edge_bottom_up_ = 0;
+      num_edge_top_down_ = num_td_large_edge_ = num_td_pruned_edge_ = num_edge_bottom_up_ = 0;
 #endif
 #if ENABLE_FUJI_PROF
       fapp_start(prof_mes[(int)forward_or_backward_], 0, 0);
@@ -3600,6 +4896,10 @@ void SsspBase::run_sssp_phases()
 
       top_down_search();
 
+      // set direction (bottom-up or top-down) of next iteration //
+      next_bitmap_or_list_ = false;//!forward_or_backward_;
+
+      const int nq_size = top_down_reduce_and_make_nq();
       global_visited_vertices_ += global_nq_size_;
 
 #if VERBOSE_MODE
@@ -3607,6 +4907,7 @@ void SsspBase::run_sssp_phases()
       assert(cur_fold_time >= 0.0);
       fold_time += cur_fold_time;
       total_edge_top_down += num_edge_top_down_;
+      pruned_edges[is_bellman_ford_ ? 2 : (is_light_phase_ ? 0 : 1)] += num_td_pruned_edge_;
       total_edge_bottom_up += num_edge_bottom_up_;
 #if PROFILING_MODE
       AsyncAlltoallManager* a2a_comm = forward_or_backward_ ? &td_comm_ : NULL;
@@ -3639,6 +4940,7 @@ void SsspBase::run_sssp_phases()
       if(forward_or_backward_) {
          profiling::g_pis.submitCounter(num_edge_top_down_, "top-down edge relax", current_phase_);
          profiling::g_pis.submitCounter(num_td_large_edge_, "top-down large edge", current_phase_);
+         profiling::g_pis.submitCounter(num_td_pruned_edge_, "top-down pruned edge", current_phase_);
       }
       else
          profiling::g_pis.submitCounter(num_edge_bottom_up_, "bottom-up edge relax", current_phase_);
@@ -3659,13 +4961,11 @@ void SsspBase::run_sssp_phases()
       start_collection("expand");
 #endif
 
-      // set direction (bottom-up or top-down) of next iteration //
-      next_bitmap_or_list_ = false;//!forward_or_backward_;
-
       if( global_nq_size_ == 0 )
          break;
 
-      top_down_expand();
+      // expand NQ within a processor column
+      top_down_expand_nq(nq_size, nq_recv_sizes_.data());
       clear_nq_stack();
 
 #if ENABLE_FUJI_PROF
@@ -3693,6 +4993,10 @@ void SsspBase::run_sssp(int64_t root, int64_t* pred, float* dist)
 	dist_ = dist;
 	is_presolve_mode_ = false;
 	assert(!cq_root_list_ && !nq_root_list_);
+#if NODE_SHARED_DIST
+	dist_user_ = dist;
+	dist_ = node_dist_local_;
+#endif
 
 #if VERBOSE_MODE
 	using namespace profiling;
@@ -3701,9 +5005,35 @@ void SsspBase::run_sssp(int64_t root, int64_t* pred, float* dist)
 	expand_settled_bitmap_time = expand_buckets_time = expand_time = fold_time = 0.0;
 	total_edge_top_down = total_edge_bottom_up = 0;
 	g_tp_comm = g_bu_pred_comm = g_bu_bitmap_comm = g_bu_list_comm = g_expand_bitmap_comm = g_expand_list_comm = 0;
+	expand_list_raw_bytes = expand_list_sent_bytes = 0;
+	node_shared_filtered = 0;
+	hub_delegated = 0;
+	fold_self_relaxed = fold_sent_relaxed = 0;
+	bucket_fusion_relaxed = bucket_fusion_added = 0;
+	pruned_edges[0] = pruned_edges[1] = pruned_edges[2] = 0;
+	pruned_vertices[0] = pruned_vertices[1] = 0;
+	pred_reconstruction_time = 0.0;
+	pred_reconstruction_rounds = 0;
+	td_comm_.reset_node_aware_stats();
+	scratch_.reset_stats();
+#endif
+
+#if COMPONENT_PREPASS
+	// the bucket scans and resets only visit the vertices of the root's component, the others stay unreached
+	int root_in_giant = graph_.in_giant_component(root);
+	MPI_Bcast(&root_in_giant, 1, MPI_INT, vertex_owner(root), mpi.comm_2d);
+	if( root_in_giant ) {
+	   scan_vertices_ = graph_.giant_vertices_;
+	   scan_size_ = graph_.num_giant_vertices_;
+	}
 #endif
 
 	initialize_sssp_run();
+#if NODE_SHARED_DIST
+	// the co-located ranks must not read stale distances of the previous run
+	MPI_Barrier(node_col_comm_);
+	active_node_dists_ = node_dists_.data();
+#endif
    assert(prev_buckets_sizes.size() == 0);
 
 #if VERBOSE_MODE
@@ -3717,14 +5047,39 @@ void SsspBase::run_sssp(int64_t root, int64_t* pred, float* dist)
 #endif
 
 
+#if SHARED_MEMORY_ENGINE
+	if( shared_sssp_.is_allocated() ) {
+	   reset_root_grad1 = false;
+	   shared_sssp_.run(root, delta_step_, dist_, pred_);
+	}
+	else
+#endif
 	execute_sssp_run(root);
+#if PRED_RECONSTRUCTION
+	if( !distance_only_ )
+	   reconstruct_predecessors(root);
+#endif
 
+	active_node_dists_ = NULL;
 	finalize_sssp_run(root);
+	scan_vertices_ = NULL;
+	scan_size_ = 0;
+#if NODE_SHARED_DIST
+	dist_ = dist_user_;
+	dist_user_ = NULL;
+#endif
 
 #if VERBOSE_MODE
 	if(mpi.isMaster()) print_with_prefix("Time of SSSP: %f ms", (MPI_Wtime() - start_time) * 1000.0);
-   const int time_cnt = 4;
-	double send_time[] = { fold_time, expand_time, expand_buckets_time, expand_settled_bitmap_time };
+#if SHARED_MEMORY_ENGINE
+	if(mpi.isMaster() && shared_sssp_.is_allocated()) {
+	   print_with_prefix("Shared-memory SSSP: %" PRId64 " buckets, %" PRId64 " light phases",
+	         shared_sssp_.num_buckets(), shared_sssp_.num_light_phases());
+	}
+#endif
+   const int time_cnt = 5;
+	double send_time[] = { fold_time, expand_time, expand_buckets_time, expand_settled_bitmap_time,
+	      expand_time + expand_buckets_time + expand_settled_bitmap_time };
 	double sum_time[time_cnt], max_time[time_cnt];
 	MPI_Reduce(send_time, sum_time, time_cnt, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
 	MPI_Reduce(send_time, max_time, time_cnt, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
@@ -3733,6 +5088,78 @@ void SsspBase::run_sssp(int64_t root, int64_t* pred, float* dist)
       printTime("Avg time of expand: %f ms, %f %%+", sum_time, max_time, 1);
       printTime("Avg time of bucket expand: %f ms, %f %%+", sum_time, max_time, 2);
       printTime("Avg time of bitmap expand: %f ms, %f %%+", sum_time, max_time, 3);
+      if(mpi.grid_fold_time >= 0.0) {
+         // the prediction is for the slowest rank
+         print_with_prefix("Grid planner fold: predicted %f ms, measured avg %f ms, max %f ms", mpi.grid_fold_time * 1000.0,
+               sum_time[0] / mpi.size_2d * 1000.0, max_time[0] * 1000.0);
+         print_with_prefix("Grid planner expand: predicted %f ms, measured avg %f ms, max %f ms", mpi.grid_expand_time * 1000.0,
+               sum_time[4] / mpi.size_2d * 1000.0, max_time[4] * 1000.0);
+      }
+   }
+
+   int64_t send_bytes[] = { expand_list_raw_bytes, expand_list_sent_bytes };
+   int64_t sum_bytes[2];
+   MPI_Reduce(send_bytes, sum_bytes, 2, MpiTypeOf<int64_t>::type, MPI_SUM, 0, MPI_COMM_WORLD);
+   if(mpi.isMaster() && sum_bytes[1] > 0) {
+      print_with_prefix("Expand list recv: %f MiB (uncompressed %f MiB, ratio %f)",
+            to_mega(sum_bytes[1]), to_mega(sum_bytes[0]), double(sum_bytes[0]) / double(sum_bytes[1]));
+   }
+
+   int64_t send_filtered[] = { node_shared_filtered, hub_delegated };
+   int64_t sum_filtered[2];
+   MPI_Reduce(send_filtered, sum_filtered, 2, MpiTypeOf<int64_t>::type, MPI_SUM, 0, MPI_COMM_WORLD);
+   if(mpi.isMaster() && sum_filtered[0] > 0) {
+      print_with_prefix("Relaxations to co-located ranks filtered before fold: %" PRId64, sum_filtered[0]);
+   }
+   if(mpi.isMaster() && sum_filtered[1] > 0) {
+      print_with_prefix("Relaxations to hub vertices delegated: %" PRId64, sum_filtered[1]);
+   }
+
+   int64_t send_fold[] = { fold_self_relaxed, fold_sent_relaxed };
+   int64_t sum_fold[2];
+   MPI_Reduce(send_fold, sum_fold, 2, MpiTypeOf<int64_t>::type, MPI_SUM, 0, MPI_COMM_WORLD);
+   if(mpi.isMaster() && sum_fold[0] + sum_fold[1] > 0) {
+      print_with_prefix("Fold relaxations applied by the sender (own rank): %" PRId64 " of %" PRId64 " (%f %%)",
+            sum_fold[0], sum_fold[0] + sum_fold[1], 100.0 * double(sum_fold[0]) / double(sum_fold[0] + sum_fold[1]));
+   }
+
+   int64_t send_fusion[] = { bucket_fusion_relaxed, bucket_fusion_added };
+   int64_t sum_fusion[2];
+   MPI_Reduce(send_fusion, sum_fusion, 2, MpiTypeOf<int64_t>::type, MPI_SUM, 0, MPI_COMM_WORLD);
+   if(mpi.isMaster() && sum_fusion[0] > 0) {
+      print_with_prefix("Bucket fusion: %" PRId64 " local relaxations, %" PRId64 " vertices added to NQ", sum_fusion[0], sum_fusion[1]);
+   }
+
+   int64_t send_pruned[] = { pruned_edges[0], pruned_edges[1], pruned_edges[2], pruned_vertices[0], pruned_vertices[1] };
+   int64_t sum_pruned[5];
+   MPI_Reduce(send_pruned, sum_pruned, 5, MpiTypeOf<int64_t>::type, MPI_SUM, 0, MPI_COMM_WORLD);
+   if(mpi.isMaster()) {
+      print_with_prefix("Pruned relaxations: light %" PRId64 ", heavy %" PRId64 ", Bellman-Ford %" PRId64, sum_pruned[0], sum_pruned[1], sum_pruned[2]);
+      print_with_prefix("Pruned bucket vertices: light %" PRId64 ", heavy %" PRId64, sum_pruned[3], sum_pruned[4]);
+   }
+
+   int64_t send_scratch[] = { scratch_.num_allocs(), scratch_.num_fallbacks(), scratch_.num_grows() };
+   int64_t sum_scratch[3];
+   MPI_Reduce(send_scratch, sum_scratch, 3, MpiTypeOf<int64_t>::type, MPI_SUM, 0, MPI_COMM_WORLD);
+   double send_scratch_max[] = { scratch_.fallback_time(), double(scratch_.high_water()) };
+   double max_scratch[2];
+   MPI_Reduce(send_scratch_max, max_scratch, 2, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+   if(mpi.isMaster()) {
+      print_with_prefix("Scratch buffers: %" PRId64 " allocations, %" PRId64 " not from the arena (%f ms max), %" PRId64 " arena growths, high water %f MB max",
+            sum_scratch[0], sum_scratch[1], max_scratch[0] * 1000.0, sum_scratch[2], max_scratch[1] / (1024.0 * 1024.0));
+   }
+#if PRED_RECONSTRUCTION
+   if(mpi.isMaster()) print_with_prefix("Time of predecessor reconstruction: %f ms (%d rounds)", pred_reconstruction_time * 1000.0, int(pred_reconstruction_rounds));
+#endif
+
+   if(td_comm_.node_aware_stats() != NULL) {
+      int64_t sum_fold_msgs[6];
+      MPI_Reduce(td_comm_.node_aware_stats(), sum_fold_msgs, 6, MpiTypeOf<int64_t>::type, MPI_SUM, 0, MPI_COMM_WORLD);
+      if(mpi.isMaster()) {
+         print_with_prefix("Fold messages flat: %" PRId64 " (%f MiB)", sum_fold_msgs[0], to_mega(sum_fold_msgs[1]));
+         print_with_prefix("Fold messages node-aware: %" PRId64 " intra-node (%f MiB), %" PRId64 " inter-node (%f MiB)",
+               sum_fold_msgs[2], to_mega(sum_fold_msgs[3]), sum_fold_msgs[4], to_mega(sum_fold_msgs[5]));
+      }
    }
 
 #if 0
@@ -54,10 +54,10 @@ private:
       if(mpi.isMaster()) print_with_prefix("Time of initialize: %f ms", (MPI_Wtime() - start_time) * 1000.0);
    #endif
 
-      sssp_.cq_root_list_ = (int64_t*) page_aligned_xmalloc(sssp_.cq_distance_buf_length_ * sizeof(*sssp_.cq_root_list_));
-      sssp_.nq_root_list_ = (int64_t*) page_aligned_xmalloc(sssp_.nq_buf_length_ * sizeof(*sssp_.nq_root_list_));
-      sssp_.dist_presol_ = (float*) cache_aligned_xmalloc(graph_.pred_size()*sizeof(*sssp_.dist_presol_));
-      sssp_.pred_presol_ = (int64_t*) cache_aligned_xmalloc(graph_.pred_size()*sizeof(*sssp_.pred_presol_));
+      sssp_.cq_root_list_ = (int64_t*) page_aligned_xmalloc(sssp_.cq_distance_buf_length_ * sizeof(*sssp_.cq_root_list_), memory::TAG_QUEUE);
+      sssp_.nq_root_list_ = (int64_t*) page_aligned_xmalloc(sssp_.nq_buf_length_ * sizeof(*sssp_.nq_root_list_), memory::TAG_QUEUE);
+      sssp_.dist_presol_ = (float*) huge_aligned_xmalloc(graph_.pred_size()*sizeof(*sssp_.dist_presol_), memory::TAG_VERTEX);
+      sssp_.pred_presol_ = (int64_t*) huge_aligned_xmalloc(graph_.pred_size()*sizeof(*sssp_.pred_presol_), memory::TAG_VERTEX);
       for( int i = 0; i < graph_.pred_size(); i++ ) {
          sssp_.dist_presol_[i] = std::numeric_limits<float>::max();
          sssp_.pred_presol_[i] = -1;
@@ -122,11 +122,10 @@ private:
       if( nq_size > 0 ) {
          top_down_mark_redundant_edges();
 
+         memory::ScratchScope bottom_up_scratch(sssp_.scratch_);
          BitmapType* q_row_sums = expand_dominated_bottom_up();
          bottom_up_mark_redundant_edges(q_row_sums);
 
-         free(q_row_sums);
-
          delete_marked_edges();
       }
 
@@ -357,7 +356,8 @@ private:
 
 
 
-   // expands dominated vertices (and predecessors) during presolving
+   // expands dominated vertices (and predecessors) during presolving; the returned row sums come from the scratch arena
+   // of sssp_, so the caller has to hold a scope
    BitmapType* expand_dominated_bottom_up() {
       assert(!sssp_.next_bitmap_or_list_);
       const TwodVertex shifted_r = TwodVertex(mpi.rank_2dr) << graph_.local_bits_;
@@ -419,7 +419,7 @@ private:
       }
 
       const int64_t q_size = sssp_.get_bitmap_size_local() * mpi.size_2dr;
-      BitmapType* q_row_sums = (BitmapType*)cache_aligned_xmalloc((q_size + 1) * sizeof(*q_row_sums));
+      BitmapType* q_row_sums = (BitmapType*)sssp_.scratch_.alloc((q_size + 1) * sizeof(*q_row_sums));
 
       q_row_sums[0] = 0;
       for(int64_t i = 0; i < q_size; ++i) {
@@ -667,6 +667,8 @@ void SsspPresolver::presolve_sssp(int niterations, int64_t* pred, float* dist)
       max_seconds = std::stoi(presol_time_char);
    assert(max_seconds >= 1);
 
+   // deleting edges works on row_bitmap_ and row_sums_
+   graph_.expand_rows();
    MPI_Barrier(mpi.comm_2d);
 
    for( int i = 0; i < n_repeats && !is_stopped; i++ ) {
@@ -694,6 +696,7 @@ void SsspPresolver::presolve_sssp(int niterations, int64_t* pred, float* dist)
 
    assert(graph_.edge_head_ownerc_);
    free(graph_.edge_head_ownerc_); graph_.edge_head_ownerc_ = nullptr;
+   sssp_.compress_rows();
 }
 
 
@@ -19,6 +19,7 @@ struct SsspState {
    bool is_light_phase_;
    bool with_settled_;
    bool is_presolving_mode_;
+   const float* const* node_dists_; // distances of co-located ranks (by target), or NULL
 
    static inline
    bool target_is_settled(const BitmapType* vertices_is_settled, int64_t tgt, int r_bits, int lgl, int64_t L) {
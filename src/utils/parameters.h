@@ -14,10 +14,26 @@
 #define USE_PROPER_HASHMAP 0
 #define BELLMAN_FORD_SWITCH_RATIO 0.98
 #define NODE_SEND_COUNT_TYPE 0 // 0 is simple and fast locally, 1 possibly sends less
-#define USE_PTR_LOCKS_OMP
+#define NQ_EXPAND_COMPRESSION 1 // 0: off, 1: compress NQ list expansion (vertices and distances) if promising
+#define SETTLED_EXPAND_COMPRESSION 1 // 0: off, 1: newly settled vertices can be expanded as coded list
+#define NODE_SHARED_DIST 1 // 0: off, 1: distances in node-shared memory, relaxations to co-located ranks are filtered before the fold
+#define HUB_DELEGATION_VERTICES 16 // 0: off, else number of top-degree vertices per rank with replicated distances in the processor column
+#define SELF_FOLD_FAST_PATH 1 // 0: off, 1: relaxations of own vertices are applied by the sending thread instead of being folded
+#define BUCKET_FUSION 1 // 0: off, 1: light relaxations among own vertices are repeated locally until the bucket is stable
+#define SHORT_EDGE_PRUNING 1 // 0: off, 1: bucket vertices whose edges are all outer-short (light phase) or inner-short (heavy phase) are not expanded
+#define COMPONENT_PREPASS 1 // 0: off, 1: the giant component is found once by a BFS, runs of its roots only scan and reset its vertices (heuristic: one BFS from the source with the longest row labels only its component, which is the giant one in Kronecker graphs; a warning is printed if it holds less than half of the vertices)
+#define ROOTS_IN_GIANT_COMPONENT 0 // 0: off, 1: roots outside the giant component are rejected (not conforming to the specification)
+#define PRED_RECONSTRUCTION 0 // 0: off, 1: only distances are relaxed, predecessors are chosen among the tight neighbors afterwards (skipped after set_distance_only)
+#define SHARED_MEMORY_ENGINE 1 // 0: off, 1: a single rank (size_2d == 1) runs a shared-memory delta-stepping on the graph instead of the MPI phases
+#ifndef PERSISTENT_REGION
+#define PERSISTENT_REGION 0 // 0: off, 1: the epochs of a run are executed in one persistent parallel region: the master thread makes the MPI calls and hands the parallel stages to the other threads, which wait in a hierarchical spin barrier
+#endif
+#define HYPERSPARSE_ROWS 1 // 0: off, 1: rows are indexed by sorted offsets per block of sources instead of a bitmap if less than 1/64 of them are non-empty, 2: always
 
 // for the systems that contains NUMA nodes
 #define NUMA_BIND 0
+#define HUGE_PAGES 1 // 0: off, 1: large random-access arrays are 2 MB aligned and advised as transparent huge pages, 2: they are mapped with MAP_HUGETLB (1 if none are reserved)
+#define NUMA_PLACEMENT 1 // 0: off, 1: edge and vertex arrays are placed by first touch in the static OpenMP schedule of the loops that scan them (the edges as the bitmap top-down splits the rows; the list top-down splits the queue by its edges in each phase, which no placement matches), 2: the edges are moved with mbind after the construction as well
 #define SHARED_MEMORY 0
 
 #define CPU_BIND_CHECK 0
@@ -43,15 +59,24 @@
 #define REPORT_GEN_RPGRESS 0
 
 #define VERBOSE_MEM_MODE 0
+#define MEMORY_ACCOUNTING 1 // 0: off, 1: allocations of 64 KB or more are counted by subsystem and a table is printed after each stage
 
 #define SKIP_FILTERING 1
 
 // General Optimizations
-// 0: completely off, 1: only reduce isolated vertices, 2: sort by degree and reduce isolated vertices
+// 0: completely off, 1: only reduce isolated vertices, 2: sort by degree and reduce isolated vertices,
+// 3: reverse Cuthill-McKee order over the neighbors, 4: label propagation over the neighbors
+// (3 and 4 keep the hub vertices first and reduce isolated vertices)
 #ifndef VERTEX_REORDERING
 #define VERTEX_REORDERING 0
 #endif
 
+// hub vertices are the first local vertices, so they need the degree order
+#if VERTEX_REORDERING < 2
+#undef HUB_DELEGATION_VERTICES
+#define HUB_DELEGATION_VERTICES 0
+#endif
+
 #define TOP_DOWN_SEND_LB 2  //  0 is standard, 1 is pointer-wise top town send, 2 is both
 #define TOP_DOWN_RECV_LB 1
 #define BOTTOM_UP_OVERLAP_PFS 1
@@ -205,6 +230,7 @@ enum {
 	BOTTOM_UP_PRED_TAG = 2,
 	MY_EXPAND_TAG1 = 3,
 	MY_EXPAND_TAG2 = 4,
+	FOLD_PROGRESS_TAG = 5, // and 6, alternating between consecutive exchanges
 };
 
 #ifdef __cplusplus
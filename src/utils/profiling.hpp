@@ -211,6 +211,18 @@ volatile double expand_time;
 volatile double expand_buckets_time;
 volatile double expand_settled_bitmap_time;
 volatile double fold_time;
+volatile int64_t expand_list_raw_bytes;
+volatile int64_t expand_list_sent_bytes;
+volatile int64_t node_shared_filtered;
+volatile int64_t hub_delegated;
+volatile int64_t fold_self_relaxed;
+volatile int64_t fold_sent_relaxed;
+volatile int64_t bucket_fusion_relaxed;
+volatile int64_t bucket_fusion_added;
+volatile int64_t pruned_edges[3]; // by light, heavy and Bellman-Ford phases
+volatile int64_t pruned_vertices[2]; // by light and heavy phases
+volatile double pred_reconstruction_time;
+volatile int64_t pred_reconstruction_rounds;
 
 } // namespace profiling
 
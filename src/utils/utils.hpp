@@ -32,10 +32,16 @@
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/shm.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
 
 #include <algorithm>
 #include <vector>
 #include <deque>
+#include <unordered_map>
+#include <type_traits>
 
 #include "mpi_workarounds.h"
 #include "utils_core.hpp"
@@ -157,6 +163,8 @@ struct MPI_GLOBALS {
 	MPI_Comm comm_2dr; // = comm_x
 	MPI_Comm comm_2dc;
 	bool isRowMajor;
+	double grid_fold_time; // predicted by the grid planner per run, in seconds; negative if not planned
+	double grid_expand_time;
 
 	// multi dimension
 	COMM_2D comm_r;
@@ -307,22 +315,186 @@ void print_with_prefix(const char* format, ...) {
 // Memory Allocation
 //-------------------------------------------------------------//
 
+namespace memory {
+
+const char* const tag_names[NUM_TAGS] = {
+	"other", "edge list", "graph", "dist/pred", "comm buffers", "NQ/CQ", "dedup scratch", "locks", "validation"
+};
+
+__thread Tag g_scope_tag = TAG_OTHER;
+
+// allocations of the thread that opened the scope that do not name a tag are counted for the tag
+// of its innermost scope (the threads of a parallel region count theirs as "other" unless tagged)
+class TagScope {
+public:
+	explicit TagScope(Tag tag) : prev_tag_(g_scope_tag) { g_scope_tag = tag; }
+	~TagScope() { g_scope_tag = prev_tag_; }
+private:
+	const Tag prev_tag_;
+};
+
+enum {
+	HUGE_PAGE_SIZE = 2*1024*1024,
+	HUGE_PAGE_MIN_ALLOC = 2*HUGE_PAGE_SIZE, // smaller arrays are not worth the rounding
+	TRACKED_MIN_ALLOC = 64*1024, // smaller allocations are not tracked by the memory accounting (the peak RSS covers them)
+};
+
+#if MEMORY_ACCOUNTING || HUGE_PAGES == 2
+// the large allocations, so that xfree finds their tag and unmaps the arrays mapped with MAP_HUGETLB;
+// only xfree of a large block takes the lock
+struct Allocation {
+	size_t bytes;
+	Tag tag;
+	bool is_huge; // aligned to and advised for huge pages, or mapped from them
+	bool is_mapped; // mapped with MAP_HUGETLB, to be unmapped
+};
+
+std::unordered_map<void*, Allocation> g_allocations;
+pthread_mutex_t g_allocations_sync = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#if MEMORY_ACCOUNTING
+int64_t g_usage[NUM_TAGS + 1]; // last: total
+int64_t g_peak_usage[NUM_TAGS + 1]; // since the last usage table
+int64_t g_huge_usage[NUM_TAGS + 1];
+
+void update_peak(int64_t* peak, int64_t usage) {
+	int64_t cur_peak = *peak;
+	while(usage > cur_peak && !__sync_bool_compare_and_swap(peak, cur_peak, usage))
+		cur_peak = *peak;
+}
+
+void update_usage(Tag tag, int64_t bytes, int64_t huge_bytes) {
+	const int64_t usage = __sync_add_and_fetch(&g_usage[tag], bytes);
+	const int64_t total_usage = __sync_add_and_fetch(&g_usage[NUM_TAGS], bytes);
+	if(huge_bytes != 0) {
+		__sync_fetch_and_add(&g_huge_usage[tag], huge_bytes);
+		__sync_fetch_and_add(&g_huge_usage[NUM_TAGS], huge_bytes);
+	}
+	update_peak(&g_peak_usage[tag], usage);
+	update_peak(&g_peak_usage[NUM_TAGS], total_usage);
+}
+
+// for memory that is not allocated here (e.g., std::vector)
+void add_usage(Tag tag, int64_t bytes) {
+	update_usage(tag, bytes, 0);
+}
+#endif // #if MEMORY_ACCOUNTING
+
+#if MEMORY_ACCOUNTING || HUGE_PAGES == 2
+void register_allocation(void* p, size_t bytes, Tag tag, bool is_huge, bool is_mapped) {
+	if(bytes < TRACKED_MIN_ALLOC && !is_mapped)
+		return;
+	const Allocation allocation = { bytes, tag, is_huge, is_mapped };
+	pthread_mutex_lock(&g_allocations_sync);
+	g_allocations[p] = allocation;
+	pthread_mutex_unlock(&g_allocations_sync);
+#if MEMORY_ACCOUNTING
+	update_usage(tag, bytes, is_huge ? bytes : 0);
+#endif
+}
+
+// false if p was not registered; only looks up (and locks) for huge page aligned or large blocks
+bool unregister_allocation(void* p, Allocation& allocation) {
+	if(p == NULL)
+		return false;
+	const bool is_huge_aligned = ((uintptr_t(p) & (HUGE_PAGE_SIZE - 1)) == 0);
+#if MEMORY_ACCOUNTING
+	// a mapped array is huge page aligned, so malloc_usable_size only sees blocks from malloc
+	if(!is_huge_aligned && malloc_usable_size(p) < TRACKED_MIN_ALLOC)
+		return false;
+#else
+	if(!is_huge_aligned)
+		return false;
+#endif
+	pthread_mutex_lock(&g_allocations_sync);
+	std::unordered_map<void*, Allocation>::iterator it = g_allocations.find(p);
+	const bool is_found = (it != g_allocations.end());
+	if(is_found) {
+		allocation = it->second;
+		g_allocations.erase(it);
+	}
+	pthread_mutex_unlock(&g_allocations_sync);
+#if MEMORY_ACCOUNTING
+	if(is_found)
+		update_usage(allocation.tag, -int64_t(allocation.bytes), allocation.is_huge ? -int64_t(allocation.bytes) : 0);
+#endif
+	return is_found;
+}
+#endif // #if MEMORY_ACCOUNTING || HUGE_PAGES == 2
+
+#if MEMORY_ACCOUNTING
+// value of a "<key>: <value> kB" line of a /proc file in bytes, 0 if there is none
+int64_t read_proc_kb(const char* path, const char* key) {
+	FILE* fp = fopen(path, "r");
+	if(fp == NULL) return 0;
+	char line[256];
+	int64_t value = 0;
+	const size_t key_length = strlen(key);
+	while(fgets(line, sizeof(line), fp) != NULL) {
+		if(strncmp(line, key, key_length) == 0 && line[key_length] == ':') {
+			value = atol(line + key_length + 1) * 1024;
+			break;
+		}
+	}
+	fclose(fp);
+	return value;
+}
+
+// prints the memory of the subsystems after a stage (maximum over the ranks) and starts a new stage. Collective.
+void print_usage_table(const char* stage) {
+	enum { NUM_ROWS = NUM_TAGS + 1, NUM_STATS = 3 * NUM_ROWS + 2 };
+	int64_t send_stats[NUM_STATS];
+	for(int i = 0; i < NUM_ROWS; ++i) {
+		send_stats[3 * i] = g_usage[i];
+		send_stats[3 * i + 1] = g_peak_usage[i];
+		send_stats[3 * i + 2] = g_huge_usage[i];
+		g_peak_usage[i] = g_usage[i];
+	}
+	send_stats[3 * NUM_ROWS] = read_proc_kb("/proc/self/status", "VmHWM");
+	send_stats[3 * NUM_ROWS + 1] = read_proc_kb("/proc/self/smaps_rollup", "AnonHugePages");
+	int64_t max_stats[NUM_STATS];
+	MPI_Reduce(send_stats, max_stats, NUM_STATS, MpiTypeOf<int64_t>::type, MPI_MAX, 0, mpi.comm_2d);
+	if(mpi.isMaster()) {
+		const double MB = 1024.0 * 1024.0;
+		print_with_prefix("Memory after %s (MB, maximum over the ranks):", stage);
+		print_with_prefix("  %-14s %10s %10s %10s", "subsystem", "current", "peak", "huge pages");
+		for(int i = 0; i < NUM_ROWS; ++i) {
+			if(i < NUM_TAGS && max_stats[3 * i + 1] == 0) continue;
+			print_with_prefix("  %-14s %10.1f %10.1f %10.1f", (i < NUM_TAGS) ? tag_names[i] : "total",
+					max_stats[3 * i] / MB, max_stats[3 * i + 1] / MB, max_stats[3 * i + 2] / MB);
+		}
+		print_with_prefix("  peak RSS %.1f MB, anonymous huge pages %.1f MB",
+				max_stats[3 * NUM_ROWS] / MB, max_stats[3 * NUM_ROWS + 1] / MB);
+	}
+}
+#else
+void add_usage(Tag tag, int64_t bytes) { }
+void print_usage_table(const char* stage) { }
+#endif // #if MEMORY_ACCOUNTING
+
+} // namespace memory
+
 ////
 int64_t g_memory_usage = 0;
-void x_allocate_check(void* ptr) {
-	size_t nbytes = malloc_usable_size(ptr);
+void x_allocate_check(void* ptr, size_t nbytes) {
 	g_memory_usage += nbytes;
 	if(mpi.isMaster() && nbytes > 1024*1024) {
 		fprintf(IMD_OUT, "[MEM] %f MB (+ %f MB)\n", (double)g_memory_usage / (1024*1024), (double)nbytes / (1024*1024));
 	}
 }
-void x_free_check(void* ptr) {
-	size_t nbytes = malloc_usable_size(ptr);
+void x_allocate_check(void* ptr) {
+	x_allocate_check(ptr, malloc_usable_size(ptr));
+}
+void x_free_check(void* ptr, size_t nbytes) {
 	g_memory_usage -= nbytes;
 	if(mpi.isMaster() && nbytes > 1024*1024) {
 		fprintf(IMD_OUT, "[MEM] %f MB (- %f MB)\n", (double)g_memory_usage / (1024*1024), (double)nbytes / (1024*1024));
 	}
 }
+void x_free_check(void* ptr) {
+	x_free_check(ptr, malloc_usable_size(ptr));
+}
 void print_max_memory_usage() {
 	int64_t g_max = 0;
 	MPI_Reduce(&g_memory_usage, &g_max, 1, MpiTypeOf<int64_t>::type, MPI_MAX, 0, mpi.comm_2d);
@@ -332,6 +504,12 @@ void print_max_memory_usage() {
 }
 ////
 
+#if MEMORY_ACCOUNTING
+#define MEMORY_ACCOUNT(p, size, tag) memory::register_allocation(p, size, tag, false, false)
+#else
+#define MEMORY_ACCOUNT(p, size, tag)
+#endif
+
 void* xMPI_Alloc_mem(size_t nbytes) {
   void* p = NULL;
   MPI_Alloc_mem(nbytes, MPI_INFO_NULL, &p);
@@ -346,51 +524,97 @@ void* xMPI_Alloc_mem(size_t nbytes) {
   return p;
 }
 
-void* cache_aligned_xcalloc(const size_t size) {
+void* cache_aligned_xcalloc(const size_t size, memory::Tag tag) {
     void* p = NULL;
 	if(posix_memalign(&p, CACHE_LINE, size)){
 		throw_exception("Out of memory trying to allocate %zu (%" PRId64 ") byte(s)", size, (int64_t)size);
 	}
 	VERBOSE_MEM(x_allocate_check(p));
+	MEMORY_ACCOUNT(p, size, tag);
 	memset(p, 0, size);
 	return p;
 }
-void* cache_aligned_xmalloc(const size_t size) {
+void* cache_aligned_xmalloc(const size_t size, memory::Tag tag) {
 	void* p = NULL;
 	if(posix_memalign(&p, CACHE_LINE, size)){
 		throw_exception("Out of memory trying to allocate %zu (%" PRId64 ") byte(s)", size, (int64_t)size);
 	}
 	VERBOSE_MEM(x_allocate_check(p));
+	MEMORY_ACCOUNT(p, size, tag);
 	return p;
 }
 
-void* page_aligned_xcalloc(const size_t size) {
+void* page_aligned_xcalloc(const size_t size, memory::Tag tag) {
 	void* p = NULL;
 	if(posix_memalign(&p, PAGE_SIZE, size)){
 		throw_exception("Out of memory trying to allocate %zu (%" PRId64 ") byte(s)", size, (int64_t)size);
 	}
 	VERBOSE_MEM(x_allocate_check(p));
+	MEMORY_ACCOUNT(p, size, tag);
 	memset(p, 0, size);
 	return p;
 }
-void* page_aligned_xmalloc(const size_t size) {
+void* page_aligned_xmalloc(const size_t size, memory::Tag tag) {
 	void* p = NULL;
 	if(posix_memalign(&p, PAGE_SIZE, size)){
 		throw_exception("Out of memory trying to allocate %zu (%" PRId64 ") byte(s)", size, (int64_t)size);
 	}
 	VERBOSE_MEM(x_allocate_check(p));
+	MEMORY_ACCOUNT(p, size, tag);
 	return p;
 }
 
-#if VERBOSE_MEM_MODE
+// for large arrays with random accesses: backed by 2 MB pages (HUGE_PAGES) to save TLB misses.
+// Falls back to transparent huge pages if no huge pages are reserved, and to cache_aligned_xmalloc for small arrays.
+void* huge_aligned_xmalloc(const size_t size, memory::Tag tag) {
+#if HUGE_PAGES
+	if(size >= memory::HUGE_PAGE_MIN_ALLOC) {
+		const size_t huge_size = (size + memory::HUGE_PAGE_SIZE - 1) & ~size_t(memory::HUGE_PAGE_SIZE - 1);
+#if HUGE_PAGES == 2
+		void* mapped = mmap(NULL, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(mapped != MAP_FAILED) {
+			VERBOSE_MEM(x_allocate_check(mapped, huge_size));
+			memory::register_allocation(mapped, huge_size, tag, true, true);
+			return mapped;
+		}
+#endif
+		void* p = NULL;
+		if(posix_memalign(&p, memory::HUGE_PAGE_SIZE, huge_size)){
+			throw_exception("Out of memory trying to allocate %zu (%" PRId64 ") byte(s)", size, (int64_t)size);
+		}
+		madvise(p, huge_size, MADV_HUGEPAGE); // only a hint, e.g. fails if transparent huge pages are disabled
+		VERBOSE_MEM(x_allocate_check(p));
+#if MEMORY_ACCOUNTING
+		memory::register_allocation(p, huge_size, tag, true, false);
+#endif
+		return p;
+	}
+#endif // #if HUGE_PAGES
+	return cache_aligned_xmalloc(size, tag);
+}
+void* huge_aligned_xcalloc(const size_t size, memory::Tag tag) {
+	void* p = huge_aligned_xmalloc(size, tag);
+	memset(p, 0, size);
+	return p;
+}
+
+#if VERBOSE_MEM_MODE || MEMORY_ACCOUNTING || HUGE_PAGES == 2
 
 void xfree(void* p) {
-	x_free_check(p);
+#if MEMORY_ACCOUNTING || HUGE_PAGES == 2
+	memory::Allocation allocation;
+	if(memory::unregister_allocation(p, allocation) && allocation.is_mapped) {
+		VERBOSE_MEM(x_free_check(p, allocation.bytes));
+		munmap(p, allocation.bytes);
+		return;
+	}
+#endif
+	VERBOSE_MEM(x_free_check(p));
 	free(p);
 }
 #define free(p) xfree(p)
 
-#endif // #if VERBOSE_MODE
+#endif // #if VERBOSE_MEM_MODE || MEMORY_ACCOUNTING || HUGE_PAGES == 2
 
 #if SHARED_MEMORY
 void* shared_malloc(size_t nbytes) {
@@ -1288,12 +1512,285 @@ void set_affinity()
 	next_thread_id = 1;
 }
 
+//-------------------------------------------------------------//
+// NUMA Placement
+//-------------------------------------------------------------//
+
+// iterations [begin, end) of thread tid in a loop with schedule(static) and no chunk size (as split by libgomp)
+template <typename T>
+void get_static_schedule(T size, int num_threads, int tid, T& begin, T& end) {
+	const T chunk = size / num_threads;
+	const T rest = size % num_threads;
+	begin = chunk * tid + std::min<T>(tid, rest);
+	end = begin + chunk + ((tid < rest) ? 1 : 0);
+}
+
+// NUMA node of the CPU the calling thread runs on, -1 if unknown
+int current_node() {
+	unsigned cpu, node;
+	if(syscall(SYS_getcpu, &cpu, &node, NULL) != 0) return -1;
+	return int(node);
+}
+
+// NUMA node of the page of addr, -1 if unknown (faults the page in if it is not yet)
+int page_node(const void* addr) {
+	int node = -1;
+	if(syscall(SYS_get_mempolicy, &node, NULL, 0, addr, MPOL_F_NODE | MPOL_F_ADDR) != 0) return -1;
+	return node;
+}
+
+/**
+ * An array that is scanned by a loop with schedule(static) over num_items items,
+ * item i covering the elements [offset(i), offset(i + 1)) (e.g. the edges of a block of rows).
+ * Each thread's elements are placed on its node, either by touching them first when the
+ * array is allocated or, with NUMA_PLACEMENT == 2, by moving the pages with mbind later.
+ * Loops that split the items differently (e.g. weighted by the work of each item) only
+ * partly match the placement.
+ */
+template <typename T, typename Offset>
+class StaticPlacement {
+public:
+	StaticPlacement(int64_t num_items, Offset offset)
+		: num_items_(num_items)
+		, offset_(offset)
+	{ }
+
+	// elements [begin, end) of thread tid of num_threads
+	void get_range(int num_threads, int tid, int64_t& begin, int64_t& end) const {
+		int64_t item_begin, item_end;
+		get_static_schedule<int64_t>(num_items_, num_threads, tid, item_begin, item_end);
+		begin = offset_(item_begin);
+		end = offset_(item_end);
+	}
+
+	int64_t length() const { return offset_(num_items_); }
+
+	// zeroes a new array in the threads that will use its elements
+	void first_touch(T* array) const {
+#pragma omp parallel
+		{
+			int64_t begin, end;
+			get_range(omp_get_num_threads(), omp_get_thread_num(), begin, end);
+			memset(array + begin, 0, (end - begin) * sizeof(T));
+		}
+	}
+
+#if NUMA_PLACEMENT == 2
+	// moves the pages of the (initialized) array in place; returns whether it succeeded for all threads
+	bool move_pages(T* array) const {
+		int num_failed = 0;
+#pragma omp parallel reduction(+: num_failed)
+		{
+			int64_t begin, end;
+			get_range(omp_get_num_threads(), omp_get_thread_num(), begin, end);
+			// whole pages only, the pages at the borders stay where they are
+			const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+			const uintptr_t page_begin = roundup<uintptr_t>(uintptr_t(array + begin), page_size);
+			const uintptr_t page_end = uintptr_t(array + end) & ~(page_size - 1);
+			const int node = current_node();
+			if(page_begin < page_end && node >= 0) {
+				unsigned long node_mask[16] = {0};
+				node_mask[node / 64] = 1UL << (node % 64);
+				if(syscall(SYS_mbind, page_begin, page_end - page_begin, MPOL_PREFERRED,
+						node_mask, sizeof(node_mask) * 8, MPOL_MF_MOVE) != 0)
+					++num_failed;
+			}
+		}
+		return num_failed == 0;
+	}
+#endif
+
+	// counts the pages (up to max_samples per thread, evenly spread) of the threads' elements
+	// that are on the node of the thread
+	void count_local_pages(const T* array, int64_t& num_local, int64_t& num_sampled, int max_samples = 256) const {
+		int64_t local = 0, sampled = 0;
+#pragma omp parallel reduction(+: local, sampled)
+		{
+			int64_t begin, end;
+			get_range(omp_get_num_threads(), omp_get_thread_num(), begin, end);
+			const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+			const uintptr_t page_begin = uintptr_t(array + begin) & ~(page_size - 1);
+			const uintptr_t page_end = uintptr_t(array + end);
+			const int node = current_node();
+			if(page_begin < page_end && node >= 0) {
+				const int64_t num_pages = (page_end - page_begin + page_size - 1) / page_size;
+				const int64_t stride = std::max<int64_t>(1, num_pages / max_samples);
+				for(int64_t i = 0; i < num_pages; i += stride) {
+					const int page = page_node((const void*)(page_begin + i * page_size));
+					if(page < 0) continue;
+					++sampled;
+					if(page == node) ++local;
+				}
+			}
+		}
+		num_local += local;
+		num_sampled += sampled;
+	}
+
+private:
+	const int64_t num_items_;
+	const Offset offset_;
+};
+
+template <typename T, typename Offset>
+StaticPlacement<T, Offset> make_static_placement(int64_t num_items, Offset offset) {
+	return StaticPlacement<T, Offset>(num_items, offset);
+}
+
+// placement of a plain array that is scanned by "for(i = 0; i < length; ++i)" with schedule(static)
+struct IdentityOffset {
+	int64_t operator()(int64_t i) const { return i; }
+};
+
+template <typename T>
+StaticPlacement<T, IdentityOffset> make_static_placement(int64_t length) {
+	return StaticPlacement<T, IdentityOffset>(length, IdentityOffset());
+}
+
+// number of different nodes the threads of this process run on
+int count_thread_nodes() {
+	std::vector<int> nodes(omp_get_max_threads(), -1);
+#pragma omp parallel
+	nodes[omp_get_thread_num()] = current_node();
+	std::sort(nodes.begin(), nodes.end());
+	return std::unique(nodes.begin(), nodes.end()) - nodes.begin();
+}
+
 } // namespace numa
 
 //-------------------------------------------------------------//
 // ?
 //-------------------------------------------------------------//
 
+// node of this process: MPI_NUM_NODE (and MPI_ROUND_ROBIN) as in set_affinity if set,
+// otherwise the smallest rank in MPI_COMM_WORLD that shares memory with this process. Collective.
+static int get_node_id() {
+	const char* num_node_str = getenv("MPI_NUM_NODE");
+	if(num_node_str != NULL) {
+		const int num_node = atoi(num_node_str);
+		const int max_procs_per_node = (mpi.size + num_node - 1) / num_node;
+		return getenv("MPI_ROUND_ROBIN") ? (mpi.rank % num_node) : (mpi.rank / max_procs_per_node);
+	}
+	MPI_Comm shared_comm;
+	int node_id = mpi.rank;
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, mpi.rank, MPI_INFO_NULL, &shared_comm);
+	MPI_Allreduce(MPI_IN_PLACE, &node_id, 1, MPI_INT, MPI_MIN, shared_comm);
+	MPI_Comm_free(&shared_comm);
+	return node_id;
+}
+
+// cost model of the grid planner, per SSSP run
+namespace grid_planner {
+const double FOLD_BYTES_PER_EDGE = 8.0; // target and distance
+const double EXPAND_BYTES_PER_VERTEX = 8.0; // vertex and distance
+const double INTRA_NODE_BANDWIDTH = 20.0e9;
+const double INTER_NODE_LATENCY = 2.0e-6; // seconds per message
+const double INTRA_NODE_LATENCY = 0.5e-6;
+
+// the parameters that depend most on the machine and the problem, overwritten by
+// GRID_INTER_NODE_BANDWIDTH, GRID_PHASES_PER_RUN and GRID_MAX_ASPECT_RATIO
+struct Model {
+	double inter_node_bandwidth; // bytes per second
+	double phases_per_run;
+	double max_aspect_ratio; // limits the memory of the row and column bitmaps
+
+	// the values of rank 0 are used, so that all ranks consider the same candidates. Collective.
+	Model() : inter_node_bandwidth(5.0e9), phases_per_run(200.0), max_aspect_ratio(4.0) {
+		double values[3] = { inter_node_bandwidth, phases_per_run, max_aspect_ratio };
+		const char* names[3] = { "GRID_INTER_NODE_BANDWIDTH", "GRID_PHASES_PER_RUN", "GRID_MAX_ASPECT_RATIO" };
+		for(int i = 0; i < 3; ++i) {
+			const char* str = getenv(names[i]);
+			if(str != NULL && atof(str) > 0.0) values[i] = atof(str);
+		}
+		MPI_Bcast(values, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+		inter_node_bandwidth = values[0];
+		phases_per_run = values[1];
+		max_aspect_ratio = values[2];
+	}
+
+	// predicted time of one collective over a group of peers, of which same_node are on the same node
+	double predict(double bytes_per_peer, int num_peers, int same_node) const {
+		const int inter = num_peers - same_node;
+		return bytes_per_peer * (inter / inter_node_bandwidth + same_node / INTRA_NODE_BANDWIDTH)
+				+ phases_per_run * (inter * INTER_NODE_LATENCY + same_node * INTRA_NODE_LATENCY);
+	}
+};
+
+struct Plan {
+	int size_2dr; // fold over comm_2dc of this size
+	int size_2dc; // expand over comm_2dr of this size
+	bool consecutive_fold; // ranks of comm_2dc are consecutive, otherwise the ranks of comm_2dr
+	double fold_time; // predicted, in seconds
+	double expand_time;
+};
+
+// chooses R x C and the placement with the minimal predicted fold plus expand time,
+// the fold sends the (directed) edges of the rank to the R ranks of its column,
+// the expand sends the vertices of the rank to the C ranks of its row.
+// Every rank predicts its own times from its node, the slowest rank gives the time of a candidate. Collective.
+static Plan plan(const std::vector<int>& node_ids, int SCALE, int edgefactor) {
+	const Model model;
+	const int P = int(node_ids.size());
+	const int me = mpi.rank;
+	const double local_verts = double(int64_t(1) << SCALE) / P;
+	// the least skewed grid is always a candidate, e.g. 1 x P for a prime P
+	double max_aspect_ratio = double(P);
+	for(int R = 1; R <= P; ++R) {
+		if(P % R != 0) continue;
+		max_aspect_ratio = std::min(max_aspect_ratio, double(std::max(R, P / R)) / std::min(R, P / R));
+	}
+	max_aspect_ratio = std::max(max_aspect_ratio, model.max_aspect_ratio);
+
+	std::vector<Plan> candidates;
+	std::vector<double> times; // fold, expand and sum of each candidate on this rank
+	for(int R = 1; R <= P; ++R) {
+		if(P % R != 0) continue;
+		const int C = P / R;
+		if(R > C * max_aspect_ratio || C > R * max_aspect_ratio) continue;
+		for(int consecutive_fold = 1; consecutive_fold >= 0; --consecutive_fold) {
+			const int consecutive = consecutive_fold ? R : C; // groups of consecutive ranks
+			const int first = me - me % consecutive;
+			int same_node_consecutive = 0, same_node_strided = 0;
+			for(int i = first; i < first + consecutive; ++i)
+				same_node_consecutive += (i != me && node_ids[i] == node_ids[me]);
+			for(int i = me % consecutive; i < P; i += consecutive)
+				same_node_strided += (i != me && node_ids[i] == node_ids[me]);
+			const int same_node_fold = consecutive_fold ? same_node_consecutive : same_node_strided;
+			const int same_node_expand = consecutive_fold ? same_node_strided : same_node_consecutive;
+
+			Plan p;
+			p.size_2dr = R;
+			p.size_2dc = C;
+			p.consecutive_fold = consecutive_fold;
+			p.fold_time = model.predict(FOLD_BYTES_PER_EDGE * 2.0 * edgefactor * local_verts / R, R - 1, same_node_fold);
+			p.expand_time = model.predict(EXPAND_BYTES_PER_VERTEX * local_verts, C - 1, same_node_expand);
+			candidates.push_back(p);
+			times.push_back(p.fold_time);
+			times.push_back(p.expand_time);
+			times.push_back(p.fold_time + p.expand_time);
+		}
+	}
+	MPI_Allreduce(MPI_IN_PLACE, times.data(), int(times.size()), MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+	Plan best = { 0, 0, true, 0.0, 0.0 };
+	double best_time = 0.0;
+	for(size_t i = 0; i < candidates.size(); ++i) {
+		Plan& p = candidates[i];
+		p.fold_time = times[3*i];
+		p.expand_time = times[3*i + 1];
+		if(mpi.isMaster()) print_with_prefix("Grid candidate %dx%d (%s consecutive): predicted fold %f ms, expand %f ms (slowest rank %f ms)",
+				p.size_2dr, p.size_2dc, p.consecutive_fold ? "columns" : "rows",
+				p.fold_time * 1000.0, p.expand_time * 1000.0, times[3*i + 2] * 1000.0);
+		if(best.size_2dr == 0 || times[3*i + 2] < best_time) {
+			best = p;
+			best_time = times[3*i + 2];
+		}
+	}
+	assert(best.size_2dr * best.size_2dc == P);
+	return best;
+}
+} // namespace grid_planner
+
 /**
  * compute rank that is assigned continuously in the field
  * the last dimension size should be even.
@@ -1377,10 +1874,12 @@ static void print_dims(const char* prefix, std::vector<int>& dims) {
 }
 #endif
 
-static void setup_2dcomm()
+static void setup_2dcomm(int SCALE, int edgefactor)
 {
 	bool success = false;
 	mpi.isMultiDimAvailable = false;
+	bool invert_rc = (getenv("INVERT_RC") != NULL);
+	mpi.grid_fold_time = mpi.grid_expand_time = -1.0;
 
 #if ENABLE_FJMPI
 	const char* tofu_6d = getenv("TOFU_6D");
@@ -1478,7 +1977,22 @@ static void setup_2dcomm()
 	if(!success) {
 		int twod_r = 1, twod_c = 1;
 		const char* twod_r_str = getenv("TWOD_R");
-		if(twod_r_str){
+		if(!twod_r_str && getenv("GRID_PLANNER")) {
+			std::vector<int> node_ids(mpi.size);
+			const int node_id = get_node_id();
+			MPI_Allgather(&node_id, 1, MPI_INT, node_ids.data(), 1, MPI_INT, MPI_COMM_WORLD);
+			grid_planner::Plan plan = grid_planner::plan(node_ids, SCALE, edgefactor);
+			// the consecutive ranks form comm_2dc, so for consecutive rows the grid is inverted below
+			twod_r = plan.consecutive_fold ? plan.size_2dr : plan.size_2dc;
+			twod_c = mpi.size / twod_r;
+			assert(twod_r * twod_c == mpi.size);
+			invert_rc = !plan.consecutive_fold;
+			mpi.grid_fold_time = plan.fold_time;
+			mpi.grid_expand_time = plan.expand_time;
+			if(mpi.isMaster()) print_with_prefix("Grid planner: %dx%d with consecutive %s",
+					plan.size_2dr, plan.size_2dc, plan.consecutive_fold ? "columns" : "rows");
+		}
+		else if(twod_r_str){
 			twod_r = atoi((char*)twod_r_str);
 			twod_c = mpi.size / twod_r;
 			if(twod_r == 0 || (twod_c * twod_r) != mpi.size) {
@@ -1508,7 +2022,7 @@ static void setup_2dcomm()
 	if(mpi.isMaster()) print_with_prefix("Dimension: (%dx%d)", mpi.size_2dr, mpi.size_2dc);
 
 	mpi.isRowMajor = false;
-	if(getenv("INVERT_RC")) {
+	if(invert_rc) {
 		mpi.isRowMajor = true;
 		std::swap(mpi.size_2dr, mpi.size_2dc);
 		std::swap(mpi.rank_2dr, mpi.rank_2dc);
@@ -1594,6 +2108,10 @@ void setup_globals(int argc, char** argv, int SCALE, int edgefactor)
 #else
 	int reqeust_level = MPI_THREAD_SINGLE;
 #endif
+	// the fold progress thread calls MPI while the other threads compute
+	const char* progress_char = getenv("FOLD_PROGRESS_THREAD");
+	if(progress_char != NULL && atoi(progress_char) != 0)
+		reqeust_level = MPI_THREAD_SERIALIZED;
 	MPI_Init_thread(&argc, &argv, reqeust_level, &mpi.thread_level);
 	MPI_Comm_rank(MPI_COMM_WORLD, &mpi.rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &mpi.size);
@@ -1650,7 +2168,7 @@ void setup_globals(int argc, char** argv, int SCALE, int edgefactor)
 		setup_2dcomm_on_3d();
 	}
 	else {
-		setup_2dcomm();
+		setup_2dcomm(SCALE, edgefactor);
 	}
 
 	// Initialize comm_[yz]
@@ -2087,8 +2605,12 @@ public:
 		, send_offsets_(NULL)
 		, recv_counts_(NULL)
 		, recv_offsets_(NULL)
+		, num_rma_windows_(0)
+		, rma_displs_(NULL)
+		, node_aware_(false)
 	{
 		MPI_Comm_size(comm_, &comm_size_);
+		reset_node_aware_stats();
 
 		buffer_width_ = std::max<int>(CACHE_LINE/sizeof(int), comm_size_);
 		thread_counts_ = static_cast<int*>(cache_aligned_xmalloc(buffer_width_ * (max_threads_*2 + 1) * sizeof(int)));
@@ -2102,8 +2624,15 @@ public:
 
 	~ScatterContext()
 	{
+		// the windows have to be released with free_rma_windows() before the exposed memory is freed
+		assert (num_rma_windows_ == 0);
+		if(node_aware_) {
+			MPI_Comm_free(&node_comm_);
+			MPI_Comm_free(&inter_comm_);
+		}
 		::free(thread_counts_);
 		::free(send_counts_);
+		::free(rma_displs_);
 	}
 
 	int* get_counts() {
@@ -2118,9 +2647,14 @@ public:
 	int* get_offsets() { return &thread_offsets_[buffer_width_*omp_get_thread_num()]; }
 
 	void sum() {
+#pragma omp parallel if(comm_size_ > 1000)
+		sum_in_team();
+	}
+	//! sum() by all threads of the enclosing parallel region, ends with a barrier
+	void sum_in_team() {
 		const int width = buffer_width_;
 		// compute sum of thread local count values
-#pragma omp parallel for if(comm_size_ > 1000)
+#pragma omp for schedule(static)
 		for(int r = 0; r < comm_size_; ++r) {
 			int sum = 0;
 			for(int t = 0; t < max_threads_; ++t) {
@@ -2129,13 +2663,16 @@ public:
 			send_counts_[r] = sum;
 		}
 		// compute offsets
-		send_offsets_[0] = 0;
-		for(int r = 0; r < comm_size_; ++r) {
-			send_offsets_[r + 1] = send_offsets_[r] + send_counts_[r];
+#pragma omp single
+		{
+			send_offsets_[0] = 0;
+			for(int r = 0; r < comm_size_; ++r) {
+				send_offsets_[r + 1] = send_offsets_[r] + send_counts_[r];
+			}
 		}
 		// assert (send_counts[size] == bufsize*2);
 		// compute offset of each threads
-#pragma omp parallel for if(comm_size_ > 1000)
+#pragma omp for schedule(static)
 		for(int r = 0; r < comm_size_; ++r) {
 			thread_offsets_[0*width + r] = send_offsets_[r];
 			for(int t = 0; t < max_threads_; ++t) {
@@ -2196,7 +2733,254 @@ public:
 				recvbuf, recv_counts_, recv_offsets_, type, comm_);
 	}
 
+	// Exposes buf (bytes long) for alltoallv_rma(). Collective; all ranks have to register their
+	// receive buffers in the same order. Call free_rma_windows() before buf is freed.
+	void register_rma_window(void* buf, int64_t bytes)
+	{
+		if(num_rma_windows_ == MAX_RMA_WINDOWS) {
+			print_with_prefix("Error: too many RMA windows.");
+			MPI_Abort(comm_, 1);
+		}
+		if(rma_displs_ == NULL) {
+			rma_displs_ = static_cast<int*>(cache_aligned_xmalloc(comm_size_ * sizeof(int)));
+		}
+		MPI_Win_create(buf, bytes, 1, MPI_INFO_NULL, comm_, &rma_wins_[num_rma_windows_]);
+		rma_bases_[num_rma_windows_] = buf;
+		rma_sizes_[num_rma_windows_] = bytes;
+		++num_rma_windows_;
+	}
+
+	// Collective.
+	void free_rma_windows()
+	{
+		for(int i = 0; i < num_rma_windows_; ++i) {
+			MPI_Win_free(&rma_wins_[i]);
+		}
+		num_rma_windows_ = 0;
+	}
+
+	// Same result as alltoallv, but the data is written with one-sided puts into recvbuf,
+	// which has to be a buffer registered with register_rma_window() on all ranks.
+	void alltoallv_rma(void* sendbuf, void* recvbuf, MPI_Datatype type, int recvbufsize)
+	{
+		int type_size;
+		MPI_Type_size(type, &type_size);
+
+		int w = 0;
+		while(w < num_rma_windows_ && rma_bases_[w] != recvbuf) ++w;
+		if(w == num_rma_windows_ || rma_sizes_[w] < int64_t(recvbufsize) * type_size) {
+			print_with_prefix("Error: receive buffer of the RMA exchange is not registered.");
+			MPI_Abort(comm_, 1);
+		}
+
+		// the exclusive prefix sum over the sources is where this rank's data starts on each target;
+		// it runs together with the counts exchange the receive side needs anyway
+		MPI_Request req[2];
+		MPI_Iexscan(send_counts_, rma_displs_, comm_size_, MPI_INT, MPI_SUM, comm_, &req[0]);
+		MPI_Ialltoall(send_counts_, 1, MPI_INT, recv_counts_, 1, MPI_INT, comm_, &req[1]);
+		MPI_Waitall(2, req, MPI_STATUSES_IGNORE);
+
+		int comm_rank;
+		MPI_Comm_rank(comm_, &comm_rank);
+		if(comm_rank == 0) {
+			// undefined on the first rank
+			memset(rma_displs_, 0x00, comm_size_ * sizeof(int));
+		}
+		// calculate offsets
+		recv_offsets_[0] = 0;
+		for(int r = 0; r < comm_size_; ++r) {
+			recv_offsets_[r + 1] = recv_offsets_[r] + recv_counts_[r];
+		}
+		if(recv_offsets_[comm_size_] > recvbufsize) {
+		   std::cout << "buffer alltoallv issue: " <<  recv_offsets_[comm_size_] << " > " << recvbufsize << '\n';
+			fprintf(IMD_OUT, "Error: recv_offsets_[comm_size_] > recvbufsize");
+			throw "Error: buffer size not enough";
+		}
+
+		MPI_Win win = rma_wins_[w];
+		MPI_Win_fence(MPI_MODE_NOPRECEDE, win);
+		for(int i = 0; i < comm_size_; ++i) {
+			// shifted so that not all sources access the same target at once
+			const int r = (i + comm_rank) % comm_size_;
+			if(send_counts_[r] == 0) continue;
+			MPI_Put((uint8_t*)sendbuf + int64_t(send_offsets_[r]) * type_size, send_counts_[r], type,
+					r, MPI_Aint(rma_displs_[r]) * type_size, send_counts_[r], type, win);
+		}
+		MPI_Win_fence(MPI_MODE_NOSTORE | MPI_MODE_NOSUCCEED, win);
+	}
+
+	// Groups the ranks of the communicator by node (MPI_NUM_NODE and MPI_ROUND_ROBIN overwrite the
+	// detected nodes as in set_affinity). Collective. Returns whether node-aware exchange is possible,
+	// i.e., there are several nodes with the same number (> 1) of ranks each.
+	bool setup_node_aware()
+	{
+		int comm_rank;
+		MPI_Comm_rank(comm_, &comm_rank);
+
+		const int node_id = get_node_id();
+
+		MPI_Comm_split(comm_, node_id, comm_rank, &node_comm_);
+		MPI_Comm_rank(node_comm_, &local_rank_);
+		MPI_Comm_size(node_comm_, &local_size_);
+		MPI_Comm_split(comm_, local_rank_, node_id, &inter_comm_);
+		MPI_Comm_rank(inter_comm_, &node_rank_);
+		MPI_Comm_size(inter_comm_, &num_nodes_);
+
+		int local_size_minmax[2] = { -local_size_, local_size_ };
+		MPI_Allreduce(MPI_IN_PLACE, local_size_minmax, 2, MPI_INT, MPI_MAX, comm_);
+		const bool is_regular = (-local_size_minmax[0] == local_size_minmax[1]);
+
+		if(!is_regular || local_size_ == 1 || num_nodes_ == 1) {
+			MPI_Comm_free(&node_comm_);
+			MPI_Comm_free(&inter_comm_);
+			return false;
+		}
+
+		// node and node-local index of each rank
+		std::vector<int> my_pos(2);
+		my_pos[0] = node_rank_;
+		my_pos[1] = local_rank_;
+		std::vector<int> all_pos(2 * comm_size_);
+		MPI_Allgather(my_pos.data(), 2, MPI_INT, all_pos.data(), 2, MPI_INT, comm_);
+		dest_node_.resize(comm_size_);
+		dest_local_.resize(comm_size_);
+		for(int r = 0; r < comm_size_; ++r) {
+			dest_node_[r] = all_pos[2 * r];
+			dest_local_[r] = all_pos[2 * r + 1];
+		}
+		const int width = std::max(local_size_, num_nodes_);
+		na_counts_.resize(4 * (width + 1));
+		node_aware_ = true;
+		return true;
+	}
+
+	// Same result as alltoallv, but in two levels: first, all data of a node for rank r is collected
+	// by the co-located rank that has the same node-local index as r, which then sends it as one
+	// message to r. So each rank sends one message per node instead of one per remote rank.
+	// NOTE: setup_node_aware() has to be successful before
+	void alltoallv_node_aware(void* sendbuf, void* recvbuf, MPI_Datatype type, int recvbufsize)
+	{
+		enum { HEADER = 3 * sizeof(int) }; // source, destination, count
+		assert(node_aware_);
+		int type_size, comm_rank;
+		MPI_Type_size(type, &type_size);
+		MPI_Comm_rank(comm_, &comm_rank);
+		const int width = std::max(local_size_, num_nodes_) + 1;
+		int* const send_bytes = na_counts_.data();
+		int* const send_offsets = send_bytes + width;
+		int* const recv_bytes = send_offsets + width;
+		int* const recv_offsets = recv_bytes + width;
+
+		// 1. send the chunks to the node-local proxy of their destination
+		std::fill(send_bytes, send_bytes + local_size_, 0);
+		for(int r = 0; r < comm_size_; ++r) {
+			if(send_counts_[r] == 0) continue;
+			send_bytes[dest_local_[r]] += HEADER + send_counts_[r] * type_size;
+			if(r != comm_rank) {
+				na_stats_[0] += 1;
+				na_stats_[1] += send_counts_[r] * type_size;
+			}
+		}
+		exchange_node_aware_counts(send_bytes, send_offsets, recv_bytes, recv_offsets, local_size_, node_comm_, 2);
+		na_send_buf_.resize(std::max<size_t>(na_send_buf_.size(), send_offsets[local_size_]));
+		for(int r = 0; r < comm_size_; ++r) {
+			if(send_counts_[r] == 0) continue;
+			uint8_t* const dst = na_send_buf_.data() + send_offsets[dest_local_[r]];
+			const int header[3] = { comm_rank, r, send_counts_[r] };
+			memcpy(dst, header, HEADER);
+			memcpy(dst + HEADER, (uint8_t*)sendbuf + int64_t(send_offsets_[r]) * type_size, send_counts_[r] * type_size);
+			send_offsets[dest_local_[r]] += HEADER + send_counts_[r] * type_size;
+		}
+		for(int p = local_size_; p > 0; --p) send_offsets[p] = send_offsets[p - 1];
+		send_offsets[0] = 0;
+		na_recv_buf_.resize(std::max<size_t>(na_recv_buf_.size(), recv_offsets[local_size_]));
+		MPI_Alltoallv(na_send_buf_.data(), send_bytes, send_offsets, MPI_BYTE,
+				na_recv_buf_.data(), recv_bytes, recv_offsets, MPI_BYTE, node_comm_);
+
+		// 2. the proxy forwards the combined chunks to their destination node
+		const int proxy_length = recv_offsets[local_size_];
+		std::fill(send_bytes, send_bytes + num_nodes_, 0);
+		for(int pos = 0; pos < proxy_length; ) {
+			int header[3];
+			memcpy(header, na_recv_buf_.data() + pos, HEADER);
+			assert(dest_local_[header[1]] == local_rank_);
+			const int chunk_bytes = HEADER + header[2] * type_size;
+			send_bytes[dest_node_[header[1]]] += chunk_bytes;
+			pos += chunk_bytes;
+		}
+		exchange_node_aware_counts(send_bytes, send_offsets, recv_bytes, recv_offsets, num_nodes_, inter_comm_, 4);
+		na_send_buf_.resize(std::max<size_t>(na_send_buf_.size(), send_offsets[num_nodes_]));
+		for(int pos = 0; pos < proxy_length; ) {
+			int header[3];
+			memcpy(header, na_recv_buf_.data() + pos, HEADER);
+			const int chunk_bytes = HEADER + header[2] * type_size;
+			const int node = dest_node_[header[1]];
+			memcpy(na_send_buf_.data() + send_offsets[node], na_recv_buf_.data() + pos, chunk_bytes);
+			send_offsets[node] += chunk_bytes;
+			pos += chunk_bytes;
+		}
+		for(int q = num_nodes_; q > 0; --q) send_offsets[q] = send_offsets[q - 1];
+		send_offsets[0] = 0;
+		na_recv_buf_.resize(std::max<size_t>(na_recv_buf_.size(), recv_offsets[num_nodes_]));
+		MPI_Alltoallv(na_send_buf_.data(), send_bytes, send_offsets, MPI_BYTE,
+				na_recv_buf_.data(), recv_bytes, recv_offsets, MPI_BYTE, inter_comm_);
+
+		// 3. sort the received chunks by source
+		const int final_length = recv_offsets[num_nodes_];
+		for(int r = 0; r < comm_size_; ++r) {
+			recv_counts_[r] = 0;
+		}
+		for(int pos = 0; pos < final_length; ) {
+			int header[3];
+			memcpy(header, na_recv_buf_.data() + pos, HEADER);
+			assert(header[1] == comm_rank && recv_counts_[header[0]] == 0);
+			recv_counts_[header[0]] = header[2];
+			pos += HEADER + header[2] * type_size;
+		}
+		recv_offsets_[0] = 0;
+		for(int r = 0; r < comm_size_; ++r) {
+			recv_offsets_[r + 1] = recv_offsets_[r] + recv_counts_[r];
+		}
+		if(recv_offsets_[comm_size_] > recvbufsize) {
+		   std::cout << "buffer alltoallv issue: " <<  recv_offsets_[comm_size_] << " > " << recvbufsize << '\n';
+			fprintf(IMD_OUT, "Error: recv_offsets_[comm_size_] > recvbufsize");
+			throw "Error: buffer size not enough";
+		}
+		for(int pos = 0; pos < final_length; ) {
+			int header[3];
+			memcpy(header, na_recv_buf_.data() + pos, HEADER);
+			memcpy((uint8_t*)recvbuf + int64_t(recv_offsets_[header[0]]) * type_size, na_recv_buf_.data() + pos + HEADER, header[2] * type_size);
+			pos += HEADER + header[2] * type_size;
+		}
+	}
+
+	// messages and bytes sent to other ranks: { flat messages, flat bytes, node-local messages,
+	// node-local bytes, inter-node messages, inter-node bytes } accumulated over alltoallv_node_aware() calls
+	const int64_t* get_node_aware_stats() const { return na_stats_; }
+	void reset_node_aware_stats() { std::fill(na_stats_, na_stats_ + 6, 0); }
+
 private:
+	// computes the send offsets, exchanges the counts, and computes the receive offsets; adds the stats
+	void exchange_node_aware_counts(const int* send_bytes, int* send_offsets, int* recv_bytes, int* recv_offsets,
+			int size, MPI_Comm comm, int stats_idx)
+	{
+		int rank;
+		MPI_Comm_rank(comm, &rank);
+		send_offsets[0] = 0;
+		for(int i = 0; i < size; ++i) {
+			send_offsets[i + 1] = send_offsets[i] + send_bytes[i];
+			if(i != rank && send_bytes[i] > 0) {
+				na_stats_[stats_idx] += 1;
+				na_stats_[stats_idx + 1] += send_bytes[i];
+			}
+		}
+		MPI_Alltoall(send_bytes, 1, MPI_INT, recv_bytes, 1, MPI_INT, comm);
+		recv_offsets[0] = 0;
+		for(int i = 0; i < size; ++i) {
+			recv_offsets[i + 1] = recv_offsets[i] + recv_bytes[i];
+		}
+	}
+
 	MPI_Comm comm_;
 	int comm_size_;
 	int buffer_width_;
@@ -2208,6 +2992,28 @@ private:
 	int* restrict recv_counts_;
 	int* restrict recv_offsets_;
 
+	// one window per receive buffer of the pool, see register_rma_window()
+	enum { MAX_RMA_WINDOWS = 4 };
+	MPI_Win rma_wins_[MAX_RMA_WINDOWS];
+	void* rma_bases_[MAX_RMA_WINDOWS];
+	int64_t rma_sizes_[MAX_RMA_WINDOWS];
+	int num_rma_windows_;
+	int* rma_displs_;
+
+	// node-aware exchange
+	bool node_aware_;
+	MPI_Comm node_comm_; // ranks on the same node
+	MPI_Comm inter_comm_; // ranks with the same node-local index, ordered by node
+	int local_rank_;
+	int local_size_;
+	int node_rank_;
+	int num_nodes_;
+	std::vector<int> dest_node_;
+	std::vector<int> dest_local_;
+	std::vector<int> na_counts_;
+	std::vector<uint8_t> na_send_buf_;
+	std::vector<uint8_t> na_recv_buf_;
+	int64_t na_stats_[6];
 };
 
 //-------------------------------------------------------------//
@@ -2484,7 +3290,7 @@ else { \
 	p[4]= (uint8_t)(v >> 28) | 0x80; \
 	p[5]= (uint8_t)(v >> 35) | 0x80; \
 	p[6]= (uint8_t)(v >> 42) | 0x80; \
-	p[6]= (uint8_t)(v >> 49) | 0x80; \
+	p[7]= (uint8_t)(v >> 49) | 0x80; \
 	p[8]= (uint8_t)(v >> 56); \
 	l = 9; \
 }
@@ -2997,6 +3803,7 @@ template <typename T>
 class Pool {
 public:
 	Pool()
+		: tag_(TAG_OTHER)
 	{
 	}
 	virtual ~Pool() {
@@ -3028,11 +3835,17 @@ public:
 		return free_list_.size();
 	}
 
+	// subsystem of the memory accounting of the buffers
+	void set_tag(Tag tag) {
+		tag_ = tag;
+	}
+
 protected:
 	std::vector<T*> free_list_;
+	Tag tag_;
 
 	virtual T* allocate_new() {
-		return new (malloc(sizeof(T))) T();
+		return new (cache_aligned_xmalloc(sizeof(T), tag_)) T();
 	}
 
 private:
@@ -3235,12 +4048,83 @@ public:
 	pthread_mutex_t thread_sync_;
 };
 
+//! Bounded lock-free ring for exactly one producing and one consuming thread
+template <typename T>
+class SpscRing
+{
+public:
+	explicit SpscRing(int capacity)
+	{
+		head_.value = tail_.value = 0;
+		capacity_ = 1;
+		while(capacity_ < capacity) capacity_ *= 2;
+		data_ = (T*)cache_aligned_xmalloc(capacity_ * sizeof(T));
+	}
+	~SpscRing() { ::free(data_); }
+
+	//! producer only; false if the ring is full
+	bool push(const T& d) {
+		const int64_t tail = tail_.value;
+		if(tail - __atomic_load_n(&head_.value, __ATOMIC_ACQUIRE) == capacity_)
+			return false;
+		data_[tail & (capacity_ - 1)] = d;
+		__atomic_store_n(&tail_.value, tail + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	//! consumer only; false if the ring is empty
+	bool pop(T* ret) {
+		const int64_t head = head_.value;
+		if(__atomic_load_n(&tail_.value, __ATOMIC_ACQUIRE) == head)
+			return false;
+		*ret = data_[head & (capacity_ - 1)];
+		__atomic_store_n(&head_.value, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+private:
+	struct Index {
+		int64_t value;
+		int8_t padding[CACHE_LINE - sizeof(int64_t)];
+	};
+
+	Index head_; // written by the consumer
+	Index tail_; // written by the producer
+	T* data_;
+	int64_t capacity_;
+
+	SpscRing(const SpscRing&);
+	SpscRing& operator=(const SpscRing&);
+};
+
+//! Spin barrier of num_threads participants. barrier() lets all of them meet at one counter (e.g. the
+//! processes of a node in shared memory). barrier(tid) is hierarchical for threads with ids 0..num_threads-1:
+//! the threads of a group meet at the counter of their group (on its own cache line), only the last one of
+//! each group goes on to the top counter, and the last one there releases all. The two are not mixed on one
+//! barrier. Waiting threads yield after a while (oversubscription).
 struct SpinBarrier {
+	enum {
+		MAX_GROUPS = 64,
+		THREADS_PER_GROUP = 8,
+		SPINS_BEFORE_YIELD = 4096,
+	};
+	struct Counter {
+		volatile int cnt;
+		int8_t padding[CACHE_LINE - sizeof(int)];
+	};
+
 	volatile int step, cnt;
 	int max;
-	explicit SpinBarrier(int num_threads) {
+	int group_size;
+	int num_groups;
+	Counter group_cnt[MAX_GROUPS];
+
+	explicit SpinBarrier(int num_threads, int threads_per_group = THREADS_PER_GROUP) {
 		step = cnt = 0;
 		max = num_threads;
+		group_size = std::max(threads_per_group, (num_threads + MAX_GROUPS - 1) / MAX_GROUPS);
+		num_groups = (num_threads + group_size - 1) / group_size;
+		for(int g = 0; g < MAX_GROUPS; ++g) group_cnt[g].cnt = 0;
 	}
 	void barrier() {
 		int cur_step = step;
@@ -3251,32 +4135,227 @@ struct SpinBarrier {
 			__sync_add_and_fetch(&step, 1);
 			return ;
 		}
-		while(step == cur_step) ;
+		wait(cur_step);
+	}
+	void barrier(int tid) {
+		const int cur_step = step;
+		if(!arrive(tid))
+			wait(cur_step);
+	}
+	//! barrier(tid) without waiting for the others; returns whether this thread completed the barrier
+	bool arrive(int tid) {
+		assert(0 <= tid && tid < max);
+		const int g = tid / group_size;
+		const int cur_group_size = std::min(group_size, max - g * group_size);
+		if(__sync_add_and_fetch(&group_cnt[g].cnt, 1) == cur_group_size) {
+			group_cnt[g].cnt = 0;
+			if(__sync_add_and_fetch(&cnt, 1) == num_groups) {
+				cnt = 0;
+				__sync_add_and_fetch(&step, 1);
+				return true;
+			}
+		}
+		return false;
+	}
+	//! waits until value differs from cur_value
+	static void wait_for_change(const volatile int& value, int cur_value) {
+		int spins = 0;
+		while(value == cur_value) {
+			if(spins < SPINS_BEFORE_YIELD) ++spins;
+			else sched_yield();
+		}
+	}
+private:
+	void wait(int cur_step) const {
+		wait_for_change(step, cur_step);
 	}
 };
 
-void copy_mt(void* dst, void* src, size_t size) {
+//! Parallel regions that can run in one persistent OpenMP region (PERSISTENT_REGION).
+//! parallel(body) is "#pragma omp parallel if(cond) body()" unless it is called by the master thread
+//! inside run(): then the region is handed to the team of run(), whose other threads spin until the
+//! master thread starts the next region; at the end of a region only the master thread waits for them,
+//! in the hierarchical SpinBarrier. The body is called by all threads of the team either way, so
+//! its worksharing constructs (omp for, single, master, barrier) bind to the team. Everything outside the
+//! bodies, in particular MPI, is only executed by the master thread.
+class PersistentTeam {
+public:
+	PersistentTeam() : barrier_(1), is_active_(false), in_body_(false), generation_(0), body_(NULL), arg_(NULL) { }
+
+	template <typename F>
+	void parallel(F&& body, bool cond = true) {
+#if PERSISTENT_REGION
+		// nested regions and regions of the team's other threads run with a team of one, as without run()
+		if(is_active_ && cond && !in_body_ && omp_get_thread_num() == 0) {
+			body_ = &invoke<typename std::remove_reference<F>::type>;
+			arg_ = &body;
+			in_body_ = true;
+			__sync_add_and_fetch(&generation_, 1); // starts the region
+			body();
+			barrier_.barrier(0); // the implicit barrier at the end of the region, only the master thread waits
+			in_body_ = false;
+			return;
+		}
+#endif
+#pragma omp parallel if(cond)
+		body();
+	}
+
+	// calls driver() on the master thread while the other threads serve the regions it starts with parallel()
+	template <typename F>
+	void run(F&& driver) {
+#if PERSISTENT_REGION
+		if(omp_get_max_threads() > 1) {
 #pragma omp parallel
-	{
+			{
+				const int tid = omp_get_thread_num();
+				const int start_generation = generation_;
+#pragma omp master
+				barrier_ = SpinBarrier(omp_get_num_threads());
+#pragma omp barrier
+				if(tid == 0) {
+					is_active_ = true;
+					driver();
+					is_active_ = false;
+					body_ = NULL;
+					__sync_add_and_fetch(&generation_, 1); // releases the other threads
+				}
+				else {
+					for(int cur_generation = start_generation; true; ++cur_generation) {
+						SpinBarrier::wait_for_change(generation_, cur_generation);
+						if(body_ == NULL) break;
+						body_(arg_);
+						barrier_.arrive(tid);
+					}
+				}
+			}
+			return;
+		}
+#endif
+		driver();
+	}
+
+private:
+	template <typename F>
+	static void invoke(void* body) { (*static_cast<F*>(body))(); }
+
+	SpinBarrier barrier_;
+	bool is_active_; // inside run(), only accessed by the master thread
+	bool in_body_; // the master thread executes a body
+	volatile int generation_; // incremented by the master thread to start a region
+	void (* volatile body_)(void*); // region of the team, NULL to end run()
+	void* volatile arg_;
+
+	PersistentTeam(const PersistentTeam&);
+	PersistentTeam& operator=(const PersistentTeam&);
+};
+
+PersistentTeam g_team;
+
+//! Bump allocator for temporary buffers of one thread that only live within a phase or a run.
+//! Requests that do not fit into the chunk are served by posix_memalign; once all scopes are
+//! released, the chunk grows to the high-water mark, so that later phases do not allocate anymore.
+class ScratchArena {
+public:
+	ScratchArena()
+		: chunk_(NULL), capacity_(0), top_(0), high_water_(0)
+		, num_allocs_(0), num_fallbacks_(0), num_grows_(0), fallback_time_(0.0)
+	{ }
+	~ScratchArena() {
+		release(0);
+		::free(chunk_);
+	}
+
+	size_t mark() const { return top_; }
+
+	void* alloc(size_t size) {
+		const size_t bytes = roundup<size_t>(std::max<size_t>(size, 1), CACHE_LINE);
+		void* p;
+		++num_allocs_;
+		if(top_ + bytes <= capacity_) {
+			p = chunk_ + top_;
+		}
+		else {
+			const double start = MPI_Wtime();
+			p = cache_aligned_xmalloc(bytes);
+			fallback_time_ += MPI_Wtime() - start;
+			fallbacks_.push_back(std::make_pair(top_, p));
+			++num_fallbacks_;
+		}
+		top_ += bytes;
+		high_water_ = std::max(high_water_, top_);
+		return p;
+	}
+
+	//! frees everything allocated after the mark was taken
+	void release(size_t mark) {
+		assert(mark <= top_);
+		while(fallbacks_.size() > 0 && fallbacks_.back().first >= mark) {
+			::free(fallbacks_.back().second);
+			fallbacks_.pop_back();
+		}
+		top_ = mark;
+		if(top_ == 0 && high_water_ > capacity_) {
+			::free(chunk_);
+			capacity_ = high_water_;
+			chunk_ = (int8_t*)page_aligned_xmalloc(capacity_);
+			++num_grows_;
+		}
+	}
+
+	void reset_stats() { num_allocs_ = num_fallbacks_ = num_grows_ = 0; fallback_time_ = 0.0; }
+	size_t high_water() const { return high_water_; }
+	int64_t num_allocs() const { return num_allocs_; }
+	int64_t num_fallbacks() const { return num_fallbacks_; }
+	int64_t num_grows() const { return num_grows_; }
+	double fallback_time() const { return fallback_time_; }
+
+private:
+	int8_t* chunk_;
+	size_t capacity_;
+	size_t top_;
+	size_t high_water_;
+	std::vector<std::pair<size_t, void*> > fallbacks_; // (offset, buffer) of allocations outside the chunk
+	int64_t num_allocs_;
+	int64_t num_fallbacks_;
+	int64_t num_grows_;
+	double fallback_time_;
+};
+
+//! Releases all allocations of the arena made during its lifetime
+class ScratchScope {
+public:
+	explicit ScratchScope(ScratchArena& arena) : arena_(arena), mark_(arena.mark()) { }
+	~ScratchScope() { arena_.release(mark_); }
+
+	template <typename T>
+	T* alloc(size_t n) { return static_cast<T*>(arena_.alloc(n * sizeof(T))); }
+
+private:
+	ScratchArena& arena_;
+	const size_t mark_;
+};
+
+void copy_mt(void* dst, void* src, size_t size) {
+	g_team.parallel([&]() {
 		int num_threads = omp_get_num_threads();
 		int tid = omp_get_thread_num();
 		int64_t i_start, i_end;
 		get_partition<int64_t>(size, num_threads, tid, i_start, i_end);
 		memcpy((int8_t*)dst + i_start, (int8_t*)src + i_start, i_end - i_start);
-	}
+	});
 	assert(memcmp((int8_t*)dst, (int8_t*)src, size) == 0);
 }
 
 
 void clean_mt(void* dst, size_t size) {
-#pragma omp parallel
-   {
+   g_team.parallel([&]() {
       const int num_threads = omp_get_num_threads();
       const int tid = omp_get_thread_num();
       int64_t i_start, i_end;
       get_partition<int64_t>(size, num_threads, tid, i_start, i_end);
       memset((int8_t*)dst + i_start, 0, i_end - i_start);
-   }
+   });
 #ifndef NDEBUG
    for( size_t i = 0; i < size; i++ )
       assert(((int8_t*)dst)[i] == 0);
@@ -347,11 +347,34 @@ static __thread uint this_is_not_used_ = 0;
 // Memory Allocation
 //-------------------------------------------------------------//
 
+namespace memory {
+
+// subsystems of the memory accounting (MEMORY_ACCOUNTING)
+enum Tag {
+	TAG_OTHER,
+	TAG_EDGE_LIST,
+	TAG_GRAPH,
+	TAG_VERTEX, // dist and pred
+	TAG_COMM, // communication buffers
+	TAG_QUEUE, // NQ and CQ
+	TAG_DEDUP, // NQ deduplication and bucket marks
+	TAG_LOCKS,
+	TAG_VALIDATION,
+	NUM_TAGS
+};
+
+// tag of the allocations of this thread that do not name one, see TagScope
+extern __thread Tag g_scope_tag;
+
+} // namespace memory
+
 void* xMPI_Alloc_mem(size_t nbytes);
-void* cache_aligned_xcalloc(const size_t size);
-void* cache_aligned_xmalloc(const size_t size);
-void* page_aligned_xcalloc(const size_t size);
-void* page_aligned_xmalloc(const size_t size);
+void* cache_aligned_xcalloc(const size_t size, memory::Tag tag = memory::g_scope_tag);
+void* cache_aligned_xmalloc(const size_t size, memory::Tag tag = memory::g_scope_tag);
+void* page_aligned_xcalloc(const size_t size, memory::Tag tag = memory::g_scope_tag);
+void* page_aligned_xmalloc(const size_t size, memory::Tag tag = memory::g_scope_tag);
+void* huge_aligned_xcalloc(const size_t size, memory::Tag tag = memory::g_scope_tag);
+void* huge_aligned_xmalloc(const size_t size, memory::Tag tag = memory::g_scope_tag);
 
 //-------------------------------------------------------------//
 // Sort
@@ -0,0 +1,177 @@
+/*
+ * a2a_stress_test.cc
+ *
+ *  Stress test for the lock-free sends of AsyncAlltoallManager:
+ *  all OpenMP threads put buffers and pointers to all targets concurrently,
+ *  afterwards every send has to be found exactly once.
+ */
+
+// C includes
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <math.h>
+
+// C++ includes
+#include <vector>
+
+#include "parameters.h"
+#include "utils.hpp"
+#include "../src/sssp/abstract_comm.hpp"
+
+enum {
+	BUF_SIZE = 1024,
+	PUT_LENGTH = 16,
+	NUM_ROUNDS = 10,
+};
+
+struct TestBufferHandler : public AlltoallBufferHandler {
+	TestBufferHandler(int num_buffers)
+		: num_buffers_(num_buffers)
+		, current_index_(0)
+	{
+		mem_ = (uint32_t*)cache_aligned_xmalloc(size_t(num_buffers) * BUF_SIZE * sizeof(uint32_t));
+	}
+	virtual ~TestBufferHandler() { free(mem_); }
+	virtual void* get_buffer() {
+		if(current_index_ >= num_buffers_) {
+			fprintf(stderr, "test buffer pool too small\n");
+			MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+		}
+		return mem_ + size_t(current_index_++) * BUF_SIZE;
+	}
+	virtual void add(void* buffer, void* data, int offset, int length) {
+		memcpy((uint32_t*)buffer + offset, data, length * sizeof(uint32_t));
+	}
+	virtual void* clear_buffers() { current_index_ = 0; return mem_; }
+	virtual void* second_buffer() { return NULL; }
+	virtual int max_size() { return num_buffers_ * BUF_SIZE * sizeof(uint32_t); }
+	virtual int buffer_length() { return BUF_SIZE; }
+	virtual MPI_Datatype data_type() { return MPI_UINT32_T; }
+	virtual int element_size() { return sizeof(uint32_t); }
+	virtual void received(void* buf, int offset, int length, int from, bool is_ptr) { }
+	virtual void finish() { }
+
+	int num_buffers_;
+	int current_index_;
+	uint32_t* mem_;
+};
+
+struct PtrChecker {
+	PtrChecker(std::vector<int>& seen, int target, int comm_size, int64_t num_puts)
+		: seen_(seen), target_(target), comm_size_(comm_size), num_puts_(num_puts), errors_(0) { }
+	void operator()(int64_t ptr, int length, int64_t header, float dist) {
+		const int64_t k = ptr % num_puts_;
+		if(ptr < 0 || ptr >= int64_t(seen_.size()) || k % comm_size_ != target_ ||
+				header != ptr / num_puts_ || length != int(k % 7) + 1 || dist != float(k)) {
+			++errors_;
+			return;
+		}
+		++seen_[ptr];
+	}
+	std::vector<int>& seen_;
+	int target_;
+	int comm_size_;
+	int64_t num_puts_;
+	int64_t errors_;
+};
+
+struct BufferChecker {
+	BufferChecker(std::vector<int>& seen, int target, int comm_size, int64_t num_puts)
+		: seen_(seen), target_(target), comm_size_(comm_size), num_puts_(num_puts), errors_(0) { }
+	void operator()(void* ptr, int length) {
+		const uint32_t* data = (const uint32_t*)ptr;
+		if(length % PUT_LENGTH != 0) {
+			++errors_;
+			return;
+		}
+		for(int i = 0; i < length; i += PUT_LENGTH) {
+			const int64_t id = data[i];
+			if(id >= int64_t(seen_.size()) || (id % num_puts_) % comm_size_ != target_) {
+				++errors_;
+				continue;
+			}
+			for(int j = 1; j < PUT_LENGTH; ++j) {
+				if(data[i + j] != (uint32_t(id) ^ uint32_t(j)))
+					++errors_;
+			}
+			++seen_[id];
+		}
+	}
+	std::vector<int>& seen_;
+	int target_;
+	int comm_size_;
+	int64_t num_puts_;
+	int64_t errors_;
+};
+
+int main(int argc, char **argv) {
+	MPI_Init(&argc, &argv);
+	MPI_Comm_size(MPI_COMM_WORLD, &mpi.size);
+	MPI_Comm_rank(MPI_COMM_WORLD, &mpi.rank);
+
+	const int64_t num_puts = (argc > 1) ? atol(argv[1]) : 20000; // per thread and round
+	const int n_threads = omp_get_max_threads();
+	const int comm_size = mpi.size;
+	const int64_t total_puts = num_puts * n_threads;
+	// each buffer swap can waste less than one put
+	const int num_buffers = int(total_puts * PUT_LENGTH / (BUF_SIZE - PUT_LENGTH)) + 2 * comm_size + 2;
+	int64_t errors = 0;
+	double put_time = 0.0;
+
+	{
+		TestBufferHandler handler(num_buffers);
+		AsyncAlltoallManager comm(MPI_COMM_WORLD, &handler);
+
+		for(int round = 0; round < NUM_ROUNDS; ++round) {
+			comm.prepare();
+			const double start = MPI_Wtime();
+#pragma omp parallel
+			{
+				const int tid = omp_get_thread_num();
+				uint32_t packet[PUT_LENGTH];
+				for(int64_t k = 0; k < num_puts; ++k) {
+					const int64_t id = tid * num_puts + k;
+					const int target = int(k % comm_size);
+					comm.put_ptr(id, int(k % 7) + 1, tid, float(k), target);
+
+					packet[0] = uint32_t(id);
+					for(int j = 1; j < PUT_LENGTH; ++j)
+						packet[j] = uint32_t(id) ^ uint32_t(j);
+					comm.put(packet, PUT_LENGTH, target);
+				}
+			}
+			put_time += MPI_Wtime() - start;
+
+			std::vector<int> seen_ptr(total_puts, 0);
+			std::vector<int> seen_buf(total_puts, 0);
+			for(int i = 0; i < comm_size; ++i) {
+				PtrChecker ptr_checker(seen_ptr, i, comm_size, num_puts);
+				BufferChecker buf_checker(seen_buf, i, comm_size, num_puts);
+				comm.visit_ptrs(i, ptr_checker);
+				comm.visit_buffers(i, buf_checker);
+				errors += ptr_checker.errors_ + buf_checker.errors_;
+			}
+			for(int64_t id = 0; id < total_puts; ++id) {
+				if(seen_ptr[id] != 1 || seen_buf[id] != 1)
+					++errors;
+			}
+
+			comm.clear_pending();
+			handler.clear_buffers();
+		}
+	}
+
+	MPI_Allreduce(MPI_IN_PLACE, &errors, 1, MpiTypeOf<int64_t>::type, MPI_SUM, MPI_COMM_WORLD);
+	if(mpi.isMaster()) {
+		printf("threads: %d, puts per thread: %" PRId64 ", put time: %f ms per round\n",
+				n_threads, num_puts, put_time * 1000.0 / NUM_ROUNDS);
+		printf("%s (%" PRId64 " errors)\n", (errors == 0) ? "OK" : "FAILED", errors);
+	}
+
+	MPI_Finalize();
+	return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
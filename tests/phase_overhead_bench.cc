@@ -0,0 +1,169 @@
+/*
+ * phase_overhead_bench.cc
+ *
+ *  Per-phase threading overhead: a phase of NUM_STAGES small parallel stages is run
+ *  (a) with one parallel region per stage (fork/join),
+ *  (b) in one persistent parallel region with "#pragma omp barrier" between the stages,
+ *  (c) as (b), but with the hierarchical memory::SpinBarrier,
+ *  (d) by memory::PersistentTeam (PERSISTENT_REGION): the master thread hands each stage to the
+ *      team, which waits in the hierarchical SpinBarrier in between.
+ *  Reports the time per phase for each given number of threads (default: 1, 12 and 48).
+ */
+
+// C includes
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+// C++ includes
+#include <vector>
+
+// (d) needs the persistent team
+#define PERSISTENT_REGION 1
+#include "parameters.h"
+#include "utils.hpp"
+
+enum {
+	NUM_PHASES = 2000,
+	NUM_STAGES = 6, // about the number of parallel regions of a light phase
+	STAGE_WORK = 4096, // elements per stage
+};
+
+// work of one stage: the elements [begin, end) of the stage
+static int64_t stage_work(const std::vector<int>& data, int stage, int64_t begin, int64_t end) {
+	int64_t sum = 0;
+	for(int64_t i = begin; i < end; ++i)
+		sum += data[i] ^ stage;
+	return sum;
+}
+
+static int64_t run_fork_join(const std::vector<int>& data, int num_threads) {
+	int64_t total = 0;
+	for(int phase = 0; phase < NUM_PHASES; ++phase) {
+		for(int stage = 0; stage < NUM_STAGES; ++stage) {
+#pragma omp parallel num_threads(num_threads) reduction(+: total)
+			{
+				int64_t begin, end;
+				get_partition<int64_t>(STAGE_WORK, omp_get_num_threads(), omp_get_thread_num(), begin, end);
+				total += stage_work(data, stage, begin, end);
+			}
+		}
+	}
+	return total;
+}
+
+static int64_t run_persistent(const std::vector<int>& data, int num_threads) {
+	int64_t total = 0;
+#pragma omp parallel num_threads(num_threads) reduction(+: total)
+	{
+		const int tid = omp_get_thread_num();
+		int64_t begin, end;
+		get_partition<int64_t>(STAGE_WORK, num_threads, tid, begin, end);
+		for(int phase = 0; phase < NUM_PHASES; ++phase) {
+			for(int stage = 0; stage < NUM_STAGES; ++stage) {
+				total += stage_work(data, stage, begin, end);
+#pragma omp barrier
+			}
+		}
+	}
+	return total;
+}
+
+static int64_t run_spin_barrier(const std::vector<int>& data, int num_threads) {
+	int64_t total = 0;
+	memory::SpinBarrier barrier(num_threads);
+#pragma omp parallel num_threads(num_threads) reduction(+: total)
+	{
+		const int tid = omp_get_thread_num();
+		int64_t begin, end;
+		get_partition<int64_t>(STAGE_WORK, num_threads, tid, begin, end);
+		for(int phase = 0; phase < NUM_PHASES; ++phase) {
+			for(int stage = 0; stage < NUM_STAGES; ++stage) {
+				total += stage_work(data, stage, begin, end);
+				barrier.barrier(tid);
+			}
+		}
+	}
+	return total;
+}
+
+static int64_t run_team(const std::vector<int>& data, int num_threads) {
+	int64_t total = 0;
+	omp_set_num_threads(num_threads);
+	memory::g_team.run([&]() {
+		for(int phase = 0; phase < NUM_PHASES; ++phase) {
+			for(int stage = 0; stage < NUM_STAGES; ++stage) {
+				memory::g_team.parallel([&]() {
+					int64_t begin, end;
+					get_partition<int64_t>(STAGE_WORK, omp_get_num_threads(), omp_get_thread_num(), begin, end);
+					const int64_t sum = stage_work(data, stage, begin, end);
+#pragma omp atomic
+					total += sum;
+				});
+			}
+		}
+	});
+	return total;
+}
+
+int main(int argc, char **argv) {
+	MPI_Init(&argc, &argv);
+	MPI_Comm_size(MPI_COMM_WORLD, &mpi.size);
+	MPI_Comm_rank(MPI_COMM_WORLD, &mpi.rank);
+
+	std::vector<int> thread_counts;
+	for(int i = 1; i < argc; ++i)
+		thread_counts.push_back(atoi(argv[i]));
+	if(thread_counts.empty()) {
+		thread_counts.push_back(1);
+		thread_counts.push_back(12);
+		thread_counts.push_back(48);
+	}
+
+	std::vector<int> data(STAGE_WORK);
+	for(int i = 0; i < STAGE_WORK; ++i)
+		data[i] = i * 7 + 1;
+	int64_t expected = 0;
+	for(int stage = 0; stage < NUM_STAGES; ++stage)
+		expected += stage_work(data, stage, 0, STAGE_WORK);
+	expected *= NUM_PHASES;
+
+	int64_t errors = 0;
+	omp_set_dynamic(0);
+	for(size_t k = 0; k < thread_counts.size(); ++k) {
+		const int num_threads = thread_counts[k];
+		if(num_threads < 1) {
+			++errors;
+			continue;
+		}
+		double start = MPI_Wtime();
+		const int64_t sum_fork_join = run_fork_join(data, num_threads);
+		const double time_fork_join = MPI_Wtime() - start;
+		start = MPI_Wtime();
+		const int64_t sum_omp_barrier = run_persistent(data, num_threads);
+		const double time_omp_barrier = MPI_Wtime() - start;
+		start = MPI_Wtime();
+		const int64_t sum_spin_barrier = run_spin_barrier(data, num_threads);
+		const double time_spin_barrier = MPI_Wtime() - start;
+		start = MPI_Wtime();
+		const int64_t sum_team = run_team(data, num_threads);
+		const double time_team = MPI_Wtime() - start;
+
+		if(sum_fork_join != expected || sum_omp_barrier != expected || sum_spin_barrier != expected || sum_team != expected)
+			++errors;
+		if(mpi.isMaster()) {
+			printf("threads: %d, per phase of %d stages: fork/join %f us, omp barrier %f us, spin barrier %f us, persistent team %f us\n",
+					num_threads, int(NUM_STAGES), time_fork_join * 1e6 / NUM_PHASES,
+					time_omp_barrier * 1e6 / NUM_PHASES, time_spin_barrier * 1e6 / NUM_PHASES,
+					time_team * 1e6 / NUM_PHASES);
+		}
+	}
+
+	if(mpi.isMaster())
+		printf("%s (%" PRId64 " errors)\n", (errors == 0) ? "OK" : "FAILED", errors);
+
+	MPI_Finalize();
+	return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
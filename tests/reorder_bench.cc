@@ -0,0 +1,171 @@
+/*
+ * reorder_bench.cc
+ *
+ *  Cache behavior of the vertex reordering (VERTEX_REORDERING, one binary per strategy):
+ *  scans the CSR rows in top-down order, reads orig_vertexes_ and gathers the distances
+ *  of the edge targets, and reports the L2 and LLC miss rates of this scan.
+ *  L2 accesses are counted as L1D read misses, L2 misses as LLC read accesses.
+ */
+
+// C includes
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// C++ includes
+#include <limits>
+
+#include "parameters.h"
+#include "utils.hpp"
+#include "primitives.hpp"
+#include "../src/generator/graph_generator.hpp"
+#include "../src/sssp/graph_constructor.hpp"
+#include "../src/sssp/validate.hpp"
+#include "../src/sssp/benchmark_helper.hpp"
+#include "../src/sssp/sssp.hpp"
+
+enum {
+	NUM_SCANS = 5,
+	NUM_COUNTERS = 3,
+};
+
+// L1D read misses, LLC read accesses, LLC read misses of the calling thread; fd is -1 if not available
+struct CacheCounters {
+	int fd[NUM_COUNTERS];
+
+	CacheCounters() {
+		const uint64_t configs[NUM_COUNTERS] = {
+			PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16),
+			PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		};
+		for(int i = 0; i < NUM_COUNTERS; ++i) {
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = configs[i];
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		}
+	}
+	~CacheCounters() {
+		for(int i = 0; i < NUM_COUNTERS; ++i)
+			if(fd[i] >= 0) close(fd[i]);
+	}
+	bool available() const {
+		for(int i = 0; i < NUM_COUNTERS; ++i)
+			if(fd[i] < 0) return false;
+		return true;
+	}
+	void start() {
+		for(int i = 0; i < NUM_COUNTERS; ++i) {
+			if(fd[i] < 0) continue;
+			ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+	void stop(int64_t* values) {
+		for(int i = 0; i < NUM_COUNTERS; ++i) {
+			values[i] = 0;
+			if(fd[i] < 0) continue;
+			ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+			if(read(fd[i], &values[i], sizeof(values[i])) != sizeof(values[i]))
+				values[i] = 0;
+		}
+	}
+};
+
+// single-threaded scan, so that the counters of the calling thread cover it
+static double scan_csr(const Graph2DCSR& g, const float* dist, int64_t* num_edges)
+{
+	const int64_t bitmap_size = g.num_local_verts_ / PRM::NBPE * mpi.size_2dc;
+	const int64_t local_mask = (int64_t(1) << g.local_bits_) - 1;
+	double sum = 0.0;
+	int64_t edges = 0;
+	for(int64_t word_idx = 0; word_idx < bitmap_size; ++word_idx) {
+		TwodVertex non_zero_off;
+		BitmapType row_bitmap_i = g.row_word(word_idx, non_zero_off);
+		while(row_bitmap_i != BitmapType(0)) {
+			row_bitmap_i &= row_bitmap_i - 1;
+			sum += g.orig_vertexes_[non_zero_off];
+			for(int64_t e = g.row_starts_[non_zero_off]; e < g.row_starts_[non_zero_off + 1]; ++e)
+				sum += dist[g.edge_array_[e] & local_mask];
+			edges += g.row_starts_[non_zero_off + 1] - g.row_starts_[non_zero_off];
+			++non_zero_off;
+		}
+	}
+	*num_edges = edges;
+	return sum;
+}
+
+int main(int argc, char** argv)
+{
+	const int SCALE = (argc > 1) ? atoi(argv[1]) : 16;
+	const int edgefactor = (argc > 2) ? atoi(argv[2]) : 16;
+	setup_globals(argc, argv, SCALE, edgefactor);
+
+	{
+		EdgeListStorage<WeightedEdge, 8*1024*1024> edge_list(
+				(int64_t(1) << SCALE) * edgefactor / mpi.size_2d, getenv("TMPFILE"));
+		generate_graph_spec2010(&edge_list, SCALE, edgefactor);
+		SsspBase sssp_instance;
+		sssp_instance.construct(&edge_list);
+		const Graph2DCSR& g = sssp_instance.graph_;
+
+		const int64_t num_dist = int64_t(1) << g.local_bits_;
+		float* dist = static_cast<float*>(cache_aligned_xmalloc(num_dist * sizeof(float)));
+		for(int64_t i = 0; i < num_dist; ++i)
+			dist[i] = float(i % 1024);
+
+		CacheCounters counters;
+		int64_t values[NUM_COUNTERS] = { 0 };
+		int64_t num_edges = 0;
+		double checksum = 0.0;
+		double time = 0.0;
+		scan_csr(g, dist, &num_edges); // warm up
+		for(int i = 0; i < NUM_SCANS; ++i) {
+			int64_t scan_values[NUM_COUNTERS];
+			const double start = MPI_Wtime();
+			counters.start();
+			checksum += scan_csr(g, dist, &num_edges);
+			counters.stop(scan_values);
+			time += MPI_Wtime() - start;
+			for(int k = 0; k < NUM_COUNTERS; ++k)
+				values[k] += scan_values[k];
+		}
+
+		int available = counters.available();
+		int64_t sum_values[NUM_COUNTERS + 1];
+		int64_t send_values[NUM_COUNTERS + 1] = { values[0], values[1], values[2], num_edges * NUM_SCANS };
+		MPI_Reduce(send_values, sum_values, NUM_COUNTERS + 1, MpiTypeOf<int64_t>::type, MPI_SUM, 0, mpi.comm_2d);
+		MPI_Allreduce(MPI_IN_PLACE, &available, 1, MPI_INT, MPI_LAND, mpi.comm_2d);
+		MPI_Allreduce(MPI_IN_PLACE, &time, 1, MPI_DOUBLE, MPI_MAX, mpi.comm_2d);
+		if(mpi.isMaster()) {
+			print_with_prefix("VERTEX_REORDERING=%d SCALE=%d: %f ns per edge (checksum %g)",
+					VERTEX_REORDERING, SCALE, time * 1e9 / sum_values[3] * mpi.size_2d, checksum);
+			if(available) {
+				print_with_prefix("L2 miss rate: %f (%f misses per edge), LLC miss rate: %f (%f misses per edge)",
+						double(sum_values[1]) / std::max<int64_t>(sum_values[0], 1), double(sum_values[1]) / sum_values[3],
+						double(sum_values[2]) / std::max<int64_t>(sum_values[1], 1), double(sum_values[2]) / sum_values[3]);
+			}
+			else {
+				print_with_prefix("L2/LLC miss rates: n/a (hardware cache events are not available)");
+			}
+		}
+		free(dist);
+	}
+
+	cleanup_globals();
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * row_index_test.cc
+ *
+ *  Checks the hypersparse row index of Graph2DCSR: after compress_rows and after expand_rows,
+ *  row_of and row_word have to give the same rows as the bitmap index built by the construction.
+ *  Reports the size of both indexes and the time of a row_of lookup.
+ */
+
+// C includes
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+// C++ includes
+#include <vector>
+
+#include "parameters.h"
+#include "utils.hpp"
+#include "primitives.hpp"
+#include "../src/generator/graph_generator.hpp"
+#include "../src/sssp/graph_constructor.hpp"
+#include "../src/sssp/validate.hpp"
+#include "../src/sssp/benchmark_helper.hpp"
+#include "../src/sssp/sssp.hpp"
+
+// compares the row index of g with the rows and row bitmap words of the bitmap index
+static int64_t check_rows(const Graph2DCSR& g, const std::vector<int64_t>& rows, const std::vector<BitmapType>& words)
+{
+	int64_t errors = 0;
+	if(g.num_rows() != int64_t(rows.size()) - std::count(rows.begin(), rows.end(), int64_t(-1)))
+		++errors;
+	for(int64_t compact = 0; compact < int64_t(rows.size()); ++compact) {
+		if(g.row_of(compact) != rows[compact])
+			++errors;
+	}
+	for(int64_t word_idx = 0; word_idx < int64_t(words.size()); ++word_idx) {
+		TwodVertex first_row;
+		if(g.row_word(word_idx, first_row) != words[word_idx])
+			++errors;
+		else if(words[word_idx] != 0 && int64_t(first_row) != rows[word_idx * PRM::NBPE + __builtin_ctzl(words[word_idx])])
+			++errors;
+	}
+	return errors;
+}
+
+static double time_lookups(const Graph2DCSR& g, int64_t num_compacts)
+{
+	const int64_t num_lookups = 1 << 20;
+	int64_t sum = 0;
+	const double start = MPI_Wtime();
+	for(int64_t i = 0; i < num_lookups; ++i)
+		sum += g.row_of((i * 7919) % num_compacts);
+	const double time = MPI_Wtime() - start;
+	if(sum == -1) printf("unexpected\n"); // keeps the loop
+	return time * 1e9 / num_lookups;
+}
+
+int main(int argc, char** argv)
+{
+	const int SCALE = (argc > 1) ? atoi(argv[1]) : 12;
+	const int edgefactor = (argc > 2) ? atoi(argv[2]) : 16;
+	setup_globals(argc, argv, SCALE, edgefactor);
+	int64_t errors = 0;
+
+	{
+		EdgeListStorage<WeightedEdge, 8*1024*1024> edge_list(
+				(int64_t(1) << SCALE) * edgefactor / mpi.size_2d, getenv("TMPFILE"));
+		generate_graph_spec2010(&edge_list, SCALE, edgefactor);
+		SsspBase sssp_instance;
+		sssp_instance.construct(&edge_list);
+		Graph2DCSR& g = sssp_instance.graph_;
+		g.expand_rows(); // the bitmap index is the reference
+
+		const int64_t bitmap_length = g.row_bitmap_length();
+		const int64_t num_compacts = bitmap_length * PRM::NBPE;
+		std::vector<BitmapType> words(g.row_bitmap_, g.row_bitmap_ + bitmap_length);
+		std::vector<int64_t> rows(num_compacts, -1);
+		for(int64_t compact = 0; compact < num_compacts; ++compact) {
+			const BitmapType bit = BitmapType(1) << (compact % PRM::NBPE);
+			const int64_t word_idx = compact / PRM::NBPE;
+			if(words[word_idx] & bit)
+				rows[compact] = g.row_sums_[word_idx] + __builtin_popcountl(words[word_idx] & (bit - 1));
+		}
+
+		const int64_t bytes_bitmap = g.row_index_bytes();
+		const double time_bitmap = time_lookups(g, num_compacts);
+		if(!g.compress_rows(true) || !g.has_hypersparse_rows())
+			++errors;
+		errors += check_rows(g, rows, words);
+		const int64_t bytes_hypersparse = g.row_index_bytes();
+		const double time_hypersparse = time_lookups(g, num_compacts);
+		g.expand_rows();
+		if(g.has_hypersparse_rows())
+			++errors;
+		errors += check_rows(g, rows, words);
+
+		int64_t send_bytes[2] = { bytes_bitmap, bytes_hypersparse };
+		int64_t sum_bytes[2];
+		MPI_Reduce(send_bytes, sum_bytes, 2, MpiTypeOf<int64_t>::type, MPI_SUM, 0, mpi.comm_2d);
+		if(mpi.isMaster()) {
+			print_with_prefix("SCALE=%d: bitmap row index %f MB (%f ns per lookup), hypersparse row index %f MB (%f ns per lookup)",
+					SCALE, to_mega(sum_bytes[0]), time_bitmap, to_mega(sum_bytes[1]), time_hypersparse);
+		}
+	}
+
+	MPI_Allreduce(MPI_IN_PLACE, &errors, 1, MpiTypeOf<int64_t>::type, MPI_SUM, MPI_COMM_WORLD);
+	if(mpi.isMaster())
+		printf("%s (%" PRId64 " errors)\n", (errors == 0) ? "OK" : "FAILED", errors);
+
+	cleanup_globals();
+	return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}